@@ -9,17 +9,29 @@ QT       -= gui
 TARGET    = qubiq
 DEFINES  += QUBIQ_LIBRARY
 TEMPLATE  = lib
-LIBS     += -L.. -lqubiqutil -L../3rdparty/cutelogger -lLogger
+LIBS     += -L.. -lqubiqutil -L../3rdparty/cutelogger -lLogger -lz
 
 DESTDIR   = ..
 
 INCLUDEPATH += "include" "../util/include" "../3rdparty"
 HEADERS     += \
+    include/qubiq/abstract_segment_writer.h \
     include/qubiq/abstract_term_filter.h  \
+    include/qubiq/abstract_lemmatizer.h   \
+    include/qubiq/transducer_lemmatizer.h \
     include/qubiq/qubiq_global.h          \
     include/qubiq/extractor.h             \
     include/qubiq/lexeme_sequence.h       \
     include/qubiq/text.h                  \
+    include/qubiq/text_snapshot.h         \
+    include/qubiq/snapshot_layout.h       \
+    include/qubiq/document_table.h        \
+    include/qubiq/boundary_map.h          \
+    include/qubiq/index_builder.h         \
+    include/qubiq/duplicate_detector.h    \
+    include/qubiq/tokenizer.h             \
+    include/qubiq/surface_form_cache.h    \
+    include/qubiq/block_queue.h           \
     include/qubiq/master_lemmatizer.h     \
     include/qubiq/lemmatizer.h            \
     include/qubiq/lemmatizer_interfaces.h
@@ -28,6 +40,16 @@ SOURCES += \
     src/extractor.cpp         \
     src/lexeme_sequence.cpp   \
     src/text.cpp              \
+    src/text_snapshot.cpp     \
+    src/snapshot_layout.cpp   \
+    src/document_table.cpp    \
+    src/boundary_map.cpp      \
+    src/index_builder.cpp     \
+    src/duplicate_detector.cpp \
+    src/transducer_lemmatizer.cpp \
+    src/tokenizer.cpp         \
+    src/surface_form_cache.cpp \
+    src/block_queue.cpp       \
     src/master_lemmatizer.cpp
 
 mac {
@@ -0,0 +1,16 @@
+#ifndef _ABSTRACT_LEMMATIZER_H_
+#define _ABSTRACT_LEMMATIZER_H_
+
+#include <QtCore>
+
+class AbstractLemmatizer {
+
+public:
+    AbstractLemmatizer() {}
+    virtual ~AbstractLemmatizer() {}
+
+    //! Returns the lemma of a lowercased wordform or an empty string if the wordform is unknown.
+    virtual QString lemmatize(const QString &wordform) = 0;
+};
+
+#endif // _ABSTRACT_LEMMATIZER_H_
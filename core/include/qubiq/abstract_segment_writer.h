@@ -0,0 +1,18 @@
+#ifndef _ABSTRACT_SEGMENT_WRITER_H_
+#define _ABSTRACT_SEGMENT_WRITER_H_
+
+#include <QtCore>
+
+class AbstractSegmentWriter {
+
+public:
+    AbstractSegmentWriter() {}
+    virtual ~AbstractSegmentWriter() {}
+
+    //! Returns memory usage of the text in bytes to flush it at.
+    virtual qint64 memoryBudget() const = 0;
+    //! Writes the text to a segment and clears it, returns \c false on failure.
+    virtual bool flush() = 0;
+};
+
+#endif // _ABSTRACT_SEGMENT_WRITER_H_
@@ -0,0 +1,28 @@
+#ifndef _BLOCK_QUEUE_H_
+#define _BLOCK_QUEUE_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+
+class QUBIQSHARED_EXPORT BlockQueue {
+
+public:
+    BlockQueue(int capacity);
+
+    //! Returns the maximum number of blocks the queue holds.
+    inline int capacity() const { return _capacity; }
+
+    bool push (const QByteArray &block);
+    bool pop  (QByteArray *block);
+    void close();
+
+private:
+    QQueue<QByteArray> _blocks;
+    int                _capacity;
+    bool               _is_closed;
+    QMutex             _mutex;
+    QWaitCondition     _not_empty;
+    QWaitCondition     _not_full;
+};
+
+#endif // _BLOCK_QUEUE_H_
@@ -0,0 +1,49 @@
+#ifndef _BOUNDARY_MAP_H_
+#define _BOUNDARY_MAP_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/util/qubiqutil_global.h>
+#include <qubiq/util/lexeme_index.h>
+
+const int BOUNDARY_MAP_MAX_RUN = 255; //!< Lengths of runs without boundaries are saturated at this value
+
+class QUBIQSHARED_EXPORT BoundaryMap {
+
+public:
+    BoundaryMap();
+
+    //! Returns the number of positions in the map.
+    inline TextPosition size() const { return _runs.size(); }
+
+    //! Returns \c true if the token at the given position is a boundary.
+    inline bool isBoundary(TextPosition pos) const { return _runs.at(pos) == 0; }
+
+    /**
+     * Returns \c true if a sequence of \c n tokens starting at \c offset contains
+     * a boundary or does not fit the map. Sequences up to \c BOUNDARY_MAP_MAX_RUN
+     * tokens long are checked in constant time.
+     */
+    inline bool hasBoundaries(TextPosition offset, int n) const {
+        if (offset < 0 || n < 1 || offset + n > size())
+            return true;
+        const int run = _runs.at(offset + n - 1);
+        if (run >= n)
+            return false;
+        return run < BOUNDARY_MAP_MAX_RUN || scan(offset, n);
+    }
+
+    void append(bool is_boundary);
+    void clear ();
+    void build (const LexemeIndex &index);
+
+    //! Returns memory occupied by the map in bytes.
+    inline qint64 memoryUsage() const { return _runs.memoryUsage(); }
+
+private:
+    PagedVector<quint8> _runs; //!< Number of consecutive non-boundary tokens ending at each position, 0 for boundaries
+
+    bool scan(TextPosition offset, int n) const;
+};
+
+#endif // _BOUNDARY_MAP_H_
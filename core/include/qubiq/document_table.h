@@ -0,0 +1,49 @@
+#ifndef _DOCUMENT_TABLE_H_
+#define _DOCUMENT_TABLE_H_
+
+#include <algorithm>
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/util/qubiqutil_global.h>
+#include <qubiq/util/compressed_postings.h>
+
+class QUBIQSHARED_EXPORT DocumentTable {
+
+public:
+    //! Shard: a range of whole documents that can be processed independently.
+    struct Shard {
+        qint64       first_document; //!< Index of the first document of the shard
+        qint64       num_documents;  //!< Number of documents in the shard
+        TextPosition offset;         //!< Position of the first token of the shard
+        TextPosition length;         //!< Length of the shard expressed in tokens
+    };
+
+    DocumentTable();
+
+    //! Returns the number of documents.
+    inline qint64 size() const { return _offsets.size(); }
+
+    //! Returns position of the first token of a document.
+    inline TextPosition offset(qint64 doc) const { return _offsets.at(doc); }
+
+    //! Returns positions of the first tokens of all documents in ascending order.
+    inline QVector<TextPosition> offsets() const { return _offsets.toVector(); }
+
+    //! Returns memory occupied by the offsets in bytes.
+    inline qint64 memoryUsage() const { return _offsets.memoryUsage(); }
+
+    void append(TextPosition offset);
+    void clear ();
+
+    qint64 find     (TextPosition pos) const;
+    bool   spans    (TextPosition offset, int n) const;
+    qint64 frequency(const QVector<TextPosition> *positions) const;
+    qint64 frequency(PostingsIterator positions) const;
+
+    QVector<Shard> split(int num_shards, TextPosition length) const;
+
+private:
+    PagedVector<TextPosition> _offsets; //!< Positions of the first tokens of documents, empty documents share them
+};
+
+#endif // _DOCUMENT_TABLE_H_
@@ -0,0 +1,56 @@
+#ifndef _DUPLICATE_DETECTOR_H_
+#define _DUPLICATE_DETECTOR_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+
+const double DEFAULT_DUPLICATE_THRESHOLD = 0.8; //!< Default estimated Jaccard similarity of near-duplicates
+const int    DEFAULT_SHINGLE_SIZE        = 4;   //!< Default number of tokens in a shingle
+const int    DEFAULT_MINHASH_BANDS       = 16;  //!< Default number of LSH bands
+const int    DEFAULT_MINHASH_ROWS        = 4;   //!< Default number of MinHash values per LSH band
+
+class QUBIQSHARED_EXPORT DuplicateDetector {
+
+public:
+    DuplicateDetector(double threshold    = DEFAULT_DUPLICATE_THRESHOLD,
+                      int    shingle_size = DEFAULT_SHINGLE_SIZE,
+                      int    num_bands    = DEFAULT_MINHASH_BANDS,
+                      int    num_rows     = DEFAULT_MINHASH_ROWS);
+
+    //! Returns the minimum estimated Jaccard similarity of shingles of near-duplicate documents.
+    inline double threshold() const { return _threshold; }
+
+    //! Returns the number of tokens in a shingle.
+    inline int shingleSize() const { return _shingle_size; }
+
+    //! Returns the number of documents checked so far.
+    inline int numDocuments() const { return _num_documents; }
+
+    //! Returns the number of documents found to be near-duplicates so far.
+    inline int numDuplicates() const { return _num_duplicates; }
+
+    bool isDuplicate(const QVector<QString>    &keys, int from = 0, int to = -1);
+    bool isDuplicate(const QVector<QByteArray> &keys, int from = 0, int to = -1);
+    void clear();
+
+private:
+    double _threshold;
+    int    _shingle_size;
+    int    _num_bands;
+    int    _num_rows;
+    int    _num_documents;
+    int    _num_duplicates;
+
+    QVector<quint64>                        _seeds;      //!< Seeds of MinHash functions
+    QVector< QHash<quint64, QVector<int> > > _buckets;    //!< Documents by hashes of their bands, per band
+    QVector< QVector<quint32> >             _signatures; //!< Signatures of documents kept so far
+
+    bool             check    (const QVector<quint32> &hashes);
+    QVector<quint32> signature(const QVector<quint32> &hashes) const;
+    double           similarity(const QVector<quint32> &s1, const QVector<quint32> &s2) const;
+
+    static quint32 key_hash(const QChar *chars, int len);
+    static quint32 key_hash(const QByteArray &key);
+};
+
+#endif // _DUPLICATE_DETECTOR_H_
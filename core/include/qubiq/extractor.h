@@ -8,6 +8,8 @@
 #include <qubiq/util/lexeme.h>
 #include <qubiq/util/lexeme_index.h>
 #include <qubiq/lexeme_sequence.h>
+#include <qubiq/text_snapshot.h>
+#include <qubiq/boundary_map.h>
 #include <qubiq/abstract_term_filter.h>
 
 const int    DEFAULT_MIN_BIGRAM_FREQUENCY         = 3;   //!< Default minimum bigram frequency
@@ -22,6 +24,7 @@ class QUBIQSHARED_EXPORT Extractor : public QObject {
 
 public:
     Extractor(const LexemeIndex *index);
+    Extractor(const QSharedPointer<const TextSnapshot> &snapshot);
     ~Extractor();
 
     bool extract(bool sort_terms = false);
@@ -115,6 +118,9 @@ public:
     //! Returns pointer to the lexeme index used for extraction.
     inline const LexemeIndex *index() const { return _index; }
 
+    //! Returns the text snapshot pinned by the extractor, if any.
+    inline QSharedPointer<const TextSnapshot> snapshot() const { return _snapshot; }
+
     //! Returns pointer to the list of extracted terms.
     inline const QList<LexemeSequence> *extracted() const { return _candidates; }
 
@@ -122,7 +128,12 @@ private:
     const LexemeIndex  *_index;
     AbstractTermFilter *_filter;
 
-    int    _txt_len; //!< Length of the original text expressed in tokens.
+    QSharedPointer<const TextSnapshot> _snapshot;       //!< Snapshot owning the index, if any
+    const DocumentTable               *_documents;      //!< Documents of the text, if known
+    const BoundaryMap                 *_boundaries;     //!< Boundary tokens of the text
+    BoundaryMap                        _own_boundaries; //!< Boundary tokens built from the index if not pinned
+
+    TextPosition _txt_len; //!< Length of the original text expressed in tokens.
     int     _min_bf; //!< Minimum bigram frequency
     double _min_bs;  //!< Minimum bigram score
     double _max_ser; //!< Maximum source extraction rate
@@ -135,9 +146,11 @@ private:
 
     void _initialize();
     void _destroy();
+    void _set_defaults(const LexemeIndex *index);
 
     bool collect_good_bigrams();
     bool is_good_bigram   (const LexemeSequence &bigram) const;
+    bool spans_documents  (TextPosition offset, int n) const;
     bool treat_as_term    (const LexemeSequence &bigram, int num_expansions) const;
     int  expand           (const LexemeSequence &candidate, bool is_left_expanded);
     bool validate_expanded(const LexemeSequence &expanded, const LexemeSequence &source) const;
@@ -0,0 +1,55 @@
+#ifndef _INDEX_BUILDER_H_
+#define _INDEX_BUILDER_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/text.h>
+#include <qubiq/abstract_segment_writer.h>
+#include <qubiq/snapshot_layout.h>
+
+const qint64 DEFAULT_MEMORY_BUDGET = 1073741824; //!< Default memory budget of an index build in bytes
+
+class QUBIQSHARED_EXPORT IndexBuilder : public AbstractSegmentWriter {
+
+public:
+    IndexBuilder(Text *text, const QString &segment_path, qint64 memory_budget = DEFAULT_MEMORY_BUDGET);
+    virtual ~IndexBuilder();
+
+    //! Returns the text input is appended to. The text only holds the current segment.
+    inline Text* text() const { return _text; }
+
+    //! Returns the memory budget in bytes.
+    virtual qint64 memoryBudget() const { return _memory_budget; }
+
+    //! Returns the number of segments flushed to disk so far.
+    inline int numSegments() const { return _segments.size(); }
+
+    bool append     (const QString &buffer);
+    bool appendFile (const QString &fname);
+    bool appendFiles(const QStringList &fnames);
+
+    virtual bool flush();
+    bool finish(const QString &fname);
+
+private:
+    //! Segment: mapped segment snapshot and the layout of its sections.
+    struct Segment {
+        QFile          *file;
+        const uchar    *data;
+        SnapshotLayout  layout;
+    };
+
+    Text        *_text;
+    QString      _segment_path;
+    qint64       _memory_budget;
+    QStringList  _segments; //!< File names of segments flushed so far
+
+    bool flush_if_needed();
+    void remove_segments();
+
+    static bool open_segment (const QString &fname, Segment *segment);
+    static void close_segment(Segment *segment);
+    static bool merge_index  (const QVector<Segment> &segments, int which, QDataStream *out);
+};
+
+#endif // _INDEX_BUILDER_H_
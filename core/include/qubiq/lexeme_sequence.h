@@ -27,7 +27,7 @@ public:
 
     LexemeSequence();
     LexemeSequence(const LexemeSequence &other);
-    LexemeSequence(const LexemeIndex *index, int offset, int n, int n1);
+    LexemeSequence(const LexemeIndex *index, TextPosition offset, int n, int n1);
     ~LexemeSequence();
 
     LexemeSequence &operator =(const LexemeSequence &other);
@@ -64,7 +64,7 @@ public:
     //! Returns a pointer to the vector of all offsets of the first lexeme
     //! in the source text.
     //! \sa LexemeIndex::positions
-    inline const QVector<int>* positions() const { return _pos; }
+    inline const QVector<TextPosition>* positions() const { return _pos; }
 
     //! Returns a key of the sequence, a special internal value for implementing hashes and sets of sequences.
     inline const QByteArray* key() const { return _key; }
@@ -122,12 +122,12 @@ private:
     int _led; //!< Left Expansion Distance
     int _red; //!< Right Expansion Disatnce
 
-    int _txt_len; //!< Length of the original text expressed in tokens.
+    TextPosition _txt_len; //!< Length of the original text expressed in tokens.
 
     const LexemeIndex  *_index; //!< Lexeme index to derive sequences from.
     QByteArray         *_key;   //!< Sequence key for hashing.
     QVector<Lexeme*>   *_seq;   //!< Vector of pointers to lexemes the sequence actually consists of.
-    QVector<int>       *_pos;   //!< Vector of positions of the sequence in the text.
+    QVector<TextPosition> *_pos; //!< Vector of positions of the sequence in the text.
 
     /**
      * \brief Auxiliary function for counting log-likelihood ratio.
@@ -139,7 +139,7 @@ private:
      * \param[in] k Number of successes.
      * \param[in] n Number of trials.
      */
-    inline double ll(double p, int k, int n) const {
+    inline double ll(double p, TextPosition k, TextPosition n) const {
         return k * log(p) + (n - k) * log(1 - p);
     }
 
@@ -149,12 +149,12 @@ private:
 
     void add_to_key(Lexeme *lexeme);
 
-    LexemeSequenceState calculate_state  (const LexemeIndex *index, int offset, int n, int n1);
-    LexemeSequenceState build_sequence   (int offset, int n);
-    LexemeSequenceState calculate_metrics(int offset, int n, int n1);
+    LexemeSequenceState calculate_state  (const LexemeIndex *index, TextPosition offset, int n, int n1);
+    LexemeSequenceState build_sequence   (TextPosition offset, int n);
+    LexemeSequenceState calculate_metrics(TextPosition offset, int n, int n1);
 
-    int  calculate_frequency(int offset, int n, bool collect_pos = false);
-    bool is_sequence        (int text_offset, int sequence_offset, int n) const;
+    int  calculate_frequency(TextPosition offset, int n, bool collect_pos = false);
+    bool is_sequence        (TextPosition text_offset, TextPosition sequence_offset, int n) const;
 };
 
 /**
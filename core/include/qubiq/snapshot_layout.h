@@ -0,0 +1,63 @@
+#ifndef _SNAPSHOT_LAYOUT_H_
+#define _SNAPSHOT_LAYOUT_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+
+const qint32 TEXT_SNAPSHOT_FORMAT_MARKER  = 0x51555458; //!< QUTX = Qubiq Util TeXt
+const qint32 TEXT_SNAPSHOT_FORMAT_VERSION = 2;
+
+class QUBIQSHARED_EXPORT SnapshotLayout {
+
+public:
+    //! Index: offsets of the parts of an index section.
+    struct Index {
+        qint32 num_lexemes;
+        qint32 names_size;
+        qint64 flags_pos;
+        qint64 offsets_pos;
+        qint64 names_pos;
+        qint64 ids_pos;
+        qint64 end_pos;
+    };
+
+    SnapshotLayout();
+
+    bool parse(const uchar *data, qint64 size);
+
+    //! Returns the format version of the snapshot.
+    inline qint32 version() const { return _version; }
+
+    //! Returns the length of the text in tokens.
+    inline qint32 length() const { return _length; }
+
+    //! Returns the number of stored offsets of documents, 0 for version 1.
+    inline qint32 numDocuments() const { return _num_documents; }
+
+    //! Returns the offset of the \c i-th document stored.
+    inline qint32 documentOffset(qint32 i) const { return qFromLittleEndian<qint32>(_data + DOCUMENTS_POS + 4 * (qint64)i); }
+
+    //! Returns the layout of the index of wordforms (0) or the index of lexemes (1).
+    inline const Index& index(int which) const { return _indeces[which]; }
+
+    //! Returns the lexeme ID at a position of an index, -1 if the position is not covered.
+    inline qint32 id(const Index &index, qint32 pos) const { return qFromLittleEndian<qint32>(_data + index.ids_pos + 4 * (qint64)pos); }
+
+    //! Returns the \c LexemeFeature flags of a lexeme of an index.
+    inline quint8 features(const Index &index, qint32 id) const { return _data[index.flags_pos + id]; }
+
+    bool name(const Index &index, qint32 id, QByteArray *name) const;
+
+private:
+    enum { DOCUMENTS_POS = 16 };
+
+    const uchar *_data;
+    qint32       _version;
+    qint32       _length;
+    qint32       _num_documents;
+    Index        _indeces[2];
+
+    static bool parse_index(qint64 offset, qint64 size, const uchar *data, qint32 length, Index *index);
+};
+
+#endif // _SNAPSHOT_LAYOUT_H_
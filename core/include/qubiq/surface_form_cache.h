@@ -0,0 +1,51 @@
+#ifndef _SURFACE_FORM_CACHE_H_
+#define _SURFACE_FORM_CACHE_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/util/lexeme.h>
+
+const int DEFAULT_SURFACE_FORM_CACHE_SIZE = 65536; //!< Default number of surface forms kept in the cache
+const int SURFACE_FORM_CACHE_MAX_PROBES   = 4;     //!< Slots examined per lookup before giving up
+
+class QUBIQSHARED_EXPORT SurfaceFormCache {
+
+public:
+    SurfaceFormCache(int capacity = DEFAULT_SURFACE_FORM_CACHE_SIZE);
+
+    //! Returns the maximum number of surface forms kept in the cache.
+    inline int capacity() const { return _slots.size(); }
+
+    //! Returns the number of lookups that found a surface form in the cache.
+    inline qint64 hits() const { return _hits; }
+
+    //! Returns the number of lookups that did not find a surface form in the cache.
+    inline qint64 misses() const { return _misses; }
+
+    //! Returns the share of successful lookups, a value in range [0, 1].
+    inline double hitRate() const {
+        return _hits + _misses > 0? (double)_hits / (_hits + _misses) : 0.0;
+    }
+
+    Lexeme* find  (const QStringRef &surface);
+    void    insert(const QStringRef &surface, Lexeme *lexeme);
+    void    clear ();
+    void    resize(int capacity);
+
+private:
+    //! Slot: a cached surface form with its hash and the lexeme it is indexed as.
+    struct Slot {
+        Slot() : hash(0), lexeme(NULL) {}
+
+        uint     hash;
+        QString  surface;
+        Lexeme  *lexeme;
+    };
+
+    QVector<Slot> _slots;
+    uint          _mask;   //!< Capacity minus one, capacity being a power of two
+    qint64        _hits;
+    qint64        _misses;
+};
+
+#endif // _SURFACE_FORM_CACHE_H_
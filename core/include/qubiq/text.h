@@ -1,24 +1,96 @@
 #ifndef _TEXT_H_
 #define _TEXT_H_
 
+#include <algorithm>
+#include <limits>
 #include <QtCore>
 #include <cutelogger/include/Logger.h>
 #include <qubiq/qubiq_global.h>
+#include <qubiq/tokenizer.h>
+#include <qubiq/surface_form_cache.h>
+#include <qubiq/block_queue.h>
+#include <qubiq/document_table.h>
+#include <qubiq/boundary_map.h>
+#include <qubiq/abstract_lemmatizer.h>
+#include <qubiq/abstract_segment_writer.h>
+#include <qubiq/duplicate_detector.h>
+#include <qubiq/text_snapshot.h>
+#include <qubiq/snapshot_layout.h>
 #include <qubiq/util/lexeme.h>
 #include <qubiq/util/lexeme_index.h>
 
 const qint64 DEFAULT_READ_BUFFER_SIZE = 80;
+const qint64 DEFAULT_MAP_WINDOW_SIZE  = 1048576; //!< Bytes decoded at once when reading memory-mapped files
+const qint64 DEFAULT_CHUNK_SIZE       = 4194304; //!< Default size of a file chunk tokenized by a single thread
+const qint64 MAX_CHUNK_SIZE           = 268435456; //!< Chunks are decoded into strings, which hold less than 2^30 characters
+const int    DEFAULT_GZIP_BLOCK_SIZE  = 1048576; //!< Bytes of decompressed input passed to the tokenizer at once
+const int    DEFAULT_GZIP_QUEUE_SIZE  = 4;       //!< Decompressed blocks kept ahead of the tokenizer
+const int    DEFAULT_READ_AHEAD_FILES = 64;      //!< Files of a directory read ahead of the tokenizer
+
+const qint64 DEFAULT_STATUS_UPDATE_SIZE = 16777216; //!< Bytes of input read between two status updates
+const qint64 DEFAULT_BUDGET_CHECK_SIZE  = 65536;    //!< Least number of tokens appended between two checks of the memory budget
+
+//! Features of wordforms passed on to their lexemes, others describe keys and are computed per lexeme
+const quint8 WORDFORM_LEXEME_FEATURES = Lexeme::FEATURE_CAPITALIZED | Lexeme::FEATURE_STOPWORD;
+
+/**
+ * \brief The TextStats struct holds counters and timings of indexing a text.
+ *
+ * Timings are in nanoseconds. Time spent by worker threads is summed up over threads.
+ *
+ * \sa Text::stats
+ */
+struct TextStats {
+    TextStats()
+        : bytes_read(0), tokens(0), whitespace_tokens(0), new_wordforms(0), new_lexemes(0),
+          duplicate_documents(0), duplicate_tokens(0), tokenize_nsecs(0), index_nsecs(0) {}
+
+    qint64 bytes_read;          //!< Bytes of input read, decompressed bytes for gzip files
+    qint64 tokens;              //!< Tokens produced by the tokenizer, whitespace included
+    qint64 whitespace_tokens;   //!< Whitespace tokens dropped
+    qint64 new_wordforms;       //!< Wordforms added to the index of wordforms
+    qint64 new_lexemes;         //!< Lexemes added to the index of lexemes by the lemmatizer
+    qint64 duplicate_documents; //!< Near-duplicate documents dropped before indexing
+    qint64 duplicate_tokens;    //!< Non-whitespace tokens of dropped documents
+    qint64 tokenize_nsecs;      //!< Time spent finding and classifying tokens
+    qint64 index_nsecs;         //!< Time spent adding tokens to the indeces
+
+    //! Returns the number of non-whitespace tokens per second of tokenizing and indexing.
+    inline double tokensPerSecond() const {
+        const qint64 nsecs = tokenize_nsecs + index_nsecs;
+        return nsecs > 0? (double)(tokens - whitespace_tokens) * 1e9 / nsecs : 0.0;
+    }
+
+    inline TextStats& operator +=(const TextStats &other) {
+        bytes_read          += other.bytes_read;
+        tokens              += other.tokens;
+        whitespace_tokens   += other.whitespace_tokens;
+        new_wordforms       += other.new_wordforms;
+        new_lexemes         += other.new_lexemes;
+        duplicate_documents += other.duplicate_documents;
+        duplicate_tokens    += other.duplicate_tokens;
+        tokenize_nsecs      += other.tokenize_nsecs;
+        index_nsecs         += other.index_nsecs;
+        return *this;
+    }
+};
 
 class QUBIQSHARED_EXPORT Text: public QObject {
     Q_OBJECT
 
+    friend class ChunkTokenizer;
+    friend class FileTokenizer;
+    friend class BlockTokenizer;
+    friend class BatchTokenizer;
+    friend class DirectoryReader;
+
 public:
     Text(const QLocale &locale);
     Text();
     ~Text();
 
     //! Returns length of the text expressed in tokens.
-    inline int length() const { return idx_wf->numUniquePositions(); }
+    inline TextPosition length() const { return idx_wf->numUniquePositions(); }
 
     //! Returns a pointer to the index of wordforms assosiated with the text.
     //! \sa lexemes
@@ -28,21 +100,263 @@ public:
     //! \sa wordforms
     inline LexemeIndex* lexemes() const { return idx_lex; }
 
-    bool appendFile(const QString &fname);
-    bool appendFile(FILE *fd);
-    bool append    (const QString &buffer);
+    /**
+     * Returns the table of documents the text is made of. Each file or buffer
+     * appended to the text starts a new document.
+     *
+     * \sa shards
+     */
+    inline const DocumentTable& documents() const { return _documents; }
+
+    //! Returns the map of boundary tokens of the text, filled while the text is being indexed.
+    inline const BoundaryMap& boundaries() const { return _boundaries; }
+
+    //! Returns the number of documents containing a wordform.
+    inline qint64 documentFrequency(const QString &wordform) const { return _documents.frequency(idx_wf->postings(wordform)); }
+
+    //! Splits the text into at most \c num_shards ranges of whole documents.
+    //! \sa DocumentTable::split
+    inline QVector<DocumentTable::Shard> shards(int num_shards) const { return _documents.split(num_shards, length()); }
+
+    /**
+     * Returns \c true if files appended by name are memory-mapped instead of
+     * being read through a stream.
+     *
+     * \sa setMemoryMapping
+     */
+    inline bool memoryMapping() const { return _use_mmap; }
+    //! Enables or disables memory-mapped ingestion of files appended by name.
+    inline void setMemoryMapping(bool use_mmap) { _use_mmap = use_mmap; }
+
+    /**
+     * Returns the number of threads used for tokenizing large files.
+     *
+     * Files larger than \c chunkSize are split into chunks which are
+     * tokenized concurrently if this value is greater than 1.
+     *
+     * \sa setNumThreads
+     * \sa chunkSize
+     */
+    inline int numThreads() const { return _num_threads; }
+    //! Sets the number of threads used for tokenizing large files.
+    inline void setNumThreads(int num_threads) { _num_threads = num_threads > 1? num_threads : 1; }
+
+    //! Returns approximate size of a file chunk tokenized by a single thread (in bytes).
+    //! \sa numThreads
+    inline qint64 chunkSize() const { return _chunk_size; }
+    //! Sets approximate size of a file chunk tokenized by a single thread (in bytes).
+    inline void setChunkSize(qint64 chunk_size) {
+        _chunk_size = chunk_size > 0? qMin(chunk_size, MAX_CHUNK_SIZE) : DEFAULT_CHUNK_SIZE;
+    }
+
+    /**
+     * Returns the cache mapping surface forms of tokens to wordforms they are indexed as.
+     * Statistics of the cache can be used for choosing its size.
+     * \sa setSurfaceFormCacheSize
+     */
+    inline const SurfaceFormCache& surfaceForms() const { return _surface_forms; }
+    //! Sets the number of surface forms kept in the cache. Cached surface forms are dropped.
+    //! \sa surfaceForms
+    inline void setSurfaceFormCacheSize(int size) { _surface_forms.resize(size); }
+
+    /**
+     * Returns \c true if UTF-8 input is tokenized and interned as raw bytes
+     * instead of being decoded first.
+     *
+     * \sa setUtf8Pipeline
+     * \sa appendUtf8
+     */
+    inline bool utf8Pipeline() const { return _use_utf8; }
+    //! Enables or disables tokenizing UTF-8 files appended by name as raw bytes.
+    inline void setUtf8Pipeline(bool use_utf8) { _use_utf8 = use_utf8; }
+
+    /**
+     * Returns the lemmatizer filling the index of lexemes while the text is being indexed.
+     * The lemmatizer should be set before anything is appended to the text, otherwise the
+     * index of lexemes does not cover the whole text.
+     *
+     * \sa setLemmatizer
+     */
+    inline AbstractLemmatizer* lemmatizer() const { return _lemmatizer; }
+    //! Sets the lemmatizer, \c NULL disables lemmatization. The lemmatizer is not owned by the text.
+    inline void setLemmatizer(AbstractLemmatizer *lemmatizer) { _lemmatizer = lemmatizer; _lemmas.clear(); }
+
+    /**
+     * Returns the detector dropping near-duplicate documents before their tokens
+     * reach the indeces, \c NULL if deduplication is disabled.
+     *
+     * Documents are tokenized whole before being checked, so large files are not
+     * split into chunks tokenized concurrently while deduplication is enabled.
+     * Dropped documents are counted in \c stats.
+     *
+     * \sa setDuplicateDetector
+     */
+    inline DuplicateDetector* duplicateDetector() const { return _duplicates; }
+    //! Sets the detector of near-duplicate documents, \c NULL disables deduplication. The detector is not owned by the text.
+    inline void setDuplicateDetector(DuplicateDetector *detector) { _duplicates = detector; }
+
+    /**
+     * Returns \c true if positions of frequent lexemes are compressed in published snapshots.
+     * Such snapshots are copied from the indeces as a whole instead of sharing data with
+     * the previous snapshot.
+     *
+     * \sa setCompressedPostings
+     * \sa LexemeIndex::compress
+     */
+    inline bool compressedPostings() const { return _compress_postings; }
+    //! Enables or disables compressing positions of frequent lexemes in published snapshots.
+    inline void setCompressedPostings(bool compress_postings) { _compress_postings = compress_postings; }
+
+    /**
+     * Returns the writer flushing the text to disk once it exceeds the memory budget of
+     * the writer, \c NULL if the text is kept in memory as a whole.
+     *
+     * The budget is checked between buffers of input once \c DEFAULT_BUDGET_CHECK_SIZE tokens
+     * were appended since the last check, so a single input larger than the budget is split
+     * into segments. A document being appended when the text is flushed goes on in the next segment.
+     *
+     * \sa setSegmentWriter
+     * \sa memoryUsage
+     */
+    inline AbstractSegmentWriter* segmentWriter() const { return _segment_writer; }
+    //! Sets the writer flushing the text once it exceeds a memory budget, \c NULL disables flushing. The writer is not owned by the text.
+    inline void setSegmentWriter(AbstractSegmentWriter *writer) { _segment_writer = writer; }
+
+    /**
+     * Returns the number of positions lexemes of published snapshots are switched to
+     * bitmaps at, 0 if bitmaps are disabled. Such snapshots are copied from the indeces
+     * as a whole, while the indeces of the text keep positions as vectors.
+     *
+     * \sa setBitmapThreshold
+     * \sa LexemeIndex::setBitmapThreshold
+     */
+    inline int bitmapThreshold() const { return _bitmap_threshold; }
+    //! Sets the number of positions lexemes of published snapshots are switched to bitmaps at, 0 or less to disable bitmaps.
+    inline void setBitmapThreshold(int threshold) { _bitmap_threshold = qMax(threshold, 0); }
+
+    //! Returns keys of the stopwords of the text.
+    //! \sa setStopwords
+    inline const QSet<QString>& stopwords() const { return _stopwords; }
+    void setStopwords(const QStringList &stopwords);
+
+    /**
+     * Returns counters and timings collected while indexing the text.
+     *
+     * \sa resetStats
+     * \sa appendStatusUpdate
+     */
+    inline const TextStats& stats() const { return _stats; }
+    //! Resets counters and timings.
+    inline void resetStats() { _stats = TextStats(); _reported_bytes = 0; }
+
+    bool appendFile (const QString &fname);
+    bool appendFile (FILE *fd);
+    bool appendFiles(const QStringList &fnames, int num_threads = 0);
+    bool appendDirectory(const QString &path, const QStringList &name_filters = QStringList(), int num_threads = 1);
+    bool append     (const QString &buffer);
+    bool appendUtf8 (const QByteArray &buffer);
+    bool appendMany (const QVector<QByteArray> &documents, int num_threads = 1);
+    bool appendMany (const QVector<QStringRef> &documents, int num_threads = 1);
+
+    bool save(const QString &fname) const;
+    bool load(const QString &fname);
+
+    void   clear();
+    qint64 memoryUsage() const;
+
+    QSharedPointer<const TextSnapshot> publish ();
+    QSharedPointer<const TextSnapshot> snapshot() const;
+
+signals:
+    /**
+     * \brief Signal emitted while input is being appended, roughly every \c DEFAULT_STATUS_UPDATE_SIZE
+     * bytes of input, and when appending a file is finished.
+     * \param[in] bytes_read Bytes of input read so far.
+     * \param[in] num_tokens Number of tokens in the text.
+     */
+    void appendStatusUpdate(qint64 bytes_read, qint64 num_tokens);
 
 private:
-    QLocale _locale;
+    QLocale          _locale;
+    Tokenizer        _tokenizer;
+    SurfaceFormCache _surface_forms; //!< Surface forms of tokens seen in the text
+    bool             _fold_latin1;   //!< Whether Latin-1 tokens can be lowercased bypassing the locale
+    bool             _use_mmap;      //!< Whether files appended by name are memory-mapped
+    bool             _use_utf8;      //!< Whether UTF-8 files are tokenized without decoding
+    bool             _compress_postings; //!< Whether published snapshots compress positions of frequent lexemes
+    int              _bitmap_threshold;  //!< Number of positions lexemes of published snapshots are switched to bitmaps at
+    int              _num_threads;   //!< Number of threads used for tokenizing large files
+    qint64           _chunk_size;    //!< Approximate size of a file chunk tokenized by a single thread
+
+    QHash<QByteArray, Lexeme*> _utf8_keys; //!< Wordforms by UTF-8 encoded keys
+    DocumentTable              _documents; //!< Offsets of documents appended to the text
+    BoundaryMap                _boundaries; //!< Boundary tokens by position
+    AbstractLemmatizer        *_lemmatizer; //!< Lemmatizer filling the index of lexemes, if any
+    DuplicateDetector         *_duplicates; //!< Detector of near-duplicate documents, if any
+    TextStats                  _stats;
+    qint64                     _reported_bytes; //!< Bytes read at the moment of the last status update
+    AbstractSegmentWriter     *_segment_writer; //!< Writer flushing the text once it exceeds a memory budget, if any
+    qint64                     _budget_check_pos; //!< Length of the text to check the memory budget at
+    QHash<const Lexeme*, Lexeme*> _lemmas;  //!< Lexemes by wordforms seen since the lemmatizer was set
+    QSet<QString>              _stopwords;  //!< Keys of stopwords
+
+    mutable QMutex                     _snapshot_lock; //!< Guards the latest published snapshot
+    QSharedPointer<const TextSnapshot> _snapshot;      //!< Latest published snapshot
+    quint64                            _generation;    //!< Number of snapshots published so far
 
     LexemeIndex *idx_wf;  //!< Index of word forms built on the text
     LexemeIndex *idx_lex; //!< Index of lexemes built on the text
 
+    bool     append_opened_file (QFile *file);
     bool     append_file        (QFile *file);
-    bool     is_boundary_token  (const QStringRef &token);
-    bool     is_whitespace_token(const QStringRef &token);
-    QString* normalize_token    (const QStringRef &token, bool is_boundary);
-    bool     process_token      (const QStringRef &token);
+    bool     append_mapped_file (QFile *file);
+    bool     append_chunked     (const char *bytes, qint64 size, QTextCodec *codec);
+    void     append_utf8        (const char *bytes, qint64 size);
+    bool     append_gzip_file   (const QString &fname);
+    bool     append_batches     (const QByteArray *utf8_documents, const QStringRef *documents, int size, int num_threads);
+    void     append_document    (const QString &buffer);
+    void     append_utf8_document(const char *bytes, qint64 size);
+    bool     append_whole_file  (const QString &fname);
+    int      process_buffer     (const QString &buffer, bool is_final);
+    int      process_utf8_buffer(const char *bytes, int len, bool is_final);
+    int      tokenize_buffer    (const QString &buffer, bool is_final, QVector<QString> *keys,
+                                 QVector<int> *capitalized, TextStats *stats) const;
+    int      tokenize_utf8_buffer(const char *bytes, int len, bool is_final, QVector<QByteArray> *keys,
+                                 QVector<int> *capitalized, TextStats *stats) const;
+    void     tokenize_utf8_contents(const char *bytes, qint64 size, QVector<QByteArray> *keys,
+                                 QVector<int> *capitalized, TextStats *stats) const;
+    bool     tokenize_file      (const QString &fname, QVector<QString> *keys, QVector<QByteArray> *utf8_keys,
+                                 QVector<int> *capitalized, TextStats *stats) const;
+    bool     tokenize_gzip_file (const QString &fname, QVector<QString> *keys, QVector<QByteArray> *utf8_keys,
+                                 QVector<int> *capitalized, TextStats *stats) const;
+    Lexeme*  normalize_token    (Lexeme *wordform, TextPosition pos);
+    void     complete_position  (Lexeme *wordform);
+    QString  token_key          (const QStringRef &token) const;
+    void     utf8_token_key     (const Tokenizer::Utf8Token &token, QByteArray *key) const;
+    bool     process_token      (const Tokenizer::Token &token);
+    bool     process_utf8_token (const Tokenizer::Utf8Token &token, QByteArray *key);
+    Lexeme*  index_key          (const QString &key, bool *is_new);
+    Lexeme*  index_utf8_key     (const QByteArray &key, bool *is_new);
+    void     index_keys         (const QVector<QString> &keys, const QVector<int> &capitalized, int from = 0, int to = -1);
+    void     index_utf8_keys    (const QVector<QByteArray> &keys, const QVector<int> &capitalized, int from = 0, int to = -1);
+    bool     index_document     (const QVector<QString> &keys, const QVector<int> &capitalized, int from = 0, int to = -1);
+    bool     index_utf8_document(const QVector<QByteArray> &keys, const QVector<int> &capitalized, int from = 0, int to = -1);
+    quint8   key_features       (const QString &key) const;
+    bool     is_utf8_codec      (QTextCodec *codec) const;
+    void     start_document     ();
+    void     report_status      (bool is_forced);
+    void     check_memory_budget();
+
+    static void save_index(QDataStream *out, const LexemeIndex *index, int length);
+    static bool load_index(const SnapshotLayout &layout, int which, LexemeIndex *index);
+
+    static qint64      find_split_point(const char *bytes, qint64 size, qint64 from);
+    static int         utf8_bom_size   (const char *bytes, qint64 size);
+    static bool        is_gzip         (const QByteArray &header);
+    static QTextCodec* detect_codec    (const char *bytes, qint64 size);
+    static bool        is_larger_file  (const QPair<qint64, int> &f1, const QPair<qint64, int> &f2);
+    static bool        is_capitalized  (const QStringRef &token);
+    static bool        is_capitalized  (const Tokenizer::Utf8Token &token);
 
     void _initialize(const QLocale &locale);
 };
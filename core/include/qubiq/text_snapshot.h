@@ -0,0 +1,53 @@
+#ifndef _TEXT_SNAPSHOT_H_
+#define _TEXT_SNAPSHOT_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/document_table.h>
+#include <qubiq/boundary_map.h>
+#include <qubiq/util/lexeme.h>
+#include <qubiq/util/lexeme_index.h>
+
+class QUBIQSHARED_EXPORT TextSnapshot {
+
+public:
+    TextSnapshot(const LexemeIndex &wordforms, const LexemeIndex &lexemes, const DocumentTable &documents,
+                 const BoundaryMap &boundaries, quint64 generation, bool compress_postings = false,
+                 int bitmap_threshold = 0);
+    TextSnapshot(LexemeIndex *wordforms, LexemeIndex *lexemes, const DocumentTable &documents,
+                 const BoundaryMap &boundaries, quint64 generation);
+    ~TextSnapshot();
+
+    //! Returns the number of the snapshot, snapshots published later have greater numbers.
+    inline quint64 generation() const { return _generation; }
+
+    //! Returns length of the text at the moment of publishing expressed in tokens.
+    inline TextPosition length() const { return _wordforms->numUniquePositions(); }
+
+    //! Returns a pointer to the frozen index of wordforms.
+    //! \sa lexemes
+    inline const LexemeIndex* wordforms() const { return _wordforms; }
+
+    //! Returns a pointer to the frozen index of lexemes.
+    //! \sa wordforms
+    inline const LexemeIndex* lexemes() const { return _lexemes; }
+
+    //! Returns the table of documents appended to the text before publishing.
+    inline const DocumentTable& documents() const { return _documents; }
+
+    //! Returns the map of boundary tokens at the moment of publishing.
+    inline const BoundaryMap& boundaries() const { return _boundaries; }
+
+private:
+    Q_DISABLE_COPY(TextSnapshot)
+
+    quint64       _generation;
+    LexemeIndex  *_wordforms;
+    LexemeIndex  *_lexemes;
+    DocumentTable _documents;
+    BoundaryMap   _boundaries;
+
+    static void copy_index(const LexemeIndex &source, LexemeIndex *target);
+};
+
+#endif // _TEXT_SNAPSHOT_H_
@@ -0,0 +1,122 @@
+#ifndef _TOKENIZER_H_
+#define _TOKENIZER_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+
+const int TOKENIZER_TABLE_SIZE = 0x2070; //!< Characters covered by the character class table (up to General Punctuation)
+
+class QUBIQSHARED_EXPORT Tokenizer {
+
+public:
+    //! TokenType: enumeration for indicating classes of tokens.
+    enum TokenType {
+        TOKEN_WORD       = 0, //!< Token containing at least one non-punctuation character.
+        TOKEN_WHITESPACE = 1, //!< Token consisting of whitespace characters only.
+        TOKEN_BOUNDARY   = 2  //!< Token consisting of punctuation characters only.
+    };
+
+    //! Token: a slice of the tokenized buffer together with its class.
+    struct Token {
+        Token() : type(TOKEN_WORD) {}
+        Token(const QStringRef &_text, TokenType _type) : text(_text), type(_type) {}
+
+        QStringRef text;
+        TokenType  type;
+    };
+
+    //! Utf8Token: a slice of the tokenized UTF-8 buffer together with its class.
+    struct Utf8Token {
+        Utf8Token() : data(NULL), size(0), type(TOKEN_WORD) {}
+        Utf8Token(const char *_data, int _size, TokenType _type) : data(_data), size(_size), type(_type) {}
+
+        const char *data;
+        int         size;
+        TokenType   type;
+    };
+
+    Tokenizer();
+
+    int tokenize    (const QString &buffer, bool is_final, QVector<Token> *tokens) const;
+    int tokenizeUtf8(const char *bytes, int len, bool is_final, QVector<Utf8Token> *tokens) const;
+
+    static TokenType classify    (const QStringRef &token);
+    static bool      isWhitespace(const QStringRef &token);
+    static bool      isBoundary  (const QStringRef &token);
+
+    static bool toLowerLatin1(const QChar *src, int len, QChar *dst);
+    static bool toLowerAscii (const char *src, int len, char *dst);
+
+    /**
+     * \brief Detects whether a character is a punctuation character.
+     * \param[in] c Character to be checked.
+     * \returns \c true if the character can be a part of a boundary token and \c false otherwise.
+     */
+    static inline bool isBoundaryChar(QChar c) {
+        return c.isPunct()
+            ||  c < 0x30              // includes chars like '*', '+', etc.
+            || (c > 0x39 && c < 0x41) // includes chars like '<', '>', etc.
+            || (c > 0x5A && c < 0x61) // includes chars like '^', '`', etc.
+            || (c > 0x7A && c < 0x7F) // includes chars like '|', '~', etc.
+        ;
+    }
+
+private:
+    //! CharClass: word break classes of characters covered by the table.
+    enum CharClass {
+        CC_FALLBACK      = 0, //!< Not covered: spans containing it are split by QTextBoundaryFinder
+        CC_SPACE         = 1, //!< Whitespace
+        CC_LETTER        = 2, //!< Letter of Latin, Greek or Cyrillic script
+        CC_DIGIT         = 3, //!< Decimal digit
+        CC_EXTENDNUMLET  = 4, //!< Connector, like '_'
+        CC_MIDLETTER     = 5, //!< Joins letters, like ':'
+        CC_MIDNUM        = 6, //!< Joins digits, like ','
+        CC_MIDNUMLET     = 7, //!< Joins both letters and digits, like '.'
+        CC_SINGLE        = 8  //!< Any other character forming a token on its own
+    };
+
+    static const quint8 CC_MASK       = 0x0F;
+    static const quint8 FLAG_BOUNDARY = 0x10;
+
+    quint8 _classes[TOKENIZER_TABLE_SIZE]; //!< Character class table with boundary flags
+
+    //! \internal Returns class of a character.
+    inline quint8 char_class(QChar c) const {
+        return c.unicode() < TOKENIZER_TABLE_SIZE? (_classes[c.unicode()] & CC_MASK) : (quint8)CC_FALLBACK;
+    }
+
+    //! \internal Returns \c true if a character of class \c cc is a part of a word.
+    static inline bool is_word_class(quint8 cc) {
+        return cc == CC_LETTER || cc == CC_DIGIT || cc == CC_EXTENDNUMLET;
+    }
+
+    /**
+     * \internal Returns class of a character of a UTF-8 buffer together with its flags.
+     * \param[in]  bytes Bytes of the buffer.
+     * \param[in]  len   Length of the buffer in bytes.
+     * \param[in]  pos   Offset of the first byte of the character.
+     * \param[out] size  Number of bytes the character occupies.
+     */
+    inline quint8 utf8_char_class(const char *bytes, int len, int pos, int *size) const {
+        const uchar b = (uchar)bytes[pos];
+        if (b < 0x80) {
+            *size = 1;
+            return _classes[b];
+        }
+        const uint cp = decode_utf8(bytes, len, pos, size);
+        return cp < (uint)TOKENIZER_TABLE_SIZE? _classes[cp] : (quint8)CC_FALLBACK;
+    }
+
+    static uint decode_utf8    (const char *bytes, int len, int pos, int *size);
+    static int  ascii_alnum_run(const QChar *chars, int len);
+    static int  ascii_alnum_run(const char *bytes, int len);
+
+    int  scan_word          (const QChar *chars, int len, int pos, bool *is_boundary) const;
+    int  scan_word_utf8     (const char *bytes, int len, int pos, bool *is_boundary) const;
+    void split_fallback     (const QString &buffer, int start, int end, QVector<Token> *tokens) const;
+    void split_fallback_utf8(const char *bytes, int start, int end, QVector<Utf8Token> *tokens) const;
+
+    void _initialize_classes();
+};
+
+#endif // _TOKENIZER_H_
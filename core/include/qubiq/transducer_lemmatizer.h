@@ -0,0 +1,23 @@
+#ifndef _TRANSDUCER_LEMMATIZER_H_
+#define _TRANSDUCER_LEMMATIZER_H_
+
+#include <QtCore>
+#include <qubiq/qubiq_global.h>
+#include <qubiq/abstract_lemmatizer.h>
+#include <qubiq/util/transducer.h>
+
+class QUBIQSHARED_EXPORT TransducerLemmatizer : public AbstractLemmatizer {
+
+public:
+    TransducerLemmatizer(const Transducer *transducer);
+
+    //! Returns the transducer lemmas are looked up in.
+    inline const Transducer* transducer() const { return _transducer; }
+
+    virtual QString lemmatize(const QString &wordform);
+
+private:
+    const Transducer *_transducer;
+};
+
+#endif // _TRANSDUCER_LEMMATIZER_H_
@@ -0,0 +1,73 @@
+#include <qubiq/block_queue.h>
+
+/**
+ * \class BlockQueue
+ *
+ * \brief The BlockQueue class passes blocks of data from a producer thread to a consumer thread.
+ *
+ * The queue is bounded: A producer pushing to a full queue is blocked until the
+ * consumer pops a block, so a fast producer never runs far ahead of a slow consumer,
+ * and memory usage stays limited to \c capacity blocks.
+ *
+ * The producer closes the queue after pushing the last block. The consumer may close
+ * the queue as well to make the producer stop early.
+ *
+ * \sa Text
+ */
+
+/**
+ * \brief Constructs an empty queue.
+ * \param[in] capacity Maximum number of blocks the queue holds, at least 1.
+ */
+BlockQueue::BlockQueue(int capacity)
+{
+    _capacity  = capacity > 0? capacity : 1;
+    _is_closed = false;
+}
+
+/**
+ * \brief Appends a block to the queue, waiting while the queue is full.
+ * \param[in] block Block to append.
+ * \returns \c true on success and \c false if the queue is closed.
+ */
+bool BlockQueue::push(const QByteArray &block)
+{
+    QMutexLocker locker(&_mutex);
+    while (!_is_closed && _blocks.size() >= _capacity)
+        _not_full.wait(&_mutex);
+
+    if (_is_closed)
+        return false;
+
+    _blocks.enqueue(block);
+    _not_empty.wakeOne();
+    return true;
+}
+
+/**
+ * \brief Takes the first block from the queue, waiting while the queue is empty.
+ * \param[out] block Taken block.
+ * \returns \c true on success and \c false if the queue is closed and has no blocks left.
+ */
+bool BlockQueue::pop(QByteArray *block)
+{
+    QMutexLocker locker(&_mutex);
+    while (!_is_closed && _blocks.isEmpty())
+        _not_empty.wait(&_mutex);
+
+    if (_blocks.isEmpty())
+        return false;
+
+    *block = _blocks.dequeue();
+    _not_full.wakeOne();
+    return true;
+}
+
+//! Closes the queue: Further pushes fail, and pops fail as soon as remaining blocks are taken.
+void BlockQueue::close()
+{
+    QMutexLocker locker(&_mutex);
+    _is_closed = true;
+    _not_empty.wakeAll();
+    _not_full.wakeAll();
+}
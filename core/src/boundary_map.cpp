@@ -0,0 +1,71 @@
+#include <qubiq/boundary_map.h>
+
+/**
+ * \class BoundaryMap
+ *
+ * \brief The BoundaryMap class tells whether a sequence of tokens contains boundaries without index lookups.
+ *
+ * For every position the map keeps the number of consecutive non-boundary tokens
+ * ending at the position, which is 0 for boundaries. A sequence of \c n tokens is free
+ * of boundaries if and only if the run ending at its last token is at least \c n tokens
+ * long. Unlike distances to the next boundary, runs are final as soon as a position is
+ * appended, so the map is filled while the text is being indexed.
+ *
+ * Runs are kept in shared pages, so copies of the map are cheap.
+ *
+ * \sa Text
+ * \sa Extractor
+ */
+
+//! Constructs an empty map.
+BoundaryMap::BoundaryMap()
+{
+}
+
+/**
+ * \brief Appends the next position to the map.
+ * \param[in] is_boundary Whether the token at the position is a boundary.
+ */
+void BoundaryMap::append(bool is_boundary)
+{
+    const TextPosition pos = _runs.size();
+
+    int run = 0;
+    if (!is_boundary) {
+        run = pos > 0? _runs.at(pos - 1) + 1 : 1;
+        if (run > BOUNDARY_MAP_MAX_RUN)
+            run = BOUNDARY_MAP_MAX_RUN;
+    }
+    _runs.append((quint8)run);
+}
+
+//! Removes all positions from the map.
+void BoundaryMap::clear()
+{
+    _runs.clear();
+}
+
+/**
+ * \brief Replaces contents of the map with boundaries of an index.
+ * \param[in] index Index covering all positions of a text.
+ */
+void BoundaryMap::build(const LexemeIndex &index)
+{
+    clear();
+
+    const TextPosition length = index.numUniquePositions();
+    for (TextPosition pos = 0; pos < length; pos++) {
+        const Lexeme *lexeme = index.findByPosition(pos);
+        append(lexeme == NULL || lexeme->isBoundary());
+    }
+}
+
+//! \internal Checks bits of a sequence one by one, used for sequences longer than saturated runs.
+bool BoundaryMap::scan(TextPosition offset, int n) const
+{
+    for (int i = 0; i < n; i++) {
+        if (_runs.at(offset + i) == 0)
+            return true;
+    }
+    return false;
+}
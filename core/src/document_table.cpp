@@ -0,0 +1,142 @@
+#include <limits>
+#include <qubiq/document_table.h>
+
+/**
+ * \class DocumentTable
+ *
+ * \brief The DocumentTable class maps token positions of a text to documents the text is made of.
+ *
+ * A text is indexed in a single position space, so each document is described
+ * by the position of its first token only: A document ends where the next one
+ * starts or where the text ends. Documents without tokens are kept in the table
+ * and share their offset with the next document. Offsets are kept in shared pages,
+ * so copies of the table are cheap.
+ *
+ * \sa Text
+ */
+
+//! Constructs an empty table.
+DocumentTable::DocumentTable()
+{
+}
+
+/**
+ * \brief Starts a new document.
+ * \param[in] offset Position of the first token of the document, not less than the offset of the previous one.
+ */
+void DocumentTable::append(TextPosition offset)
+{
+    _offsets.append(offset);
+}
+
+//! Removes all documents from the table.
+void DocumentTable::clear()
+{
+    _offsets.clear();
+}
+
+/**
+ * \brief Finds the document a token belongs to.
+ * \param[in] pos Position of the token.
+ * \returns Index of the document or -1 if the position precedes all documents.
+ */
+qint64 DocumentTable::find(TextPosition pos) const
+{
+    qint64 lo = 0;
+    qint64 hi = _offsets.size();
+    while (lo < hi) {
+        const qint64 mid = (lo + hi) / 2;
+        if (_offsets.at(mid) <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+/**
+ * \brief Checks whether a sequence of tokens crosses a document boundary.
+ * \param[in] offset Position of the first token of the sequence.
+ * \param[in] n      Length of the sequence expressed in tokens.
+ * \returns \c true if the first and the last tokens belong to different documents.
+ */
+bool DocumentTable::spans(TextPosition offset, int n) const
+{
+    return n > 1 && find(offset) != find(offset + n - 1);
+}
+
+/**
+ * \brief Counts documents containing at least one of the given positions.
+ *
+ * Positions are expected in ascending order, which is the order an index built
+ * by \c Text stores them in. Once a document is found, the remaining positions in
+ * it are skipped by a binary search, so documents are looked up only once each.
+ *
+ * \param[in] positions Positions of a lexeme.
+ *
+ * \returns Document frequency of the lexeme, 0 if \c positions is \c NULL.
+ */
+qint64 DocumentTable::frequency(const QVector<TextPosition> *positions) const
+{
+    return frequency(PostingsIterator(positions));
+}
+
+/**
+ * This is an overloaded function.
+ *
+ * Counts documents containing positions of a lexeme which may be compressed.
+ * Compressed blocks falling into a single document are skipped without decoding.
+ *
+ * \sa LexemeIndex::postings
+ */
+qint64 DocumentTable::frequency(PostingsIterator positions) const
+{
+    qint64 num_documents = 0;
+    while (positions.hasNext()) {
+        const qint64 doc = find(positions.next());
+        if (doc < 0)
+            continue;
+        num_documents++;
+        if (doc + 1 == _offsets.size())
+            break;
+        positions.skipTo(_offsets.at(doc + 1));
+    }
+    return num_documents;
+}
+
+/**
+ * \brief Splits the documents into shards of approximately equal length.
+ *
+ * Shards never split a document, so they can be processed by different threads
+ * without any n-gram crossing shards. Very long documents may make some shards
+ * longer than others or leave less than \c num_shards shards.
+ *
+ * \param[in] num_shards Maximum number of shards.
+ * \param[in] length     Length of the text expressed in tokens.
+ *
+ * \returns Shards in the order of documents.
+ */
+QVector<DocumentTable::Shard> DocumentTable::split(int num_shards, TextPosition length) const
+{
+    QVector<Shard> shards;
+    if (_offsets.isEmpty() || num_shards < 1)
+        return shards;
+
+    Shard shard = { 0, 0, _offsets.at(0), 0 };
+    for (qint64 doc = 0; doc < _offsets.size(); doc++) {
+        const TextPosition end = doc + 1 < _offsets.size()? _offsets.at(doc + 1) : length;
+        shard.num_documents++;
+        shard.length = end - shard.offset;
+
+        // Close the shard as soon as it reaches its share of the text:
+        const qint64 share = (qint64)length * (shards.size() + 1) / num_shards;
+        if (end >= share && end < length && shards.size() < num_shards - 1) {
+            shards.append(shard);
+            Shard next = { doc + 1, 0, end, 0 };
+            shard = next;
+        }
+    }
+    shards.append(shard);
+
+    return shards;
+}
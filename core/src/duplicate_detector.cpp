@@ -0,0 +1,210 @@
+#include <qubiq/duplicate_detector.h>
+
+//! \internal Finalizer of SplitMix64, scrambles all bits of a 64-bit value.
+static inline quint64 mix64(quint64 x)
+{
+    x ^= x >> 30;
+    x *= Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x ^= x >> 27;
+    x *= Q_UINT64_C(0x94D049BB133111EB);
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * \class DuplicateDetector
+ *
+ * \brief The DuplicateDetector class finds near-duplicate documents by MinHash signatures of their shingles.
+ *
+ * A document is represented by the set of its shingles, i.e. runs of \c shingleSize
+ * consecutive token keys. Its MinHash signature estimates Jaccard similarity of
+ * such sets. Signatures are split into bands, and documents sharing at least one
+ * band are compared, so checking a document takes time independent of the number
+ * of documents seen.
+ *
+ * Documents are checked in the order of arrival: The first one of near-duplicates
+ * is kept, while the next ones are reported as duplicates and are not remembered.
+ * Hashes are deterministic, so results do not depend on the run.
+ *
+ * \sa Text::setDuplicateDetector
+ */
+
+/**
+ * \brief Constructs a detector.
+ * \param[in] threshold    Minimum estimated Jaccard similarity of near-duplicate documents.
+ * \param[in] shingle_size Number of tokens in a shingle.
+ * \param[in] num_bands    Number of LSH bands.
+ * \param[in] num_rows     Number of MinHash values per band. Longer bands make
+ *                         candidate pairs less likely for dissimilar documents.
+ */
+DuplicateDetector::DuplicateDetector(double threshold    /*= DEFAULT_DUPLICATE_THRESHOLD*/,
+                                     int    shingle_size /*= DEFAULT_SHINGLE_SIZE*/,
+                                     int    num_bands    /*= DEFAULT_MINHASH_BANDS*/,
+                                     int    num_rows     /*= DEFAULT_MINHASH_ROWS*/)
+{
+    _threshold    = threshold;
+    _shingle_size = shingle_size > 0? shingle_size : DEFAULT_SHINGLE_SIZE;
+    _num_bands    = num_bands    > 0? num_bands    : DEFAULT_MINHASH_BANDS;
+    _num_rows     = num_rows     > 0? num_rows     : DEFAULT_MINHASH_ROWS;
+
+    quint64 seed = Q_UINT64_C(0x9E3779B97F4A7C15);
+    _seeds.resize(_num_bands * _num_rows);
+    for (int i = 0; i < _seeds.size(); i++) {
+        seed     += Q_UINT64_C(0x9E3779B97F4A7C15);
+        _seeds[i] = mix64(seed);
+    }
+
+    clear();
+}
+
+/**
+ * \brief Checks whether a document is a near-duplicate of one of the documents checked before.
+ *
+ * Documents which are not duplicates are remembered for further checks.
+ *
+ * \param[in] keys Keys of non-whitespace tokens.
+ * \param[in] from Offset of the first key of the document.
+ * \param[in] to   Offset past the last key of the document, negative value stands for the end of \c keys.
+ *
+ * \returns \c true if the document is a near-duplicate and \c false otherwise. Empty
+ * documents are never duplicates.
+ */
+bool DuplicateDetector::isDuplicate(const QVector<QString> &keys, int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    QVector<quint32> hashes(to - from);
+    for (int i = from; i < to; i++) {
+        hashes[i - from] = key_hash(keys.at(i).unicode(), keys.at(i).size());
+    }
+    return check(hashes);
+}
+
+/**
+ * This is an overloaded function.
+ *
+ * Checks a document given as UTF-8 encoded keys. Keys are hashed the same way as
+ * decoded ones, so results do not depend on the way input is tokenized.
+ */
+bool DuplicateDetector::isDuplicate(const QVector<QByteArray> &keys, int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    QVector<quint32> hashes(to - from);
+    for (int i = from; i < to; i++) {
+        hashes[i - from] = key_hash(keys.at(i));
+    }
+    return check(hashes);
+}
+
+//! Forgets all documents checked so far.
+void DuplicateDetector::clear()
+{
+    _num_documents  = 0;
+    _num_duplicates = 0;
+    _buckets.clear();
+    _buckets.resize(_num_bands);
+    _signatures.clear();
+}
+
+//! \internal Checks a document given as hashes of its keys.
+bool DuplicateDetector::check(const QVector<quint32> &hashes)
+{
+    _num_documents++;
+    if (hashes.isEmpty())
+        return false;
+
+    const QVector<quint32> document = signature(hashes);
+
+    QVector<quint64> bands(_num_bands);
+    QSet<int>        compared;
+    for (int b = 0; b < _num_bands; b++) {
+        quint64 band = b;
+        for (int r = 0; r < _num_rows; r++) {
+            band = mix64(band ^ document.at(b * _num_rows + r));
+        }
+        bands[b] = band;
+
+        QHash<quint64, QVector<int> >::const_iterator it = _buckets.at(b).constFind(band);
+        if (it == _buckets.at(b).constEnd())
+            continue;
+        for (int i = 0; i < it.value().size(); i++) {
+            const int candidate = it.value().at(i);
+            if (compared.contains(candidate))
+                continue;
+            compared.insert(candidate);
+            if (similarity(document, _signatures.at(candidate)) >= _threshold) {
+                _num_duplicates++;
+                return true;
+            }
+        }
+    }
+
+    const int id = _signatures.size();
+    _signatures.append(document);
+    for (int b = 0; b < _num_bands; b++) {
+        _buckets[b][bands.at(b)].append(id);
+    }
+    return false;
+}
+
+//! \internal Computes the MinHash signature of a document given as hashes of its keys.
+QVector<quint32> DuplicateDetector::signature(const QVector<quint32> &hashes) const
+{
+    QVector<quint32> result(_seeds.size(), 0xFFFFFFFF);
+
+    // Documents shorter than a shingle make a single shingle:
+    const int shingle_size = qMin(_shingle_size, hashes.size());
+    const int num_shingles = hashes.size() - shingle_size + 1;
+    for (int s = 0; s < num_shingles; s++) {
+        quint64 shingle = 0;
+        for (int j = 0; j < shingle_size; j++) {
+            shingle = mix64(shingle ^ hashes.at(s + j));
+        }
+        for (int i = 0; i < _seeds.size(); i++) {
+            const quint32 value = (quint32)(mix64(shingle ^ _seeds.at(i)) >> 32);
+            if (value < result.at(i))
+                result[i] = value;
+        }
+    }
+
+    return result;
+}
+
+//! \internal Estimates Jaccard similarity of two documents as the share of equal MinHash values.
+double DuplicateDetector::similarity(const QVector<quint32> &s1, const QVector<quint32> &s2) const
+{
+    int num_equal = 0;
+    for (int i = 0; i < s1.size(); i++) {
+        if (s1.at(i) == s2.at(i))
+            num_equal++;
+    }
+    return (double)num_equal / (double)s1.size();
+}
+
+//! \internal Computes FNV-1a hash of a key over its UTF-16 code units.
+/*static*/ quint32 DuplicateDetector::key_hash(const QChar *chars, int len)
+{
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ chars[i].unicode()) * 16777619u;
+    }
+    return hash;
+}
+
+//! \internal Computes the hash of a UTF-8 encoded key equal to the hash of the decoded key.
+/*static*/ quint32 DuplicateDetector::key_hash(const QByteArray &key)
+{
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < key.size(); i++) {
+        const uchar c = (uchar)key.at(i);
+        if (c >= 0x80) {
+            const QString decoded = QString::fromUtf8(key);
+            return key_hash(decoded.unicode(), decoded.size());
+        }
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
@@ -6,18 +6,29 @@
  */
 Extractor::Extractor(const LexemeIndex *index)
 {
-    // NB! To make this class depend only LexemeIndex we assume that
-    // the index is *not* sparse, i.e. covers all token positions in the original text.
-    _index   = index;
-    _txt_len = index->numUniquePositions();
-    _filter  = NULL;
-    _min_bf  = DEFAULT_MIN_BIGRAM_FREQUENCY;
-    _min_bs  = DEFAULT_MIN_BIGRAM_SCORE;
-    _max_ser = DEFAULT_MAX_SOURCE_EXTRACTION_RATE;
-    _max_led = DEFAULT_MAX_LEFT_EXPANSION_DISTANCE;
-    _max_red = DEFAULT_MAX_RIGHT_EXPANSION_DISTANCE;
-    _qdt     = DEFAULT_QUALITY_DECREASE_THRESHOLD;
+    _set_defaults(index);
+    _initialize();
+}
 
+/**
+ * \brief Constructs an Extractor object pinning a text snapshot.
+ *
+ * The extractor keeps a reference to the snapshot, so the snapshot and all lexemes
+ * of the extracted terms stay valid for the lifetime of the extractor, no matter
+ * how the text is appended to in the meantime. The index of lexemes is used if it
+ * covers the whole snapshot, otherwise the index of wordforms is used. Sequences
+ * crossing document boundaries of the snapshot are never extracted.
+ *
+ * \param[in] snapshot Snapshot published by \c Text::publish.
+ */
+Extractor::Extractor(const QSharedPointer<const TextSnapshot> &snapshot)
+{
+    _snapshot = snapshot;
+    _set_defaults(snapshot->lexemes()->numUniquePositions() == snapshot->length()
+        ? snapshot->lexemes() : snapshot->wordforms()
+    );
+    _documents  = &snapshot->documents();
+    _boundaries = &snapshot->boundaries();
     _initialize();
 }
 
@@ -70,6 +81,12 @@ bool Extractor::extract(bool sort_terms /* = false */)
     _destroy();
     _initialize();
 
+    if (_boundaries == NULL) {
+        // Built once, so sequences are validated without index lookups:
+        _own_boundaries.build(*_index);
+        _boundaries = &_own_boundaries;
+    }
+
     if (!collect_good_bigrams()) {
         LOG_WARNING("No good bigrams collected, consider adjusting minBigramFrequency");
         return false;
@@ -131,7 +148,9 @@ bool Extractor::extract(bool sort_terms /* = false */)
 bool Extractor::collect_good_bigrams()
 {
     LOG_INFO("Starting collecting good bigrams");
-    for (int i = 0; i < _txt_len; i++) {
+    for (TextPosition i = 0; i < _txt_len; i++) {
+        if (_boundaries->hasBoundaries(i, 2) || spans_documents(i, 2))
+            continue;
         LexemeSequence bigram(_index, i, 2, 1);
         if (!bigram.isValid())
             continue;
@@ -163,6 +182,12 @@ bool Extractor::is_good_bigram(const LexemeSequence &bigram) const
     return bigram.frequency() >= _min_bf && bigram.score() >= _min_bs;
 }
 
+//! \internal Returns \c true if a sequence crosses a boundary between documents.
+bool Extractor::spans_documents(TextPosition offset, int n) const
+{
+    return _documents != NULL && _documents->spans(offset, n);
+}
+
 /**
  * \brief Evaluates whether a sequence (of any length) should be treated as a term.
  *
@@ -192,14 +217,16 @@ bool Extractor::treat_as_term(const LexemeSequence &candidate, int num_expansion
 int Extractor::expand(const LexemeSequence &candidate, bool is_left_expanded)
 {
     int num_expanded = 0;
-    const QVector<int> *positions = candidate.positions();
+    const QVector<TextPosition> *positions = candidate.positions();
     int n  = candidate.length() + 1;
     int n1 = is_left_expanded? 1 : candidate.length();
 
     for (int i = 0; i < positions->size(); i++) {
-        int offset = positions->at(i);
+        TextPosition offset = positions->at(i);
         if (is_left_expanded)
             offset--;
+        if (_boundaries->hasBoundaries(offset, n) || spans_documents(offset, n))
+            continue;
 
         LexemeSequence expanded(_index, offset, n, n1); // FIXME: Choose the right index
         if (!validate_expanded(expanded, candidate))
@@ -275,6 +302,24 @@ void Extractor::_initialize()
     _extracted  = new QSet<QByteArray>;
 }
 
+//! \internal Sets the index and default extraction parameters.
+void Extractor::_set_defaults(const LexemeIndex *index)
+{
+    // NB! To make this class depend only LexemeIndex we assume that
+    // the index is *not* sparse, i.e. covers all token positions in the original text.
+    _index      = index;
+    _txt_len    = index->numUniquePositions();
+    _filter     = NULL;
+    _documents  = NULL;
+    _boundaries = NULL;
+    _min_bf  = DEFAULT_MIN_BIGRAM_FREQUENCY;
+    _min_bs  = DEFAULT_MIN_BIGRAM_SCORE;
+    _max_ser = DEFAULT_MAX_SOURCE_EXTRACTION_RATE;
+    _max_led = DEFAULT_MAX_LEFT_EXPANSION_DISTANCE;
+    _max_red = DEFAULT_MAX_RIGHT_EXPANSION_DISTANCE;
+    _qdt     = DEFAULT_QUALITY_DECREASE_THRESHOLD;
+}
+
 //! \internal Frees memory occupied by class members.
 void Extractor::_destroy()
 {
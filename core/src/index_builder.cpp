@@ -0,0 +1,310 @@
+#include <limits>
+#include <qubiq/index_builder.h>
+
+/**
+ * \class IndexBuilder
+ *
+ * \brief The IndexBuilder class indexes input larger than memory into a snapshot file.
+ *
+ * Input is appended to a \c Text as usual. Whenever the memory usage of the text
+ * exceeds the memory budget, its indeces are flushed to disk as a segment, which
+ * is a snapshot of the text, and the text is cleared. Finally, segments are
+ * merged into a single snapshot, which \c Text::load reads into indeces usable by
+ * \c Extractor exactly like indeces built in memory.
+ *
+ * Segments cover consecutive ranges of positions, so merging streams of lexeme IDs
+ * is a concatenation of segments with IDs remapped to the merged vocabulary. Only
+ * the merged vocabulary and the segment being streamed are kept in memory, segments
+ * themselves are memory-mapped.
+ *
+ * The builder is the segment writer of the text, so the text checks the budget
+ * between buffers of a single input and flushes segments there as well. A document
+ * being appended at that moment continues at the first position of the next segment.
+ *
+ * \sa Text::save
+ * \sa Text::memoryUsage
+ * \sa Text::setSegmentWriter
+ */
+
+/**
+ * \brief Constructs a builder.
+ * \param[in] text          Text to append input to, should be empty. The text is not owned by the builder.
+ *                          Settings of the text, like the lemmatizer, apply to all segments.
+ * \param[in] segment_path  Directory to store segments in.
+ * \param[in] memory_budget Memory usage of the text to flush a segment at, in bytes.
+ */
+IndexBuilder::IndexBuilder(Text *text, const QString &segment_path, qint64 memory_budget /*= DEFAULT_MEMORY_BUDGET*/)
+{
+    _text          = text;
+    _segment_path  = segment_path;
+    _memory_budget = memory_budget > 0? memory_budget : DEFAULT_MEMORY_BUDGET;
+    _text->setSegmentWriter(this);
+}
+
+//! Destructs the builder removing segments which are not merged yet.
+IndexBuilder::~IndexBuilder()
+{
+    if (_text->segmentWriter() == this)
+        _text->setSegmentWriter(NULL);
+    remove_segments();
+}
+
+/**
+ * \brief Appends contents of a string buffer.
+ * \returns \c false if the buffer is empty or a segment can not be written.
+ * \sa Text::append
+ */
+bool IndexBuilder::append(const QString &buffer)
+{
+    bool is_ok = _text->append(buffer);
+    return flush_if_needed() && is_ok;
+}
+
+/**
+ * \brief Appends contents of a file.
+ * \returns \c false if the file is not accessible or a segment can not be written.
+ * \sa Text::appendFile
+ */
+bool IndexBuilder::appendFile(const QString &fname)
+{
+    bool is_ok = _text->appendFile(fname);
+    return flush_if_needed() && is_ok;
+}
+
+/**
+ * \brief Appends contents of several files one by one, flushing segments in between when needed.
+ * \returns \c false if at least one of the files is not accessible or a segment can not be written.
+ * \sa Text::appendFile
+ */
+bool IndexBuilder::appendFiles(const QStringList &fnames)
+{
+    bool is_ok = true;
+    for (int i = 0; i < fnames.size(); i++) {
+        if (!appendFile(fnames.at(i)))
+            is_ok = false;
+    }
+    return is_ok;
+}
+
+/**
+ * \brief Flushes the text to a new segment and clears it.
+ * \returns \c true on success and \c false if the segment can not be written.
+ */
+bool IndexBuilder::flush()
+{
+    QTemporaryFile segment(QDir(_segment_path).filePath("segment-XXXXXX.qutx"));
+    segment.setAutoRemove(false);
+    if (!segment.open()) {
+        LOG_WARNING() << "Unable to create segment in" << _segment_path;
+        return false;
+    }
+    segment.close();
+
+    if (!_text->save(segment.fileName())) {
+        QFile::remove(segment.fileName());
+        return false;
+    }
+
+    LOG_INFO() << "Segment" << _segments.size() << "flushed:" << _text->length() << "tokens";
+
+    _segments.append(segment.fileName());
+    _text->clear();
+    return true;
+}
+
+/**
+ * \brief Flushes the last segment and merges all segments into a snapshot.
+ *
+ * Segments are removed afterwards, and the text is left empty.
+ *
+ * \param[in] fname File name of the snapshot to write.
+ *
+ * \returns \c true on success and \c false if segments can not be written or read,
+ * the snapshot is not writable, or the merged text is longer than 2^31 - 1 tokens.
+ *
+ * \sa Text::load
+ */
+bool IndexBuilder::finish(const QString &fname)
+{
+    // The text may hold the end of a document started in the previous segment
+    if ((_text->length() > 0 || _text->documents().size() > 0 || _segments.isEmpty()) && !flush())
+        return false;
+
+    QVector<Segment> segments(_segments.size());
+    qint64 length        = 0;
+    qint64 num_documents = 0;
+    bool   is_ok         = true;
+    for (int i = 0; i < _segments.size(); i++) {
+        if (!open_segment(_segments.at(i), &segments[i])) {
+            LOG_WARNING() << "Bad segment file" << _segments.at(i);
+            is_ok = false;
+            break;
+        }
+        length        += segments.at(i).layout.length();
+        num_documents += segments.at(i).layout.numDocuments();
+    }
+    if (is_ok && length > std::numeric_limits<qint32>::max()) {
+        LOG_WARNING("Text is too long for the snapshot format");
+        is_ok = false;
+    }
+
+    QFile out_file(fname);
+    if (is_ok && !out_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOG_WARNING("Unable to open snapshot file for writing");
+        is_ok = false;
+    }
+
+    if (is_ok) {
+        QDataStream out_stream(&out_file);
+        out_stream.setByteOrder(QDataStream::LittleEndian);
+        out_stream
+            << TEXT_SNAPSHOT_FORMAT_MARKER
+            << TEXT_SNAPSHOT_FORMAT_VERSION
+            << (qint32)length
+            << (qint32)num_documents
+        ;
+        qint32 base = 0;
+        for (int i = 0; i < segments.size(); i++) {
+            const Segment &segment = segments.at(i);
+            for (qint32 doc = 0; doc < segment.layout.numDocuments(); doc++) {
+                out_stream << base + segment.layout.documentOffset(doc);
+            }
+            base += segment.layout.length();
+        }
+
+        is_ok = merge_index(segments, 0, &out_stream) && merge_index(segments, 1, &out_stream);
+        out_file.close();
+
+        if (is_ok && out_stream.status() != QDataStream::Ok) {
+            LOG_WARNING("Unable to write snapshot file");
+            is_ok = false;
+        }
+    }
+
+    for (int i = 0; i < segments.size(); i++) {
+        close_segment(&segments[i]);
+    }
+
+    if (is_ok) {
+        LOG_INFO() << _segments.size() << "segments merged:" << length << "tokens";
+        remove_segments();
+    }
+
+    return is_ok;
+}
+
+//! \internal Flushes a segment if the text exceeds the memory budget.
+bool IndexBuilder::flush_if_needed()
+{
+    if (_text->memoryUsage() < _memory_budget)
+        return true;
+    return flush();
+}
+
+//! \internal Removes segment files.
+void IndexBuilder::remove_segments()
+{
+    for (int i = 0; i < _segments.size(); i++) {
+        QFile::remove(_segments.at(i));
+    }
+    _segments.clear();
+}
+
+/**
+ * \internal Maps a segment and locates its sections.
+ * \returns \c true on success and \c false if the segment is not accessible, malformed or of an older version.
+ */
+/*static*/ bool IndexBuilder::open_segment(const QString &fname, Segment *segment)
+{
+    segment->file = new QFile(fname);
+    segment->data = NULL;
+    if (!segment->file->open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = segment->file->size();
+    segment->data = size > 0? segment->file->map(0, size) : NULL;
+    return segment->layout.parse(segment->data, size)
+        && segment->layout.version() == TEXT_SNAPSHOT_FORMAT_VERSION;
+}
+
+//! \internal Unmaps a segment.
+/*static*/ void IndexBuilder::close_segment(Segment *segment)
+{
+    if (segment->data != NULL)
+        segment->file->unmap(const_cast<uchar*>(segment->data));
+    delete segment->file;
+    segment->file = NULL;
+    segment->data = NULL;
+}
+
+/**
+ * \internal Merges one of the indeces of all segments and writes it to a snapshot.
+ *
+ * Lexemes get IDs in order of segments, so IDs keep following the order of the
+ * first occurrence. Features of lexemes are united over segments.
+ *
+ * \param[in]  segments Opened segments.
+ * \param[in]  which    0 for the index of wordforms and 1 for the index of lexemes.
+ * \param[out] out      Stream to write to, set to little-endian byte order.
+ *
+ * \returns \c true on success and \c false if a segment is malformed.
+ */
+/*static*/ bool IndexBuilder::merge_index(const QVector<Segment> &segments, int which, QDataStream *out)
+{
+    QHash<QByteArray, qint32> ids;
+    QByteArray                names;
+    QVector<qint32>           name_offsets;
+    QByteArray                flags;
+    for (int i = 0; i < segments.size(); i++) {
+        const SnapshotLayout        &layout = segments.at(i).layout;
+        const SnapshotLayout::Index &index  = layout.index(which);
+        QByteArray name;
+        for (qint32 id = 0; id < index.num_lexemes; id++) {
+            if (!layout.name(index, id, &name))
+                return false;
+
+            const char features = (char)layout.features(index, id);
+            QHash<QByteArray, qint32>::const_iterator it = ids.constFind(name);
+            if (it == ids.constEnd()) {
+                ids.insert(name, name_offsets.size());
+                name_offsets.append(names.size());
+                names.append(name);
+                flags.append(features);
+            } else {
+                flags[it.value()] = flags.at(it.value()) | features;
+            }
+        }
+    }
+    name_offsets.append(names.size());
+
+    const char padding[4] = { 0, 0, 0, 0 };
+    *out << (qint32)flags.size() << (qint32)names.size();
+    out->writeRawData(flags.constData(), flags.size());
+    out->writeRawData(padding, (4 - flags.size() % 4) % 4);
+    for (int i = 0; i < name_offsets.size(); i++)
+        *out << name_offsets.at(i);
+    out->writeRawData(names.constData(), names.size());
+    out->writeRawData(padding, (4 - names.size() % 4) % 4);
+
+    for (int i = 0; i < segments.size(); i++) {
+        const SnapshotLayout        &layout = segments.at(i).layout;
+        const SnapshotLayout::Index &index  = layout.index(which);
+
+        // Names are checked by the first pass
+        QVector<qint32> remap(index.num_lexemes);
+        QByteArray      name;
+        for (qint32 id = 0; id < index.num_lexemes; id++) {
+            layout.name(index, id, &name);
+            remap[id] = ids.value(name);
+        }
+
+        for (qint32 pos = 0; pos < layout.length(); pos++) {
+            const qint32 id = layout.id(index, pos);
+            if (id < -1 || id >= index.num_lexemes)
+                return false;
+            *out << (id >= 0? remap.at(id) : (qint32)-1);
+        }
+    }
+
+    return true;
+}
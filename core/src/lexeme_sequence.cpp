@@ -41,7 +41,7 @@ LexemeSequence::LexemeSequence(const LexemeSequence &other)
  * \param[in] n      Length of the sequence.
  * \param[in] n1     Length of the first subsequence.
  */
-LexemeSequence::LexemeSequence(const LexemeIndex *index, int offset, int n, int n1)
+LexemeSequence::LexemeSequence(const LexemeIndex *index, TextPosition offset, int n, int n1)
 {
     _initialize();
 
@@ -85,7 +85,7 @@ QString LexemeSequence::image() const
     if (_state != LexemeSequence::STATE_OK)
         return _image;
 
-    int first_pos      = _index->positions(_seq->at(0)->name())->at(0);
+    TextPosition first_pos = _index->postingsById(_seq->at(0)->id()).next();
     for (int i = 0; i < _seq->length(); i++) {
         _image.append(_index->findByPosition(first_pos + i)->name()).append(" ");
     }
@@ -101,7 +101,7 @@ QString LexemeSequence::image() const
  * \param[in] n1     Length of the first subsequence.
  * \returns          Sequence state.
  */
-LexemeSequence::LexemeSequenceState LexemeSequence::calculate_state(const LexemeIndex *index, int offset, int n, int n1)
+LexemeSequence::LexemeSequenceState LexemeSequence::calculate_state(const LexemeIndex *index, TextPosition offset, int n, int n1)
 {
     if (index == NULL)
         return LexemeSequence::STATE_BAD_INDEX;
@@ -132,7 +132,7 @@ LexemeSequence::LexemeSequenceState LexemeSequence::calculate_state(const Lexeme
  * \param[in] n      Length of the sequence.
  * \returns          Sequence state indicating sequence validity.
  */
-LexemeSequence::LexemeSequenceState LexemeSequence::build_sequence(int offset, int n)
+LexemeSequence::LexemeSequenceState LexemeSequence::build_sequence(TextPosition offset, int n)
 {
     for (int i = 0; i < n; i++) {
         Lexeme *lexeme = _index->findByPosition(offset + i);
@@ -203,14 +203,14 @@ void LexemeSequence::add_to_key(Lexeme *lexeme)
  * \param[in] n1      Length of the first subsequence.
  * \returns           Currently always returns \c LexemeSequence::LexemeSequenceState::STATE_OK.
  */
-LexemeSequence::LexemeSequenceState LexemeSequence::calculate_metrics(int offset, int n, int n1)
+LexemeSequence::LexemeSequenceState LexemeSequence::calculate_metrics(TextPosition offset, int n, int n1)
 {
-    int f         = calculate_frequency(offset, n, true);     /* frequency of the whole sequence     */
-    int f1        = calculate_frequency(offset, n1);          /* frequency of the first subsequence  */
-    int f2        = calculate_frequency(offset + n1, n - n1); /* frequency of the second subsequence */
-    int N         = _txt_len;
-    int not_f1    = N - f1; /* number of offsets that do not start the first subsequence */
-    int f2_not_f1 = f2 - f; /* frequency of the second subsequence adjacent to anything but the first subsequence */
+    int          f         = calculate_frequency(offset, n, true);     /* frequency of the whole sequence     */
+    int          f1        = calculate_frequency(offset, n1);          /* frequency of the first subsequence  */
+    int          f2        = calculate_frequency(offset + n1, n - n1); /* frequency of the second subsequence */
+    TextPosition N         = _txt_len;
+    TextPosition not_f1    = N - f1; /* number of offsets that do not start the first subsequence */
+    int          f2_not_f1 = f2 - f; /* frequency of the second subsequence adjacent to anything but the first subsequence */
 
     if (f1 == N) /* Special case (very rare): artificial texts like "x x x x" */
         not_f1 = 1;
@@ -240,22 +240,52 @@ LexemeSequence::LexemeSequenceState LexemeSequence::calculate_metrics(int offset
 
 /**
  * \brief Calculates frequency of a sequence in the source text.
+ *
+ * Occurrences are looked for around positions of the rarest lexeme of the
+ * sequence. If all lexemes of the sequence are frequent enough to be stored as
+ * bitmaps, their bitmaps are intersected instead, each one shifted by the offset
+ * of its lexeme in the sequence.
+ *
  * \param[in] offset      Offset (expressed in tokens) to start building the sequence at.
  * \param[in] n           Length of the sequence.
  * \param[in] collect_pos If \c true internal storage of sequence position in the text will be updated.
  * \returns Number of occurences of the sequence in the \c text.
  */
-int LexemeSequence::calculate_frequency(int offset, int n, bool collect_pos /* = false*/)
+int LexemeSequence::calculate_frequency(TextPosition offset, int n, bool collect_pos /* = false*/)
 {
-    Lexeme       *lexeme    = _index->findByPosition(offset);
-    QVector<int> *first_pos = _index->positions(lexeme->name());
-    int f = first_pos->size();
-    for (int i = 0; i < first_pos->length(); i++) {
-        int pos = first_pos->at(i);
-        if (!is_sequence(pos, offset, n)) {
-            f--;
-            continue;
+    int  driver      = 0;
+    int  driver_size = 0;
+    bool is_bitmap   = n > 1;
+    for (int i = 0; i < n; i++) {
+        const quint32 id   = _index->idByPosition(offset + i);
+        const int     size = _index->postingsById(id).size();
+        if (i == 0 || size < driver_size) {
+            driver      = i;
+            driver_size = size;
+        }
+        is_bitmap = is_bitmap && _index->bitmapById(id) != NULL;
+    }
+
+    if (is_bitmap) {
+        PositionBitmap matches = _index->bitmapById(_index->idByPosition(offset))->intersected(
+            *_index->bitmapById(_index->idByPosition(offset + 1)), 1
+        );
+        for (int i = 2; i < n && matches.size() > 0; i++) {
+            matches = matches.intersected(*_index->bitmapById(_index->idByPosition(offset + i)), i);
+        }
+        if (collect_pos) {
+            *_pos += matches.toVector();
         }
+        return matches.size();
+    }
+
+    int f = 0;
+    PostingsIterator driver_pos = _index->postingsById(_index->idByPosition(offset + driver));
+    while (driver_pos.hasNext()) {
+        const TextPosition pos = driver_pos.next() - driver;
+        if (pos < 0 || !is_sequence(pos, offset, n))
+            continue;
+        f++;
         if (collect_pos) {
             _pos->append(pos);
         }
@@ -275,7 +305,7 @@ int LexemeSequence::calculate_frequency(int offset, int n, bool collect_pos /* =
  * \param[in] n               Length of the sequence.
  * \returns \c true if two sequences map to the same sequence of lexemes and \c false otherwise.
  */
-bool LexemeSequence::is_sequence(int text_offset, int sequence_offset, int n) const
+bool LexemeSequence::is_sequence(TextPosition text_offset, TextPosition sequence_offset, int n) const
 {
     /* NB! sequence_offset and n are always correlated and won't lead to out-of-range errors */
     if (text_offset + n > _txt_len)
@@ -302,7 +332,7 @@ void LexemeSequence::_initialize()
     _red      = 0;
     _txt_len  = 0;
     _seq      = new QVector<Lexeme*>();
-    _pos      = new QVector<int>();
+    _pos      = new QVector<TextPosition>();
     _key      = new QByteArray;
 }
 
@@ -320,7 +350,7 @@ void LexemeSequence::_assign(const LexemeSequence &other)
     _red      = other._red;
     _txt_len  = other._txt_len;
     _seq      = new QVector<Lexeme*>(*(other._seq));
-    _pos      = new QVector<int>(*(other._pos));
+    _pos      = new QVector<TextPosition>(*(other._pos));
     _key      = new QByteArray(*(other._key));
 }
 
@@ -0,0 +1,98 @@
+#include <qubiq/snapshot_layout.h>
+
+/**
+ * \class SnapshotLayout
+ *
+ * \brief The SnapshotLayout class locates sections of a binary snapshot of a text.
+ *
+ * The layout is parsed straight from the contents of a snapshot, usually memory-mapped,
+ * and accessors read numbers from these contents, which have to outlive the layout.
+ * Parsing checks the prologue and that all sections fit the snapshot, contents of
+ * sections, like IDs and name offsets, are checked by their readers.
+ *
+ * \sa Text::save
+ * \sa Text::load
+ * \sa IndexBuilder
+ */
+
+//! Constructs an empty layout.
+SnapshotLayout::SnapshotLayout()
+{
+    _data          = NULL;
+    _version       = 0;
+    _length        = 0;
+    _num_documents = 0;
+    memset(_indeces, 0, sizeof(_indeces));
+}
+
+/**
+ * \brief Locates sections of a snapshot.
+ *
+ * \param[in] data Contents of the snapshot.
+ * \param[in] size Size of the snapshot in bytes.
+ *
+ * \returns \c true on success and \c false if the snapshot is not of a supported
+ * version or its sections do not fit it.
+ */
+bool SnapshotLayout::parse(const uchar *data, qint64 size)
+{
+    _data = data;
+    if (data == NULL || size < DOCUMENTS_POS
+        || qFromLittleEndian<qint32>(data) != TEXT_SNAPSHOT_FORMAT_MARKER
+    ) {
+        return false;
+    }
+
+    // Version 1 stores 0 in place of the number of documents:
+    _version       = qFromLittleEndian<qint32>(data + 4);
+    _length        = qFromLittleEndian<qint32>(data + 8);
+    _num_documents = qFromLittleEndian<qint32>(data + 12);
+    if (_version < 1 || _version > TEXT_SNAPSHOT_FORMAT_VERSION || _length < 0 || _num_documents < 0)
+        return false;
+
+    const qint64 index_pos = DOCUMENTS_POS + 4 * (qint64)_num_documents;
+    return parse_index(index_pos, size, data, _length, &_indeces[0])
+        && parse_index(_indeces[0].end_pos, size, data, _length, &_indeces[1]);
+}
+
+/**
+ * \brief Returns the UTF-8 encoded name of a lexeme of an index.
+ *
+ * \param[in]  index Layout of the index.
+ * \param[in]  id    ID of the lexeme, less than \c num_lexemes of the index.
+ * \param[out] name  Name referencing the contents of the snapshot, valid as long as the contents are.
+ *
+ * \returns \c true on success and \c false if the offsets of the name are malformed.
+ */
+bool SnapshotLayout::name(const Index &index, qint32 id, QByteArray *name) const
+{
+    const qint32 name_start = qFromLittleEndian<qint32>(_data + index.offsets_pos + 4 * (qint64)id);
+    const qint32 name_end   = qFromLittleEndian<qint32>(_data + index.offsets_pos + 4 * ((qint64)id + 1));
+    if (name_start < 0 || name_end < name_start || name_end > index.names_size)
+        return false;
+
+    *name = QByteArray::fromRawData(
+        reinterpret_cast<const char*>(_data + index.names_pos + name_start),
+        name_end - name_start
+    );
+    return true;
+}
+
+//! \internal Locates parts of an index section, returns \c false if the section does not fit the snapshot.
+/*static*/ bool SnapshotLayout::parse_index(qint64 offset, qint64 size, const uchar *data, qint32 length, Index *index)
+{
+    if (offset + 8 > size)
+        return false;
+
+    index->num_lexemes = qFromLittleEndian<qint32>(data + offset);
+    index->names_size  = qFromLittleEndian<qint32>(data + offset + 4);
+    if (index->num_lexemes < 0 || index->names_size < 0)
+        return false;
+
+    index->flags_pos   = offset + 8;
+    index->offsets_pos = index->flags_pos + index->num_lexemes + (4 - index->num_lexemes % 4) % 4;
+    index->names_pos   = index->offsets_pos + 4 * ((qint64)index->num_lexemes + 1);
+    index->ids_pos     = index->names_pos + index->names_size + (4 - index->names_size % 4) % 4;
+    index->end_pos     = index->ids_pos + 4 * (qint64)length;
+    return index->end_pos <= size;
+}
@@ -0,0 +1,102 @@
+#include <qubiq/surface_form_cache.h>
+
+/**
+ * \class SurfaceFormCache
+ *
+ * \brief The SurfaceFormCache class maps raw token slices to lexemes they are indexed as.
+ *
+ * Following Zipf's law, a small number of distinct tokens makes up most of a text.
+ * The cache lets \c Text resolve such tokens without building their keys (which involves
+ * lowercasing and allocating a string) and without looking the keys up in the index.
+ *
+ * The cache is a fixed-size open addressing table keyed by surface forms exactly as they
+ * appear in the text. Hashes are computed directly over \c QStringRef slices, so lookups
+ * do not copy tokens. Surface forms are copied only when inserted. When no free slot
+ * is found within \c SURFACE_FORM_CACHE_MAX_PROBES slots, the slot the surface form
+ * hashes to is overwritten.
+ *
+ * The cache does not own the lexemes it points to, so it must be cleared whenever
+ * the index holding them is destroyed.
+ *
+ * \sa Text
+ */
+
+/**
+ * \brief Constructs an empty cache.
+ * \param[in] capacity Maximum number of surface forms to keep, rounded up to a power of two.
+ */
+SurfaceFormCache::SurfaceFormCache(int capacity /*= DEFAULT_SURFACE_FORM_CACHE_SIZE*/)
+{
+    _hits   = 0;
+    _misses = 0;
+    resize(capacity);
+}
+
+/**
+ * \brief Looks up a surface form.
+ * \param[in] surface Surface form of a token.
+ * \returns Lexeme the surface form is indexed as or \c NULL if it is not cached.
+ */
+Lexeme* SurfaceFormCache::find(const QStringRef &surface)
+{
+    const uint hash = qHash(surface);
+    for (int i = 0; i < SURFACE_FORM_CACHE_MAX_PROBES; i++) {
+        const Slot &slot = _slots.at((hash + i) & _mask);
+        if (slot.lexeme == NULL)
+            break;
+        if (slot.hash == hash && slot.surface == surface) {
+            _hits++;
+            return slot.lexeme;
+        }
+    }
+    _misses++;
+    return NULL;
+}
+
+/**
+ * \brief Caches a surface form.
+ * \param[in] surface Surface form of a token.
+ * \param[in] lexeme  Lexeme the surface form is indexed as.
+ */
+void SurfaceFormCache::insert(const QStringRef &surface, Lexeme *lexeme)
+{
+    if (lexeme == NULL)
+        return;
+
+    const uint hash = qHash(surface);
+    uint idx = hash & _mask;
+    for (int i = 0; i < SURFACE_FORM_CACHE_MAX_PROBES; i++) {
+        const uint probe = (hash + i) & _mask;
+        if (_slots.at(probe).lexeme == NULL) {
+            idx = probe;
+            break;
+        }
+    }
+
+    Slot &slot   = _slots[idx];
+    slot.hash    = hash;
+    slot.surface = surface.toString();
+    slot.lexeme  = lexeme;
+}
+
+//! Removes all surface forms from the cache and resets its statistics.
+void SurfaceFormCache::clear()
+{
+    _slots.fill(Slot());
+    _hits   = 0;
+    _misses = 0;
+}
+
+/**
+ * \brief Changes capacity of the cache. All cached surface forms are dropped.
+ * \param[in] capacity Maximum number of surface forms to keep, rounded up to a power of two.
+ */
+void SurfaceFormCache::resize(int capacity)
+{
+    int size = SURFACE_FORM_CACHE_MAX_PROBES;
+    while (size < capacity && size < (1 << 30))
+        size <<= 1;
+
+    _slots = QVector<Slot>(size);
+    _mask  = size - 1;
+}
@@ -1,5 +1,382 @@
+#include <zlib.h>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 #include <qubiq/text.h>
 
+/**
+ * \internal
+ * \brief The TokenizerJob class is a base for jobs tokenizing input in worker threads.
+ *
+ * Jobs only collect token keys and never touch the indeces of the text, which
+ * are filled by the calling thread afterwards.
+ */
+class TokenizerJob : public QRunnable {
+public:
+    TokenizerJob(const Text *text) : _text(text), _is_ok(true) { setAutoDelete(false); }
+
+    //! Blocks until the job is done.
+    inline void wait() { _done.acquire(); }
+
+    //! Returns \c true if the job's input was accessible.
+    inline bool isOk() const { return _is_ok; }
+
+    //! Returns keys of all non-whitespace tokens in the order of appearance.
+    inline const QVector<QString>& keys() const { return _keys; }
+
+    //! Returns UTF-8 encoded keys of all non-whitespace tokens if the input was tokenized as raw bytes.
+    inline const QVector<QByteArray>& utf8Keys() const { return _utf8_keys; }
+
+    //! Returns offsets of keys of capitalized tokens in the vector of keys.
+    inline const QVector<int>& capitalized() const { return _capitalized; }
+
+    //! Returns counters and timings of the job.
+    inline const TextStats& stats() const { return _stats; }
+
+protected:
+    const Text          *_text;
+    bool                 _is_ok;
+    QVector<QString>     _keys;
+    QVector<QByteArray>  _utf8_keys;
+    QVector<int>         _capitalized;
+    TextStats            _stats;
+    QSemaphore           _done;
+};
+
+/**
+ * \internal
+ * \brief The ChunkTokenizer class tokenizes a chunk of a large file in a worker thread.
+ *
+ * Chunks always end at safe split points, so keys produced by a chunk are exactly
+ * the keys a sequential run would produce for the same bytes. Chunks without a codec
+ * are tokenized as raw UTF-8 bytes.
+ *
+ * \sa Text::append_chunked
+ */
+class ChunkTokenizer : public TokenizerJob {
+public:
+    ChunkTokenizer(const Text *text, QTextCodec *codec, const char *bytes, int size)
+        : TokenizerJob(text), _codec(codec), _bytes(bytes), _size(size) {}
+
+    virtual void run()
+    {
+        if (_codec == NULL)
+            _text->tokenize_utf8_buffer(_bytes, _size, true, &_utf8_keys, &_capitalized, &_stats);
+        else
+            _text->tokenize_buffer(_codec->toUnicode(_bytes, _size), true, &_keys, &_capitalized, &_stats);
+        _done.release();
+    }
+
+private:
+    QTextCodec *_codec;
+    const char *_bytes;
+    int         _size;
+};
+
+/**
+ * \internal
+ * \brief The FileTokenizer class tokenizes a whole file in a worker thread.
+ *
+ * \sa Text::appendFiles
+ */
+class FileTokenizer : public TokenizerJob {
+public:
+    FileTokenizer(const Text *text, const QString &fname) : TokenizerJob(text), _fname(fname) {}
+
+    virtual void run()
+    {
+        _is_ok = _text->tokenize_file(_fname, &_keys, &_utf8_keys, &_capitalized, &_stats);
+        _done.release();
+    }
+
+private:
+    QString _fname;
+};
+
+/**
+ * \internal
+ * \brief The BatchTokenizer class tokenizes a batch of in-memory documents in a worker thread.
+ *
+ * Documents are tokenized in place, either as raw UTF-8 bytes or as views into
+ * caller-owned strings. Keys of all documents are collected into a single vector,
+ * and the end of each document in it is recorded.
+ *
+ * \sa Text::appendMany
+ */
+class BatchTokenizer : public TokenizerJob {
+public:
+    BatchTokenizer(const Text *text, const QByteArray *utf8_documents, const QStringRef *documents, int size)
+        : TokenizerJob(text), _utf8_documents(utf8_documents), _documents(documents), _size(size) {}
+
+    //! Returns offsets past the keys of each document in the vector of keys.
+    inline const QVector<int>& ends() const { return _ends; }
+
+    virtual void run()
+    {
+        _ends.reserve(_size);
+        for (int i = 0; i < _size; i++) {
+            if (_utf8_documents != NULL) {
+                const QByteArray &document = _utf8_documents[i];
+                const int bom_size = Text::utf8_bom_size(document.constData(), document.size());
+                _text->tokenize_utf8_buffer(document.constData() + bom_size, document.size() - bom_size,
+                                            true, &_utf8_keys, &_capitalized, &_stats);
+                _ends.append(_utf8_keys.size());
+            } else {
+                const QStringRef &document = _documents[i];
+                _text->tokenize_buffer(QString::fromRawData(document.unicode(), document.size()),
+                                       true, &_keys, &_capitalized, &_stats);
+                _ends.append(_keys.size());
+            }
+        }
+        _done.release();
+    }
+
+private:
+    const QByteArray *_utf8_documents;
+    const QStringRef *_documents;
+    int               _size;
+    QVector<int>      _ends;
+};
+
+/**
+ * \internal
+ * \brief The GzipReader class decompresses a gzip file into a block queue on a thread of its own.
+ *
+ * Files consisting of several concatenated gzip members are decompressed as a whole.
+ * The queue is closed when the file ends, when decompression fails or when the
+ * consumer closes the queue itself.
+ *
+ * \sa BlockQueue
+ */
+class GzipReader : public QThread {
+public:
+    GzipReader(const QString &fname, BlockQueue *queue) : _fname(fname), _queue(queue), _is_ok(true) {}
+
+    //! Returns \c true if the file was accessible and decompressed without errors.
+    inline bool isOk() const { return _is_ok; }
+
+protected:
+    virtual void run()
+    {
+        QFile file(_fname);
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        if (!file.open(QIODevice::ReadOnly) || inflateInit2(&stream, 15 + 16 /* gzip only */) != Z_OK) {
+            _is_ok = false;
+            _queue->close();
+            return;
+        }
+
+        QByteArray input(DEFAULT_GZIP_BLOCK_SIZE / 4, Qt::Uninitialized);
+        int  status  = Z_OK;
+        bool is_done = false;
+        while (_is_ok && !is_done) {
+            QByteArray block(DEFAULT_GZIP_BLOCK_SIZE, Qt::Uninitialized);
+            stream.next_out  = reinterpret_cast<Bytef*>(block.data());
+            stream.avail_out = block.size();
+            while (stream.avail_out > 0) {
+                if (stream.avail_in == 0) {
+                    qint64 size = file.read(input.data(), input.size());
+                    if (size <= 0) {
+                        // Truncated input is an error as well
+                        _is_ok  = size == 0 && status == Z_STREAM_END;
+                        is_done = true;
+                        break;
+                    }
+                    stream.next_in  = reinterpret_cast<Bytef*>(input.data());
+                    stream.avail_in = (uInt)size;
+                }
+                if (status == Z_STREAM_END)
+                    inflateReset(&stream); // Next member of the file
+                status = inflate(&stream, Z_NO_FLUSH);
+                if (status != Z_OK && status != Z_STREAM_END) {
+                    _is_ok = false;
+                    break;
+                }
+            }
+            block.resize(block.size() - stream.avail_out);
+            if (!block.isEmpty() && !_queue->push(block))
+                break;
+        }
+
+        inflateEnd(&stream);
+        _queue->close();
+    }
+
+private:
+    QString     _fname;
+    BlockQueue *_queue;
+    bool        _is_ok;
+};
+
+/**
+ * \internal
+ * \brief The DirectoryReader class reads whole files into a block queue on a thread of its own.
+ *
+ * Exactly one block is pushed per file in the order of file names, a null block
+ * standing for a file which is not accessible. Up to \c DEFAULT_READ_AHEAD_FILES
+ * files are opened ahead of the one being read, and the kernel is advised to read
+ * them ahead, so many reads are in flight while the current file is consumed.
+ *
+ * Gzip-compressed files and files larger than \c MAX_CHUNK_SIZE are not read but
+ * deferred: An empty block is pushed for them, and the consumer is expected to
+ * read them by name.
+ *
+ * \sa Text::appendDirectory
+ */
+class DirectoryReader : public QThread {
+public:
+    DirectoryReader(const QStringList &fnames, BlockQueue *queue)
+        : _fnames(fnames), _queue(queue), _is_deferred(fnames.size(), false) {}
+
+    //! Returns \c true if the file was deferred, valid once its block is popped.
+    inline bool isDeferred(int i) const { return _is_deferred.at(i); }
+
+protected:
+    virtual void run()
+    {
+#ifdef Q_OS_UNIX
+        QQueue<int> opened;
+        int next = 0;
+        for (int i = 0; i < _fnames.size(); i++) {
+            while (next < _fnames.size() && next < i + DEFAULT_READ_AHEAD_FILES) {
+                int fd = ::open(QFile::encodeName(_fnames.at(next)).constData(), O_RDONLY);
+#ifdef POSIX_FADV_WILLNEED
+                if (fd >= 0)
+                    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+                opened.enqueue(fd);
+                next++;
+            }
+
+            int fd = opened.dequeue();
+            QByteArray contents = read_file(fd, &_is_deferred[i]);
+            if (fd >= 0)
+                ::close(fd);
+            if (!_queue->push(contents))
+                break;
+        }
+        while (!opened.isEmpty()) {
+            int fd = opened.dequeue();
+            if (fd >= 0)
+                ::close(fd);
+        }
+#else
+        for (int i = 0; i < _fnames.size(); i++) {
+            QFile file(_fnames.at(i));
+            QByteArray contents;
+            if (file.open(QIODevice::ReadOnly)) {
+                _is_deferred[i] = file.size() > MAX_CHUNK_SIZE || Text::is_gzip(file.peek(2));
+                if (!_is_deferred[i])
+                    contents = file.readAll();
+                if (contents.isNull())
+                    contents = QByteArray("", 0);
+            }
+            if (!_queue->push(contents))
+                break;
+        }
+#endif
+        _queue->close();
+    }
+
+private:
+    QStringList    _fnames;
+    BlockQueue    *_queue;
+    QVector<bool>  _is_deferred; //!< Flags of deferred files, set before their blocks are pushed
+
+#ifdef Q_OS_UNIX
+    /**
+     * Reads the whole file, returns a null array on errors and an empty one for
+     * empty and deferred files.
+     */
+    static QByteArray read_file(int fd, bool *is_deferred)
+    {
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0)
+            return QByteArray();
+
+        char header[2];
+        *is_deferred = info.st_size > MAX_CHUNK_SIZE
+                || (pread(fd, header, sizeof(header), 0) == sizeof(header) && Text::is_gzip(QByteArray(header, sizeof(header))));
+        if (*is_deferred)
+            return QByteArray("", 0);
+
+        QByteArray contents("", 0);
+        contents.resize((int)info.st_size);
+        qint64 offset = 0;
+        while (offset < contents.size()) {
+            ssize_t size = ::read(fd, contents.data() + offset, contents.size() - offset);
+            if (size < 0)
+                return QByteArray();
+            if (size == 0)
+                break; // File got truncated meanwhile
+            offset += size;
+        }
+        contents.resize((int)offset);
+        return contents;
+    }
+#endif
+};
+
+/**
+ * \internal
+ * \brief The BlockTokenizer class collects keys of tokens of input arriving in arbitrary blocks.
+ *
+ * The codec of the input is detected on the first block. Bytes or characters of
+ * the incomplete token at the end of a block are carried over to the next one.
+ */
+class BlockTokenizer {
+public:
+    BlockTokenizer(const Text *text) : _text(text), _decoder(NULL), _is_utf8(false), _is_started(false) {}
+    ~BlockTokenizer() { delete _decoder; }
+
+    /**
+     * \brief Collects keys of tokens of the next block.
+     * \param[in]  block     Next block of the input.
+     * \param[in]  is_final  Whether the block is the last one in the input.
+     * \param[out] keys      Vector to append keys to.
+     * \param[out] utf8_keys   Vector to append keys to if the input is tokenized as raw UTF-8 bytes.
+     * \param[out] capitalized Vector to append offsets of keys of capitalized tokens to.
+     * \param[out] stats       Counters and timings to update.
+     */
+    void tokenize(const QByteArray &block, bool is_final, QVector<QString> *keys, QVector<QByteArray> *utf8_keys,
+                  QVector<int> *capitalized, TextStats *stats)
+    {
+        stats->bytes_read += block.size();
+
+        int skip = 0;
+        if (!_is_started) {
+            _is_started = true;
+            QTextCodec *codec = Text::detect_codec(block.constData(), block.size());
+            _is_utf8 = _text->is_utf8_codec(codec);
+            if (_is_utf8)
+                skip = Text::utf8_bom_size(block.constData(), block.size());
+            else
+                _decoder = codec->makeDecoder();
+        }
+
+        if (_is_utf8) {
+            _utf8_part.append(block.constData() + skip, block.size() - skip);
+            int processed = _text->tokenize_utf8_buffer(_utf8_part.constData(), _utf8_part.size(), is_final, utf8_keys, capitalized, stats);
+            _utf8_part    = _utf8_part.mid(processed);
+        } else {
+            QString buffer = _token_part + _decoder->toUnicode(block);
+            int processed  = _text->tokenize_buffer(buffer, is_final, keys, capitalized, stats);
+            _token_part    = buffer.mid(processed);
+        }
+    }
+
+private:
+    const Text   *_text;
+    QTextDecoder *_decoder;
+    bool          _is_utf8;
+    bool          _is_started;
+    QString       _token_part;
+    QByteArray    _utf8_part;
+};
+
 /**
  * \class Text
  *
@@ -25,9 +402,73 @@ Text::~Text() {
     delete idx_lex;
 }
 
+/**
+ * Removes all tokens from the text.
+ *
+ * Settings like the locale, the lemmatizer and stopwords as well as collected
+ * stats are kept, so the text can be reused for indexing further input.
+ *
+ * \sa IndexBuilder
+ */
+void Text::clear()
+{
+    // Cached lexemes belong to the indeces being replaced:
+    _surface_forms.clear();
+    _utf8_keys.clear();
+    _lemmas.clear();
+
+    delete idx_wf;
+    delete idx_lex;
+    idx_wf  = new LexemeIndex();
+    idx_lex = new LexemeIndex();
+    _documents.clear();
+    _boundaries.clear();
+    _budget_check_pos = DEFAULT_BUDGET_CHECK_SIZE;
+}
+
+/**
+ * Returns memory occupied by the text indeces and caches in bytes.
+ *
+ * Vectors are sized by their actual capacities, while nodes of hashes and
+ * slots of the surface form cache are estimated by their typical sizes.
+ *
+ * \sa setSegmentWriter
+ * \sa IndexBuilder
+ */
+qint64 Text::memoryUsage() const
+{
+    const qint64 bytes_per_node = 32; // Node of a hash: next node, hash, key and value
+    const qint64 bytes_per_slot = 48; // Slot of the surface form cache with a short surface form
+
+    qint64 usage = idx_wf->memoryUsage() + idx_lex->memoryUsage();
+    usage += _boundaries.memoryUsage() + _documents.memoryUsage();
+    usage += _surface_forms.capacity() * bytes_per_slot;
+    usage += (_utf8_keys.capacity() + _lemmas.capacity()) * (qint64)sizeof(void*);
+    usage += (_utf8_keys.size() + _lemmas.size()) * bytes_per_node;
+
+    QHash<QByteArray, Lexeme*>::const_iterator it;
+    for (it = _utf8_keys.constBegin(); it != _utf8_keys.constEnd(); ++it)
+        usage += it.key().capacity();
+    return usage;
+}
+
 /**
  * Appends contents of a file referenced by its name to the text.
  *
+ * If memory mapping is enabled, the file is mapped and decoded window by window
+ * directly from the mapped pages. Files that can not be mapped are read through
+ * a stream as usual.
+ *
+ * If more than one thread is allowed, large files are always mapped and split into
+ * chunks which are tokenized concurrently. The resulting indeces are identical to
+ * the ones built by a single thread.
+ *
+ * If the UTF-8 pipeline is enabled, UTF-8 files are always mapped and tokenized
+ * as raw bytes.
+ *
+ * Gzip-compressed files are detected by their signature and decompressed on
+ * a separate thread while already decompressed blocks are being tokenized.
+ *
  * \param[in] fname Name of the file to append to the text.
  *
  * \returns \c true on success and \c false if the file is not accessible.
@@ -35,18 +476,52 @@ Text::~Text() {
  * \note
  * The method will return \c true on empty files and files containing whitespace
  * characters only.
+ *
+ * \sa setMemoryMapping
+ * \sa setNumThreads
+ * \sa setUtf8Pipeline
+ * \sa setDuplicateDetector
  */
 bool Text::appendFile(const QString &fname)
 {
     LOG_INFO() << "Starting indexing file" << fname;
 
     QFile file(fname);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         LOG_WARNING("Unable to access file");
         return false;
     }
 
-    return append_file(&file);
+    if (_duplicates != NULL) {
+        file.close();
+        bool is_ok = append_whole_file(fname);
+        report_status(true);
+        return is_ok;
+    }
+
+    start_document();
+
+    bool is_ok = append_opened_file(&file);
+    report_status(true);
+    return is_ok;
+}
+
+//! \internal Appends contents of an opened file to the text choosing the way of reading it.
+bool Text::append_opened_file(QFile *file)
+{
+    if (is_gzip(file->peek(2))) {
+        file->close();
+        return append_gzip_file(file->fileName());
+    }
+
+    if (_use_mmap || _use_utf8 || _num_threads > 1) {
+        if (append_mapped_file(file))
+            return true;
+        LOG_WARNING("Unable to map file, falling back to stream reading");
+    }
+
+    file->setTextModeEnabled(true);
+    return append_file(file);
 }
 
 /**
@@ -72,44 +547,228 @@ bool Text::appendFile(FILE *fd)
         return false;
     }
 
-    return append_file(&file);
+    if (_duplicates != NULL) {
+        // The document has to be tokenized whole before being checked
+        const QByteArray contents = file.readAll();
+        _stats.bytes_read += contents.size();
+        append_document(QTextStream(contents).readAll());
+        report_status(true);
+        return true;
+    }
+
+    start_document();
+
+    bool is_ok = append_file(&file);
+    report_status(true);
+    return is_ok;
+}
+
+/**
+ * Appends contents of several files to the text.
+ *
+ * Files are tokenized concurrently on up to \c num_threads threads, larger files
+ * first, while the calling thread adds their tokens to the indeces strictly in the
+ * order of \c fnames. The resulting indeces are therefore identical to the ones
+ * built by calling \c appendFile for each file in a loop.
+ *
+ * \param[in] fnames      Names of the files to append to the text.
+ * \param[in] num_threads Maximum number of threads to use. 0 or negative value
+ *                        falls back to \c QThread::idealThreadCount().
+ *
+ * \returns \c true on success and \c false if at least one of the files is
+ * not accessible. Accessible files are appended in any case.
+ *
+ * \note
+ * Tokens of a file are kept in memory until all preceding files are added to
+ * the indeces.
+ *
+ * Each accessible file starts a new document.
+ *
+ * \sa appendFile
+ */
+bool Text::appendFiles(const QStringList &fnames, int num_threads /*= 0*/)
+{
+    LOG_INFO() << "Starting indexing" << fnames.size() << "files";
+
+    if (num_threads < 1)
+        num_threads = QThread::idealThreadCount();
+
+    QVector< QPair<qint64, int> > schedule;
+    for (int i = 0; i < fnames.size(); i++) {
+        schedule.append(qMakePair(QFileInfo(fnames.at(i)).size(), i));
+    }
+    std::sort(schedule.begin(), schedule.end(), Text::is_larger_file);
+
+    QVector<TokenizerJob*> jobs(fnames.size());
+    for (int i = 0; i < schedule.size(); i++) {
+        int idx = schedule.at(i).second;
+        jobs[idx] = new FileTokenizer(this, fnames.at(idx));
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(num_threads);
+    for (int i = 0; i < schedule.size(); i++) {
+        pool.start(jobs.at(schedule.at(i).second));
+    }
+
+    bool is_ok = true;
+    for (int i = 0; i < jobs.size(); i++) {
+        TokenizerJob *job = jobs.at(i);
+        job->wait();
+        _stats += job->stats();
+        if (job->isOk()) {
+            if (job->utf8Keys().isEmpty())
+                index_document(job->keys(), job->capitalized());
+            else
+                index_utf8_document(job->utf8Keys(), job->capitalized());
+        } else {
+            LOG_WARNING() << "Unable to access file" << fnames.at(i);
+            is_ok = false;
+        }
+        delete job;
+        report_status(false);
+        check_memory_budget();
+    }
+    report_status(true);
+
+    LOG_INFO("Files indexed");
+
+    return is_ok;
+}
+
+/**
+ * Appends contents of all files of a directory and its subdirectories to the text.
+ *
+ * This mode is meant for corpora of many small files. Files are read whole on
+ * a separate thread which keeps up to \c DEFAULT_READ_AHEAD_FILES reads in flight,
+ * so opening and reading files overlaps tokenization. Read files are tokenized
+ * straight from the read buffers: UTF-8 and ASCII files are grouped and passed to
+ * \c appendMany, files in other encodings are decoded and appended one by one.
+ * Gzip-compressed files and files larger than \c MAX_CHUNK_SIZE are not read
+ * ahead but streamed from disk, as \c appendFile does.
+ *
+ * Files are appended in the order of their paths, each non-empty file starts
+ * a new document, and empty files are skipped.
+ *
+ * \param[in] path         Path to the directory.
+ * \param[in] name_filters Wildcards file names have to match, e.g. \c "*.txt". Empty list matches all files.
+ * \param[in] num_threads  Maximum number of threads to tokenize files on, see \c appendMany.
+ *
+ * \returns \c true on success and \c false if the directory or at least one of the files
+ * is not accessible. Accessible files are appended in any case.
+ *
+ * \sa appendFiles
+ * \sa appendMany
+ */
+bool Text::appendDirectory(const QString &path, const QStringList &name_filters /*= QStringList()*/,
+                           int num_threads /*= 1*/)
+{
+    LOG_INFO() << "Starting indexing directory" << path;
+
+    if (!QFileInfo(path).isDir()) {
+        LOG_WARNING("Unable to access directory");
+        return false;
+    }
+
+    if (num_threads < 1)
+        num_threads = QThread::idealThreadCount();
+
+    QStringList fnames;
+    QDirIterator it(path, name_filters, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        fnames.append(it.next());
+    }
+    fnames.sort();
+
+    BlockQueue      queue(DEFAULT_READ_AHEAD_FILES);
+    DirectoryReader reader(fnames, &queue);
+    reader.start();
+
+    bool                is_ok = true;
+    QVector<QByteArray> batch;
+    qint64              batch_size = 0;
+    QByteArray          contents;
+    for (int i = 0; i < fnames.size() && queue.pop(&contents); i++) {
+        if (contents.isNull()) {
+            LOG_WARNING() << "Unable to access file" << fnames.at(i);
+            is_ok = false;
+            continue;
+        }
+        if (contents.isEmpty() && !reader.isDeferred(i))
+            continue;
+
+        QTextCodec *codec = NULL;
+        if (!reader.isDeferred(i)) {
+            codec = detect_codec(contents.constData(), contents.size());
+            const int mib = codec->mibEnum();
+            if (mib == 106 /* UTF-8 */ || mib == 3 /* US-ASCII */) {
+                batch.append(contents);
+                batch_size += contents.size();
+                if (batch_size >= _chunk_size * num_threads) {
+                    append_batches(batch.constData(), NULL, batch.size(), num_threads);
+                    batch.clear();
+                    batch_size = 0;
+                }
+                continue;
+            }
+        }
+
+        // Keep the order of files: Flush the batch before appending a file on its own
+        append_batches(batch.constData(), NULL, batch.size(), num_threads);
+        batch.clear();
+        batch_size = 0;
+
+        if (codec == NULL) {
+            // Gzip-compressed and large files are read by name in a streamed way
+            if (!append_whole_file(fnames.at(i)))
+                is_ok = false;
+            continue;
+        }
+        _stats.bytes_read += contents.size();
+        append_document(codec->toUnicode(contents));
+    }
+    append_batches(batch.constData(), NULL, batch.size(), num_threads);
+
+    queue.close();
+    reader.wait();
+    report_status(true);
+
+    LOG_INFO("Directory indexed");
+
+    return is_ok;
+}
+
+//! \internal Orders files by size, larger first, keeping the original order for files of the same size.
+/*static*/ bool Text::is_larger_file(const QPair<qint64, int> &f1, const QPair<qint64, int> &f2)
+{
+    if (f1.first != f2.first)
+        return f1.first > f2.first;
+    return f1.second < f2.second;
 }
 
 bool Text::append_file(QFile *file)
 {
+    // Sequential devices do not report their position, characters are counted instead
+    const qint64 bytes_read = _stats.bytes_read;
+    qint64       num_chars  = 0;
+
     QTextStream file_stream(file);
     QString     buffer = file_stream.read(DEFAULT_READ_BUFFER_SIZE);
     QString     token_part;
     while (buffer.length() > 0) {
-        QTextBoundaryFinder *boundary_finder = new QTextBoundaryFinder(
-            QTextBoundaryFinder::Word, buffer
-        );
-        int pos_start = boundary_finder->position();
-        int pos_end   = boundary_finder->toNextBoundary();
-        while (pos_end != -1) {
-            QStringRef token = buffer.midRef(pos_start, pos_end - pos_start);
-            pos_start = pos_end;
-            pos_end   = boundary_finder->toNextBoundary();
-            if (pos_end != -1) {
-                LOG_DEBUG() << "token =" << token;
-                process_token(token);
-            } else {
-                token_part = token.toString();
-                LOG_DEBUG() << "token_part =" << token_part;
-            }
-        };
-        delete boundary_finder;
+        QString _buffer = file_stream.read(DEFAULT_READ_BUFFER_SIZE);
+        bool is_final   = _buffer.isEmpty();
+
+        num_chars += buffer.length() - token_part.length();
+        _stats.bytes_read = bytes_read + (file->isSequential()? num_chars : file->pos());
+
+        int processed = process_buffer(buffer, is_final);
+        token_part    = buffer.mid(processed);
+        LOG_DEBUG() << "token_part =" << token_part;
 
         buffer.clear();
-        QString _buffer = file_stream.read(DEFAULT_READ_BUFFER_SIZE);
-        if (!_buffer.isNull()) {
+        if (!is_final)
             buffer.append(token_part).append(_buffer);
-        } else {
-            /* Last chunk is guaranteed to be a valid token, process it: */
-            LOG_DEBUG() << "very_last_token =" << (token_part);
-            QStringRef token = token_part.midRef(0, token_part.length());
-            process_token(token);
-        }
     }
 
     LOG_INFO("File indexed");
@@ -118,120 +777,1505 @@ bool Text::append_file(QFile *file)
 }
 
 /**
- * Appends contents of a string buffer to the text.
+ * \internal Appends contents of a gzip-compressed file to the text.
  *
- * \param[in] buffer Buffer to append to the text.
+ * The file is decompressed by a \c GzipReader thread into a queue of at most
+ * \c DEFAULT_GZIP_QUEUE_SIZE blocks, so decompression of the next blocks overlaps
+ * tokenization of the current one. Keys of each block are added to the indeces
+ * as soon as the block is tokenized.
  *
- * \returns \c true on success and \c false if the buffer is a null/empty string.
+ * \returns \c true on success and \c false if the file is not accessible or corrupt.
+ * In the latter case the contents decompressed before the error are appended anyway.
  */
-bool Text::append(const QString &buffer)
+bool Text::append_gzip_file(const QString &fname)
 {
-    if (buffer.isEmpty() || buffer.isNull())
+    BlockQueue queue(DEFAULT_GZIP_QUEUE_SIZE);
+    GzipReader reader(fname, &queue);
+    reader.start();
+
+    BlockTokenizer      tokenizer(this);
+    QByteArray          block;
+    QVector<QString>    keys;
+    QVector<QByteArray> utf8_keys;
+    QVector<int>        capitalized;
+    bool is_final = false;
+    while (!is_final) {
+        is_final = !queue.pop(&block);
+        if (is_final)
+            block.clear();
+        tokenizer.tokenize(block, is_final, &keys, &utf8_keys, &capitalized, &_stats);
+        index_keys(keys, capitalized);
+        index_utf8_keys(utf8_keys, capitalized);
+        keys.clear();
+        utf8_keys.clear();
+        capitalized.clear();
+        report_status(false);
+        check_memory_budget();
+    }
+    reader.wait();
+
+    if (!reader.isOk()) {
+        LOG_WARNING("Unable to decompress file");
         return false;
+    }
+
+    LOG_INFO("File indexed");
 
-    QTextBoundaryFinder *boundary_finder = new QTextBoundaryFinder(
-        QTextBoundaryFinder::Word, buffer
-    );
-    int pos_start = boundary_finder->position();
-    int pos_end   = boundary_finder->toNextBoundary();
-    while (pos_end != -1) {
-        QStringRef token = buffer.midRef(pos_start, pos_end - pos_start);
-        pos_start = pos_end;
-        pos_end   = boundary_finder->toNextBoundary();
-        LOG_DEBUG() << "token =" << token;
-        process_token(token);
-    };
-    delete boundary_finder;
     return true;
 }
 
 /**
- * Detects whether a token consists of whitespace characters only.
+ * \internal Collects keys of non-whitespace tokens of a gzip-compressed file without
+ * touching the indeces.
  *
- * \param[in] token Token to be checked.
+ * This method is safe to be called from worker threads.
  *
- * \returns \c true if a token consists of whitespace characters only and \c false otherwise.
+ * \sa append_gzip_file
+ * \sa tokenize_file
  */
-bool Text::is_whitespace_token(const QStringRef &token)
+bool Text::tokenize_gzip_file(const QString &fname, QVector<QString> *keys, QVector<QByteArray> *utf8_keys,
+                              QVector<int> *capitalized, TextStats *stats) const
 {
-    const QChar *chars = token.unicode();
-    for (int i = 0; i < token.length(); i++) {
-        if (!chars[i].isSpace())
-            return false;
+    BlockQueue queue(DEFAULT_GZIP_QUEUE_SIZE);
+    GzipReader reader(fname, &queue);
+    reader.start();
+
+    BlockTokenizer tokenizer(this);
+    QByteArray     block;
+    while (queue.pop(&block)) {
+        tokenizer.tokenize(block, false, keys, utf8_keys, capitalized, stats);
     }
-    return true;
+    tokenizer.tokenize(QByteArray(), true, keys, utf8_keys, capitalized, stats);
+    reader.wait();
+
+    return reader.isOk();
+}
+
+//! \internal Returns \c true if the header of a file is the signature of gzip format.
+/*static*/ bool Text::is_gzip(const QByteArray &header)
+{
+    return header.size() >= 2 && (uchar)header.at(0) == 0x1F && (uchar)header.at(1) == 0x8B;
 }
 
 /**
- * Detects whether a token is a boundary token.
+ * \internal Appends contents of a memory-mapped file to the text.
  *
- * \param[in] token Token to be checked.
+ * The file is decoded in windows of \c DEFAULT_MAP_WINDOW_SIZE bytes straight
+ * from the mapped pages, so no intermediate read buffers are involved and
+ * tokens are passed to \c process_token as views into the decoded window. Only
+ * the incomplete token at the end of a window is carried over to the next one.
  *
- * \returns \c true if a token is a boundary token and \c false otherwise.
+ * \returns \c true on success and \c false if the file can not be mapped.
  */
-bool Text::is_boundary_token(const QStringRef &token)
+bool Text::append_mapped_file(QFile *file)
 {
-    const QChar *chars = token.unicode();
-    for (int i = 0; i < token.length(); i++) {
-        bool is_punct_char = chars[i].isPunct()
-            ||  chars[i] < 0x30                     // includes chars like '*', '+', etc.
-            || (chars[i] > 0x39 && chars[i] < 0x41) // includes chars like '<', '>', etc.
-            || (chars[i] > 0x5A && chars[i] < 0x61) // includes chars like '^', '`', etc.
-            || (chars[i] > 0x7A && chars[i] < 0x7F) // includes chars like '|', '~', etc.
-        ;
-        if (!is_punct_char)
-            return false;
+    const qint64 size = file->size();
+    if (size == 0) {
+        LOG_INFO("File indexed");
+        return true;
     }
-    return true;
-}
 
-QString* Text::normalize_token(const QStringRef &token, bool is_boundary)
-{
-    QString *normalized;
+    uchar *data = file->map(0, size);
+    if (data == NULL)
+        return false;
 
-    if (is_boundary) {
-        normalized = new QString(token.toString());
-    } else {
-        // 2DO: add an entry point morphology routines
-        normalized = new QString(_locale.toLower(token.toString()));
+    _stats.bytes_read += size;
+
+    const char *bytes = reinterpret_cast<const char*>(data);
+    QTextCodec *codec = detect_codec(bytes, size);
+
+    const int mib = codec->mibEnum();
+    const bool is_ascii_compatible = mib == 106 /* UTF-8 */ || mib == 4 /* Latin-1 */ || mib == 3 /* US-ASCII */;
+    const bool is_utf8 = is_utf8_codec(codec);
+    if (_num_threads > 1 && size > _chunk_size && is_ascii_compatible) {
+        bool is_ok = append_chunked(bytes, size, is_utf8? NULL : codec);
+        file->unmap(data);
+        LOG_INFO("File indexed");
+        return is_ok;
+    }
+
+    if (is_utf8) {
+        append_utf8(bytes, size);
+        file->unmap(data);
+        LOG_INFO("File indexed");
+        return true;
+    }
+
+    QTextDecoder decoder(codec);
+
+    QString token_part;
+    qint64  offset = 0;
+    while (offset < size) {
+        const qint64 window = qMin(DEFAULT_MAP_WINDOW_SIZE, size - offset);
+        QString buffer      = token_part + decoder.toUnicode(bytes + offset, (int)window);
+        offset += window;
+
+        int processed = process_buffer(buffer, offset == size);
+        token_part    = buffer.mid(processed);
     }
 
-    return normalized;
+    file->unmap(data);
+
+    LOG_INFO("File indexed");
+
+    return true;
 }
 
 /**
- * Adds a token to the text indeces.
+ * \internal Tokenizes a memory-mapped file in chunks on several threads.
  *
- * All whitespace tokens are ignored. If the token is lemmatized to a new lexeme
- * it is inserted into the index of lexemes.
+ * The file is split into chunks of approximately \c chunkSize bytes at
+ * safe split points (see \c find_split_point). Chunks are decoded and tokenized
+ * on a thread pool, while the calling thread stitches the produced keys into the
+ * index of wordforms strictly in the order of chunks, so positions are the same
+ * as in a sequential run. At most two chunks per thread are kept in flight.
  *
- * \param[in] token Token to process.
+ * Chunks never exceed \c MAX_CHUNK_SIZE: If there is no safe split point within
+ * that distance, the chunk is cut at the nearest UTF-8 sequence start instead,
+ * which may split a token of such pathological input.
  *
- * \returns \c true if a token consists of whitespace characters only and \c false otherwise.
+ * \param[in] bytes Mapped contents of the file.
+ * \param[in] size  Size of the file in bytes.
+ * \param[in] codec Codec of the file, should be ASCII-compatible. \c NULL makes chunks
+ *                  tokenized as raw UTF-8 bytes.
+ *
+ * \returns \c true on success.
  */
-bool Text::process_token(const QStringRef &token)
+bool Text::append_chunked(const char *bytes, qint64 size, QTextCodec *codec)
 {
-    if (is_whitespace_token(token))
-        return false;
+    QThreadPool pool;
+    pool.setMaxThreadCount(_num_threads);
 
-    QString token_key = _locale.toLower(token.toString());
-    int  pos          = idx_wf->numUniquePositions();
-    bool is_new       = false;
+    QList<TokenizerJob*> in_flight;
+    qint64 offset = codec == NULL? utf8_bom_size(bytes, size) : 0;
+    while (offset < size || !in_flight.isEmpty()) {
+        while (offset < size && in_flight.size() < 2 * _num_threads) {
+            const qint64 limit = qMin(size, offset + MAX_CHUNK_SIZE);
+            qint64 end = find_split_point(bytes, limit, offset + _chunk_size);
+            if (end == limit && limit < size) {
+                while (end > offset + 1 && ((uchar)bytes[end] & 0xC0) == 0x80) {
+                    end--;
+                }
+            }
+            ChunkTokenizer *chunk = new ChunkTokenizer(this, codec, bytes + offset, (int)(end - offset));
+            in_flight.append(chunk);
+            pool.start(chunk);
+            offset = end;
+        }
 
-    Lexeme *lexeme = idx_wf->addPosition(token_key, pos, &is_new);
-    if (is_new == true) {
-        // FIXME: Add other universal properties (is_number etc.)
-        bool is_boundary = is_boundary_token(token);
-        lexeme->setIsBoundary(is_boundary);
+        TokenizerJob *chunk = in_flight.takeFirst();
+        chunk->wait();
+        _stats += chunk->stats();
+        index_keys(chunk->keys(), chunk->capitalized());
+        index_utf8_keys(chunk->utf8Keys(), chunk->capitalized());
+        delete chunk;
+        report_status(false);
+        check_memory_budget();
     }
 
     return true;
 }
 
-//! \internal Initializes class members.
-void Text::_initialize(const QLocale &locale)
+/**
+ * \internal Finds a safe point to split a file at.
+ *
+ * A split point is safe if it directly follows an ASCII whitespace character
+ * and is followed by another ASCII character: The word boundary between them
+ * is unconditional, and no multibyte sequence can be cut.
+ *
+ * \param[in] bytes Contents of the file.
+ * \param[in] size  Size of the file in bytes.
+ * \param[in] from  Offset to start searching at.
+ *
+ * \returns Offset of the split point or \c size if there is no safe split point after \c from.
+ */
+/*static*/ qint64 Text::find_split_point(const char *bytes, qint64 size, qint64 from)
 {
-    _locale = locale;
-    idx_wf  = new LexemeIndex();
-    idx_lex = new LexemeIndex();
+    for (qint64 i = qMax(from, (qint64)1); i < size; i++) {
+        const uchar prev = (uchar)bytes[i - 1];
+        const uchar next = (uchar)bytes[i];
+        bool is_space = prev == ' ' || prev == '\t' || prev == '\n' || prev == '\r' || prev == '\f' || prev == '\v';
+        if (is_space && next < 0x80)
+            return i;
+    }
+    return size;
+}
+
+/**
+ * \internal Appends UTF-8 encoded contents to the text without decoding them.
+ *
+ * The contents are tokenized in windows of \c DEFAULT_MAP_WINDOW_SIZE bytes. As the
+ * contents are contiguous, the incomplete token at the end of a window is not copied
+ * but simply becomes the beginning of the next window.
+ *
+ * \param[in] bytes UTF-8 encoded contents, optionally starting with a byte order mark.
+ * \param[in] size  Size of the contents in bytes.
+ */
+void Text::append_utf8(const char *bytes, qint64 size)
+{
+    qint64 start = utf8_bom_size(bytes, size);
+    qint64 end   = start;
+    while (start < size) {
+        end    = qMin(size, end + DEFAULT_MAP_WINDOW_SIZE);
+        start += process_utf8_buffer(bytes + start, (int)(end - start), end == size);
+    }
+}
+
+/**
+ * \internal Splits UTF-8 encoded contents of any size into tokens.
+ *
+ * The contents are tokenized in windows of \c DEFAULT_MAP_WINDOW_SIZE bytes like
+ * \c append_utf8 does, so the length of a window always fits into \c int. This
+ * method is safe to be called from worker threads.
+ *
+ * \param[in]  bytes       UTF-8 encoded contents, optionally starting with a byte order mark.
+ * \param[in]  size        Size of the contents in bytes.
+ * \param[out] keys        Vector to append keys to.
+ * \param[out] capitalized Vector to append offsets of keys of capitalized tokens to.
+ * \param[out] stats       Counters and timings to update.
+ */
+void Text::tokenize_utf8_contents(const char *bytes, qint64 size, QVector<QByteArray> *keys,
+                                  QVector<int> *capitalized, TextStats *stats) const
+{
+    qint64 start = utf8_bom_size(bytes, size);
+    qint64 end   = start;
+    while (start < size) {
+        end    = qMin(size, end + DEFAULT_MAP_WINDOW_SIZE);
+        start += tokenize_utf8_buffer(bytes + start, (int)(end - start), end == size, keys, capitalized, stats);
+    }
+}
+
+//! \internal Returns size of the UTF-8 byte order mark at the beginning of contents, 0 if there is none.
+/*static*/ int Text::utf8_bom_size(const char *bytes, qint64 size)
+{
+    if (size >= 3 && (uchar)bytes[0] == 0xEF && (uchar)bytes[1] == 0xBB && (uchar)bytes[2] == 0xBF)
+        return 3;
+    return 0;
+}
+
+//! \internal Returns \c true if input in the given codec is to be tokenized as raw UTF-8 bytes.
+bool Text::is_utf8_codec(QTextCodec *codec) const
+{
+    const int mib = codec->mibEnum();
+    return _use_utf8 && (mib == 106 /* UTF-8 */ || mib == 3 /* US-ASCII */);
+}
+
+/**
+ * \internal Splits a buffer into tokens and processes them.
+ *
+ * \param[in] buffer   Buffer to process.
+ * \param[in] is_final Whether the buffer is the last one in the input.
+ *
+ * \returns Offset of the first unprocessed character in the buffer.
+ *
+ * \sa Tokenizer::tokenize
+ */
+int Text::process_buffer(const QString &buffer, bool is_final)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Tokenizer::Token> tokens;
+    int processed = _tokenizer.tokenize(buffer, is_final, &tokens);
+    _stats.tokenize_nsecs += timer.nsecsElapsed();
+
+    timer.restart();
+    qint64 num_indexed = 0;
+    for (int i = 0; i < tokens.size(); i++) {
+        LOG_DEBUG() << "token =" << tokens.at(i).text;
+        if (process_token(tokens.at(i)))
+            num_indexed++;
+    }
+    _stats.index_nsecs       += timer.nsecsElapsed();
+    _stats.tokens            += tokens.size();
+    _stats.whitespace_tokens += tokens.size() - num_indexed;
+
+    report_status(false);
+    check_memory_budget();
+    return processed;
+}
+
+/**
+ * \internal Splits a UTF-8 buffer into tokens and processes them.
+ *
+ * \param[in] bytes    Buffer to process.
+ * \param[in] len      Length of the buffer in bytes.
+ * \param[in] is_final Whether the buffer is the last one in the input.
+ *
+ * \returns Offset of the first unprocessed byte in the buffer.
+ *
+ * \sa Tokenizer::tokenizeUtf8
+ */
+int Text::process_utf8_buffer(const char *bytes, int len, bool is_final)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Tokenizer::Utf8Token> tokens;
+    int processed = _tokenizer.tokenizeUtf8(bytes, len, is_final, &tokens);
+    _stats.tokenize_nsecs += timer.nsecsElapsed();
+
+    timer.restart();
+    qint64     num_indexed = 0;
+    QByteArray key;
+    for (int i = 0; i < tokens.size(); i++) {
+        if (process_utf8_token(tokens.at(i), &key))
+            num_indexed++;
+    }
+    _stats.index_nsecs       += timer.nsecsElapsed();
+    _stats.tokens            += tokens.size();
+    _stats.whitespace_tokens += tokens.size() - num_indexed;
+
+    report_status(false);
+    check_memory_budget();
+    return processed;
+}
+
+/**
+ * \internal Collects keys of non-whitespace tokens of a buffer without touching the indeces.
+ *
+ * This method is safe to be called from worker threads.
+ *
+ * \param[in]  buffer   Buffer to tokenize.
+ * \param[in]  is_final Whether the buffer is the last one in the input.
+ * \param[out] keys        Vector to append keys to.
+ * \param[out] capitalized Vector to append offsets of keys of capitalized tokens to.
+ * \param[out] stats       Counters and timings to update.
+ *
+ * \returns Offset of the first unprocessed character in the buffer.
+ *
+ * \sa Tokenizer::tokenize
+ */
+int Text::tokenize_buffer(const QString &buffer, bool is_final, QVector<QString> *keys, QVector<int> *capitalized,
+                          TextStats *stats) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Tokenizer::Token> tokens;
+    int processed = _tokenizer.tokenize(buffer, is_final, &tokens);
+    const int num_keys = keys->size();
+    keys->reserve(keys->size() + tokens.size());
+    for (int i = 0; i < tokens.size(); i++) {
+        if (tokens.at(i).type == Tokenizer::TOKEN_WHITESPACE)
+            continue;
+        if (is_capitalized(tokens.at(i).text))
+            capitalized->append(keys->size());
+        keys->append(token_key(tokens.at(i).text));
+    }
+
+    stats->tokenize_nsecs    += timer.nsecsElapsed();
+    stats->tokens            += tokens.size();
+    stats->whitespace_tokens += tokens.size() - (keys->size() - num_keys);
+    return processed;
+}
+
+/**
+ * \internal Collects UTF-8 encoded keys of non-whitespace tokens of a UTF-8 buffer
+ * without touching the indeces.
+ *
+ * This method is safe to be called from worker threads.
+ *
+ * \param[in]  bytes    Buffer to tokenize.
+ * \param[in]  len      Length of the buffer in bytes.
+ * \param[in]  is_final Whether the buffer is the last one in the input.
+ * \param[out] keys        Vector to append keys to.
+ * \param[out] capitalized Vector to append offsets of keys of capitalized tokens to.
+ * \param[out] stats       Counters and timings to update.
+ *
+ * \returns Offset of the first unprocessed byte in the buffer.
+ */
+int Text::tokenize_utf8_buffer(const char *bytes, int len, bool is_final, QVector<QByteArray> *keys,
+                               QVector<int> *capitalized, TextStats *stats) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Tokenizer::Utf8Token> tokens;
+    int processed = _tokenizer.tokenizeUtf8(bytes, len, is_final, &tokens);
+    const int num_keys = keys->size();
+    keys->reserve(keys->size() + tokens.size());
+    for (int i = 0; i < tokens.size(); i++) {
+        if (tokens.at(i).type != Tokenizer::TOKEN_WHITESPACE) {
+            if (is_capitalized(tokens.at(i)))
+                capitalized->append(keys->size());
+            QByteArray key;
+            utf8_token_key(tokens.at(i), &key);
+            keys->append(key);
+        }
+    }
+
+    stats->tokenize_nsecs    += timer.nsecsElapsed();
+    stats->tokens            += tokens.size();
+    stats->whitespace_tokens += tokens.size() - (keys->size() - num_keys);
+    return processed;
+}
+
+/**
+ * \internal Collects keys of non-whitespace tokens of a file without touching the indeces.
+ *
+ * This method is safe to be called from worker threads.
+ *
+ * \param[in]  fname     Name of the file to tokenize.
+ * \param[out] keys      Vector to append keys to.
+ * \param[out] utf8_keys   Vector to append keys to if the file is tokenized as raw UTF-8 bytes.
+ * \param[out] capitalized Vector to append offsets of keys of capitalized tokens to.
+ * \param[out] stats       Counters and timings to update.
+ *
+ * \returns \c true on success and \c false if the file is not accessible.
+ */
+bool Text::tokenize_file(const QString &fname, QVector<QString> *keys, QVector<QByteArray> *utf8_keys,
+                         QVector<int> *capitalized, TextStats *stats) const
+{
+    QFile file(fname);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = file.size();
+    if (size == 0)
+        return true;
+
+    if (is_gzip(file.peek(2))) {
+        file.close();
+        return tokenize_gzip_file(fname, keys, utf8_keys, capitalized, stats);
+    }
+
+    stats->bytes_read += size;
+
+    QByteArray contents;
+    uchar *data = file.map(0, size);
+    if (data == NULL) {
+        contents = file.readAll();
+        data     = reinterpret_cast<uchar*>(contents.data());
+    }
+
+    const char *bytes = reinterpret_cast<const char*>(data);
+    QTextCodec *codec = detect_codec(bytes, size);
+    if (is_utf8_codec(codec)) {
+        tokenize_utf8_contents(bytes, size, utf8_keys, capitalized, stats);
+        if (contents.isNull())
+            file.unmap(data);
+        return true;
+    }
+
+    QTextDecoder decoder(codec);
+
+    QString token_part;
+    qint64  offset = 0;
+    while (offset < size) {
+        const qint64 window = qMin(DEFAULT_MAP_WINDOW_SIZE, size - offset);
+        QString buffer      = token_part + decoder.toUnicode(bytes + offset, (int)window);
+        offset += window;
+
+        int processed = tokenize_buffer(buffer, offset == size, keys, capitalized, stats);
+        token_part    = buffer.mid(processed);
+    }
+
+    if (contents.isNull())
+        file.unmap(data);
+
+    return true;
+}
+
+//! \internal Detects codec of a file by its byte order mark falling back to the codec for the current locale.
+/*static*/ QTextCodec* Text::detect_codec(const char *bytes, qint64 size)
+{
+    return QTextCodec::codecForUtfText(
+        QByteArray::fromRawData(bytes, (int)qMin(size, (qint64)4)),
+        QTextCodec::codecForLocale()
+    );
+}
+
+/**
+ * Appends contents of a string buffer to the text.
+ *
+ * \param[in] buffer Buffer to append to the text.
+ *
+ * \returns \c true on success and \c false if the buffer is a null/empty string.
+ */
+bool Text::append(const QString &buffer)
+{
+    if (buffer.isEmpty() || buffer.isNull())
+        return false;
+
+    _stats.bytes_read += buffer.size() * sizeof(QChar);
+    append_document(buffer);
+    return true;
+}
+
+/**
+ * Appends contents of a UTF-8 encoded buffer to the text.
+ *
+ * The buffer is tokenized as raw bytes and tokens are looked up by their UTF-8
+ * encoded keys, so strings are only built for wordforms new to the text.
+ *
+ * \param[in] buffer Buffer to append to the text, optionally starting with a byte order mark.
+ *
+ * \returns \c true on success and \c false if the buffer is empty.
+ */
+bool Text::appendUtf8(const QByteArray &buffer)
+{
+    if (buffer.isEmpty())
+        return false;
+
+    _stats.bytes_read += buffer.size();
+    append_utf8_document(buffer.constData(), buffer.size());
+    return true;
+}
+
+/**
+ * Appends a batch of UTF-8 encoded documents to the text.
+ *
+ * Documents are tokenized straight from the caller's buffers, so wrapping
+ * external memory with \c QByteArray::fromRawData avoids copying it at all.
+ * If more than one thread is allowed, documents are grouped into batches of
+ * about \c chunkSize bytes which are tokenized concurrently, while the calling
+ * thread adds their tokens to the indeces strictly in the order of \c documents.
+ * The resulting indeces are identical to the ones built by calling \c appendUtf8
+ * for each document in a loop.
+ *
+ * \param[in] documents   Documents to append, each optionally starting with a byte order mark.
+ *                        The buffers must stay valid until the method returns.
+ * \param[in] num_threads Maximum number of threads to use. 0 or negative value
+ *                        falls back to \c QThread::idealThreadCount().
+ *
+ * \returns \c true on success and \c false if all documents are empty.
+ *
+ * \note
+ * Each non-empty document starts a new document, empty documents are skipped.
+ *
+ * \sa appendUtf8
+ */
+bool Text::appendMany(const QVector<QByteArray> &documents, int num_threads /*= 1*/)
+{
+    return append_batches(documents.constData(), NULL, documents.size(), num_threads);
+}
+
+/**
+ * This is an overloaded function.
+ *
+ * Appends a batch of documents given as views into caller-owned strings to the text.
+ * Views are tokenized in place without copying the characters they refer to.
+ *
+ * \sa append
+ */
+bool Text::appendMany(const QVector<QStringRef> &documents, int num_threads /*= 1*/)
+{
+    return append_batches(NULL, documents.constData(), documents.size(), num_threads);
+}
+
+/**
+ * \internal Appends in-memory documents given either as UTF-8 buffers or as views into strings.
+ * \sa appendMany
+ */
+bool Text::append_batches(const QByteArray *utf8_documents, const QStringRef *documents, int size, int num_threads)
+{
+    if (num_threads < 1)
+        num_threads = QThread::idealThreadCount();
+
+    bool is_ok = false;
+    if (num_threads == 1) {
+        for (int i = 0; i < size; i++) {
+            if (utf8_documents != NULL) {
+                const QByteArray &document = utf8_documents[i];
+                if (document.isEmpty())
+                    continue;
+                _stats.bytes_read += document.size();
+                append_utf8_document(document.constData(), document.size());
+            } else {
+                const QStringRef &document = documents[i];
+                if (document.isEmpty())
+                    continue;
+                _stats.bytes_read += document.size() * sizeof(QChar);
+                append_document(QString::fromRawData(document.unicode(), document.size()));
+            }
+            is_ok = true;
+        }
+        return is_ok;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(num_threads);
+
+    QList< QPair<int, BatchTokenizer*> > in_flight;
+    int next = 0;
+    while (next < size || !in_flight.isEmpty()) {
+        while (next < size && in_flight.size() < 2 * num_threads) {
+            const int first = next;
+            qint64 batch_size = 0;
+            while (next < size && batch_size < _chunk_size) {
+                batch_size += utf8_documents != NULL?
+                    utf8_documents[next].size() : documents[next].size() * (qint64)sizeof(QChar);
+                next++;
+            }
+            BatchTokenizer *batch = new BatchTokenizer(
+                this,
+                utf8_documents != NULL? utf8_documents + first : NULL,
+                documents      != NULL? documents      + first : NULL,
+                next - first
+            );
+            in_flight.append(qMakePair(first, batch));
+            pool.start(batch);
+        }
+
+        QPair<int, BatchTokenizer*> batch = in_flight.takeFirst();
+        batch.second->wait();
+        _stats += batch.second->stats();
+
+        const QVector<int> &ends = batch.second->ends();
+        int start = 0;
+        for (int i = 0; i < ends.size(); i++) {
+            const int idx = batch.first + i;
+            if (utf8_documents != NULL? utf8_documents[idx].isEmpty() : documents[idx].isEmpty())
+                continue;
+            if (utf8_documents != NULL) {
+                _stats.bytes_read += utf8_documents[idx].size();
+                index_utf8_document(batch.second->utf8Keys(), batch.second->capitalized(), start, ends.at(i));
+            } else {
+                _stats.bytes_read += documents[idx].size() * sizeof(QChar);
+                index_document(batch.second->keys(), batch.second->capitalized(), start, ends.at(i));
+            }
+            start = ends.at(i);
+            is_ok = true;
+        }
+        delete batch.second;
+        report_status(false);
+        check_memory_budget();
+    }
+
+    return is_ok;
+}
+
+/**
+ * \internal Appends a decoded document to the text.
+ *
+ * If deduplication is enabled, the document is tokenized whole and checked
+ * before its tokens reach the indeces, otherwise it is indexed as it is tokenized.
+ */
+void Text::append_document(const QString &buffer)
+{
+    if (_duplicates == NULL) {
+        start_document();
+        process_buffer(buffer, true);
+        return;
+    }
+
+    QVector<QString> keys;
+    QVector<int>     capitalized;
+    tokenize_buffer(buffer, true, &keys, &capitalized, &_stats);
+    index_document(keys, capitalized);
+}
+
+/**
+ * \internal Appends a UTF-8 encoded document to the text.
+ * \sa append_document
+ */
+void Text::append_utf8_document(const char *bytes, qint64 size)
+{
+    if (_duplicates == NULL) {
+        start_document();
+        append_utf8(bytes, size);
+        return;
+    }
+
+    QVector<QByteArray> keys;
+    QVector<int>        capitalized;
+    tokenize_utf8_contents(bytes, size, &keys, &capitalized, &_stats);
+    index_utf8_document(keys, capitalized);
+}
+
+/**
+ * \internal Appends a file referenced by its name to the text as a single document.
+ *
+ * If deduplication is enabled, keys of the whole file are collected and checked
+ * before being indexed, otherwise the file is streamed as usual, gzip-compressed
+ * files being detected by their signature.
+ *
+ * \returns \c true on success and \c false if the file is not accessible or corrupt.
+ */
+bool Text::append_whole_file(const QString &fname)
+{
+    if (_duplicates == NULL) {
+        QFile file(fname);
+        if (!file.open(QIODevice::ReadOnly)) {
+            LOG_WARNING("Unable to access file");
+            return false;
+        }
+        start_document();
+        return append_opened_file(&file);
+    }
+
+    QVector<QString>    keys;
+    QVector<QByteArray> utf8_keys;
+    QVector<int>        capitalized;
+    if (!tokenize_file(fname, &keys, &utf8_keys, &capitalized, &_stats)) {
+        LOG_WARNING("Unable to access file");
+        return false;
+    }
+    if (utf8_keys.isEmpty())
+        index_document(keys, capitalized);
+    else
+        index_utf8_document(utf8_keys, capitalized);
+
+    LOG_INFO("File indexed");
+
+    return true;
+}
+
+/**
+ * \brief Saves the text indeces to a binary snapshot file.
+ *
+ * The snapshot stores the vocabulary, lexeme flags and the stream of lexeme IDs
+ * by position for the index of wordforms and the index of lexemes. All numbers are
+ * stored little-endian, and arrays are aligned to 4 bytes, so the snapshot can be
+ * read straight from a memory-mapped file. BNF for the current version of the format is:
+ *
+ * SNAPSHOT        := PROLOGUE DOCUMENTS INDEX_WF INDEX_LEX
+ * PROLOGUE        := PROLOGUE_MARKER VERSION LENGTH NUM_DOCUMENTS
+ * PROLOGUE_MARKER := 'Q' 'U' 'T' 'X'
+ * VERSION         := qint32
+ * LENGTH          := qint32
+ * NUM_DOCUMENTS   := qint32
+ * DOCUMENTS       := qint32{NUM_DOCUMENTS}
+ * INDEX           := NUM_LEXEMES NAMES_SIZE FLAGS PADDING NAME_OFFSETS NAMES PADDING IDS
+ * NUM_LEXEMES     := qint32
+ * NAMES_SIZE      := qint32
+ * FLAGS           := quint8{NUM_LEXEMES}
+ * NAME_OFFSETS    := qint32{NUM_LEXEMES + 1}
+ * NAMES           := UTF-8 encoded names, NAMES_SIZE bytes in total
+ * IDS             := qint32{LENGTH}
+ * PADDING         := 0x00{0..3}
+ *
+ * Lexeme IDs are assigned in order of the first occurrence in the text. Positions
+ * not covered by an index are stored as -1. FLAGS are the \c Lexeme::LexemeFeature
+ * bitmasks of lexemes, older snapshots store the boundary flag (bit 0) only. DOCUMENTS are offsets of documents as in \c DocumentTable.
+ *
+ * \param[in] fname File name to write to.
+ *
+ * \returns \c true on success and \c false if the file is not writable or the text is
+ * longer than 2^31 - 1 tokens.
+ *
+ * \sa load
+ */
+bool Text::save(const QString &fname) const
+{
+    if (length() > std::numeric_limits<qint32>::max()) {
+        LOG_WARNING("Text is too long for the snapshot format");
+        return false;
+    }
+
+    QFile out_file(fname);
+    if (!out_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        LOG_WARNING("Unable to open snapshot file for writing");
+        return false;
+    }
+
+    const int text_length = (int)length();
+
+    QDataStream out_stream(&out_file);
+    out_stream.setByteOrder(QDataStream::LittleEndian);
+    out_stream
+        << TEXT_SNAPSHOT_FORMAT_MARKER
+        << TEXT_SNAPSHOT_FORMAT_VERSION
+        << (qint32)text_length
+        << (qint32)_documents.size()
+    ;
+    for (qint64 i = 0; i < _documents.size(); i++)
+        out_stream << (qint32)_documents.offset(i);
+
+    save_index(&out_stream, idx_wf,  text_length);
+    save_index(&out_stream, idx_lex, text_length);
+
+    out_file.close();
+
+    if (out_stream.status() != QDataStream::Ok) {
+        LOG_WARNING("Unable to write snapshot file");
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Replaces the text indeces with the ones read from a binary snapshot file.
+ *
+ * The file is memory-mapped and lexeme positions are collected straight from the mapped
+ * streams of IDs. On failure, the text is left unchanged. Snapshots of version 1 have
+ * no table of documents and are loaded as a single document.
+ *
+ * \param[in] fname File name to read from.
+ *
+ * \returns \c true on success and \c false if the file is not accessible or not a valid snapshot.
+ *
+ * \sa save
+ */
+bool Text::load(const QString &fname)
+{
+    QFile in_file(fname);
+    if (!in_file.open(QIODevice::ReadOnly)) {
+        LOG_WARNING("Unable to open snapshot file for reading");
+        return false;
+    }
+
+    const qint64 size = in_file.size();
+    QByteArray contents;
+    const uchar *data = size > 0? in_file.map(0, size) : NULL;
+    if (data == NULL) {
+        contents = in_file.readAll();
+        data     = reinterpret_cast<const uchar*>(contents.constData());
+    }
+
+    SnapshotLayout layout;
+    bool is_ok = layout.parse(data, size);
+
+    DocumentTable documents;
+    for (qint32 i = 0; is_ok && i < layout.numDocuments(); i++) {
+        const qint32 doc_offset = layout.documentOffset(i);
+        const qint64 min_offset = i > 0? documents.offset(i - 1) : 0;
+        is_ok = doc_offset >= min_offset && doc_offset <= layout.length();
+        documents.append(doc_offset);
+    }
+    if (documents.size() == 0 && layout.length() > 0)
+        documents.append(0);
+
+    LexemeIndex *wordforms = new LexemeIndex();
+    LexemeIndex *lexemes   = new LexemeIndex();
+
+    is_ok = is_ok
+        && load_index(layout, 0, wordforms)
+        && load_index(layout, 1, lexemes);
+
+    if (contents.isNull() && data != NULL)
+        in_file.unmap(const_cast<uchar*>(data));
+
+    if (!is_ok) {
+        LOG_WARNING("Bad snapshot file format");
+        delete wordforms;
+        delete lexemes;
+        return false;
+    }
+
+    // Cached lexemes belong to the indeces being replaced:
+    _surface_forms.clear();
+    _utf8_keys.clear();
+    _lemmas.clear();
+
+    delete idx_wf;
+    delete idx_lex;
+    idx_wf     = wordforms;
+    idx_lex    = lexemes;
+    _documents = documents;
+    _boundaries.build(*idx_wf);
+
+    LOG_INFO() << "Snapshot loaded:" << layout.length() << "tokens";
+
+    return true;
+}
+
+/**
+ * \internal Writes an index to a snapshot.
+ *
+ * \param[out] out    Stream to write to, set to little-endian byte order.
+ * \param[in]  index  Index to write.
+ * \param[in]  length Length of the text.
+ *
+ * \sa save
+ */
+/*static*/ void Text::save_index(QDataStream *out, const LexemeIndex *index, int length)
+{
+    // Assign IDs in order of the first occurrence, then add lexemes without positions.
+    // Snapshot IDs are kept by IDs of lexemes in the index:
+    QVector<qint32>        ids(index->size(), -1);
+    QVector<const Lexeme*> vocabulary;
+    QVector<qint32>        stream(length, -1);
+    for (int pos = 0; pos < length; pos++) {
+        const quint32 id = index->idByPosition(pos);
+        if (id == INVALID_LEXEME_ID)
+            continue;
+        if (ids.at(id) < 0) {
+            ids[id] = vocabulary.size();
+            vocabulary.append(index->findById(id));
+        }
+        stream[pos] = ids.at(id);
+    }
+    for (int id = 0; id < index->size(); id++) {
+        if (ids.at(id) < 0) {
+            ids[id] = vocabulary.size();
+            vocabulary.append(index->findById(id));
+        }
+    }
+
+    QByteArray      names;
+    QVector<qint32> name_offsets;
+    QByteArray      flags(vocabulary.size(), 0);
+    for (int i = 0; i < vocabulary.size(); i++) {
+        name_offsets.append(names.size());
+        names.append(vocabulary.at(i)->name().toUtf8());
+        flags[i] = (char)vocabulary.at(i)->features();
+    }
+    name_offsets.append(names.size());
+
+    const char padding[4] = { 0, 0, 0, 0 };
+    *out << (qint32)vocabulary.size() << (qint32)names.size();
+    out->writeRawData(flags.constData(), flags.size());
+    out->writeRawData(padding, (4 - flags.size() % 4) % 4);
+    for (int i = 0; i < name_offsets.size(); i++)
+        *out << name_offsets.at(i);
+    out->writeRawData(names.constData(), names.size());
+    out->writeRawData(padding, (4 - names.size() % 4) % 4);
+    for (int i = 0; i < stream.size(); i++)
+        *out << stream.at(i);
+}
+
+/**
+ * \internal Reads an index from a snapshot.
+ *
+ * \param[in]  layout Parsed layout of the snapshot.
+ * \param[in]  which  0 for the index of wordforms and 1 for the index of lexemes.
+ * \param[out] index  Empty index to read into.
+ *
+ * \returns \c true on success and \c false if the index is malformed.
+ *
+ * \sa save
+ */
+/*static*/ bool Text::load_index(const SnapshotLayout &layout, int which, LexemeIndex *index)
+{
+    const SnapshotLayout::Index &section = layout.index(which);
+
+    // Collect positions of every lexeme in a single pass over the stream of IDs:
+    QVector< QVector<TextPosition> > positions(section.num_lexemes);
+    for (qint32 i = 0; i < layout.length(); i++) {
+        const qint32 id = layout.id(section, i);
+        if (id < -1 || id >= section.num_lexemes)
+            return false;
+        if (id >= 0)
+            positions[id].append(i);
+    }
+
+    QByteArray name;
+    for (qint32 id = 0; id < section.num_lexemes; id++) {
+        if (!layout.name(section, id, &name))
+            return false;
+        Lexeme *lexeme = index->addPositions(QString::fromUtf8(name), &positions.at(id));
+        lexeme->setFeatures(layout.features(section, id));
+    }
+
+    return true;
+}
+
+/**
+ * \brief Publishes an immutable snapshot of the text indeces.
+ *
+ * The snapshot is a copy of the indeces as they are at the moment of the call,
+ * so the text can keep appending while extraction runs on the snapshot. Snapshots
+ * are reference counted: Ones pinned by an \c Extractor stay valid after newer
+ * ones are published.
+ *
+ * The snapshot shares data with the previous one, so publishing copies only
+ * lexemes and positions added since the previous call, unless postings are
+ * compressed or switched to bitmaps. It is expected to be called by the thread
+ * that appends to the text.
+ *
+ * \returns The published snapshot.
+ *
+ * \sa snapshot
+ * \sa LexemeIndex::freeze
+ */
+QSharedPointer<const TextSnapshot> Text::publish()
+{
+    const QSharedPointer<const TextSnapshot> previous = snapshot();
+
+    TextSnapshot *created;
+    if (_compress_postings || _bitmap_threshold > 0) {
+        created = new TextSnapshot(*idx_wf, *idx_lex, _documents, _boundaries, _generation + 1,
+                                   _compress_postings, _bitmap_threshold);
+    } else {
+        created = new TextSnapshot(
+            idx_wf->freeze(previous.isNull()? NULL : previous->wordforms()),
+            idx_lex->freeze(previous.isNull()? NULL : previous->lexemes()),
+            _documents, _boundaries, _generation + 1
+        );
+    }
+    QSharedPointer<const TextSnapshot> published(created);
+
+    QMutexLocker locker(&_snapshot_lock);
+    _generation++;
+    _snapshot = published;
+
+    LOG_INFO() << "Snapshot" << _generation << "published:" << published->length() << "tokens";
+
+    return published;
+}
+
+/**
+ * \brief Returns the latest published snapshot of the text indeces.
+ *
+ * This method is safe to be called from any thread, including while another
+ * thread appends to the text or publishes a new snapshot.
+ *
+ * \returns The latest snapshot or a null pointer if nothing has been published yet.
+ *
+ * \sa publish
+ */
+QSharedPointer<const TextSnapshot> Text::snapshot() const
+{
+    QMutexLocker locker(&_snapshot_lock);
+    return _snapshot;
+}
+
+/**
+ * \internal Adds the lexeme of a wordform to the index of lexemes at the given position.
+ *
+ * Lexemes are memoized per wordform, so the lemmatizer is called once per distinct
+ * wordform. Boundaries and wordforms unknown to the lemmatizer are indexed as themselves.
+ *
+ * \param[in] wordform Wordform at the position.
+ * \param[in] pos      Position of the wordform.
+ *
+ * \returns Lexeme the wordform is indexed as.
+ */
+Lexeme* Text::normalize_token(Lexeme *wordform, TextPosition pos)
+{
+    Lexeme *lexeme = _lemmas.value(wordform, NULL);
+    if (lexeme != NULL) {
+        // Wordforms may gain features later on, e.g. when they occur capitalized
+        lexeme->addFeatures(wordform->features() & WORDFORM_LEXEME_FEATURES);
+        return idx_lex->addPosition(lexeme, pos);
+    }
+
+    QString lemma;
+    if (!wordform->isBoundary())
+        lemma = _lemmatizer->lemmatize(wordform->name());
+    if (lemma.isEmpty())
+        lemma = wordform->name();
+
+    bool is_new = false;
+    lexeme      = idx_lex->addPosition(lemma, pos, &is_new);
+    if (is_new == true) {
+        // Features of the key are the lemma's own, boundaries are indexed as themselves
+        lexeme->setFeatures(key_features(lemma) | (wordform->features() & Lexeme::FEATURE_BOUNDARY));
+        _stats.new_lexemes++;
+    }
+    lexeme->addFeatures(wordform->features() & WORDFORM_LEXEME_FEATURES);
+    _lemmas.insert(wordform, lexeme);
+
+    return lexeme;
+}
+
+/**
+ * \internal Completes indexing of the wordform just added at the last position.
+ *
+ * Updates the map of boundaries and, if a lemmatizer is set, the index of lexemes.
+ */
+void Text::complete_position(Lexeme *wordform)
+{
+    const TextPosition pos = _boundaries.size();
+    _boundaries.append(wordform->isBoundary());
+    if (_lemmatizer != NULL)
+        normalize_token(wordform, pos);
+}
+
+/**
+ * \internal Builds the key a token is indexed by.
+ *
+ * Tokens consisting of Latin-1 characters are lowercased by a vectorized routine,
+ * all others are lowercased according to the locale of the text.
+ */
+QString Text::token_key(const QStringRef &token) const
+{
+    if (_fold_latin1) {
+        QString key(token.length(), Qt::Uninitialized);
+        if (Tokenizer::toLowerLatin1(token.unicode(), token.length(), key.data()))
+            return key;
+    }
+    return _locale.toLower(token.toString());
+}
+
+/**
+ * \internal Builds the UTF-8 encoded key a token of a UTF-8 buffer is indexed by.
+ *
+ * ASCII tokens are lowercased byte by byte, all others are decoded and
+ * lowercased exactly like in \c token_key.
+ *
+ * \param[in]  token Token to build the key for.
+ * \param[out] key   Buffer to store the key to. Reusing the buffer saves allocations.
+ */
+void Text::utf8_token_key(const Tokenizer::Utf8Token &token, QByteArray *key) const
+{
+    if (_fold_latin1) {
+        key->resize(token.size);
+        if (Tokenizer::toLowerAscii(token.data, token.size, key->data()))
+            return;
+    }
+    const QString decoded = QString::fromUtf8(token.data, token.size);
+    *key = token_key(decoded.midRef(0)).toUtf8();
+}
+
+/**
+ * Adds a token to the text indeces.
+ *
+ * All whitespace tokens are ignored. If the token is lemmatized to a new lexeme
+ * it is inserted into the index of lexemes. Tokens found in the surface form cache
+ * are indexed without building their keys.
+ *
+ * \param[in] token Token to process.
+ *
+ * \returns \c true if a token consists of whitespace characters only and \c false otherwise.
+ */
+bool Text::process_token(const Tokenizer::Token &token)
+{
+    if (token.type == Tokenizer::TOKEN_WHITESPACE)
+        return false;
+
+    Lexeme *lexeme = _surface_forms.find(token.text);
+    if (lexeme != NULL) {
+        idx_wf->addPosition(lexeme, idx_wf->numUniquePositions());
+        complete_position(lexeme);
+        return true;
+    }
+
+    bool is_new = false;
+    lexeme      = index_key(token_key(token.text), &is_new);
+    if (is_new == true) {
+        lexeme->setIsBoundary(token.type == Tokenizer::TOKEN_BOUNDARY);
+    }
+    // Surface forms are cached, so capitalization is checked once per distinct surface form
+    if (is_capitalized(token.text))
+        lexeme->addFeatures(Lexeme::FEATURE_CAPITALIZED);
+    complete_position(lexeme);
+    _surface_forms.insert(token.text, lexeme);
+
+    return true;
+}
+
+/**
+ * \internal Adds a token of a UTF-8 buffer to the text indeces.
+ *
+ * \param[in]     token Token to process.
+ * \param[in,out] key   Buffer for building the key of the token.
+ *
+ * \returns \c true if a token consists of whitespace characters only and \c false otherwise.
+ *
+ * \sa process_token
+ */
+bool Text::process_utf8_token(const Tokenizer::Utf8Token &token, QByteArray *key)
+{
+    if (token.type == Tokenizer::TOKEN_WHITESPACE)
+        return false;
+
+    utf8_token_key(token, key);
+
+    bool is_new    = false;
+    Lexeme *lexeme = index_utf8_key(*key, &is_new);
+    if (is_new == true) {
+        lexeme->setIsBoundary(token.type == Tokenizer::TOKEN_BOUNDARY);
+    }
+    if (is_capitalized(token))
+        lexeme->addFeatures(Lexeme::FEATURE_CAPITALIZED);
+    complete_position(lexeme);
+
+    return true;
+}
+
+/**
+ * \internal Adds a token key to the text indeces at the next position.
+ *
+ * \param[in]  key    Key of a non-whitespace token.
+ * \param[out] is_new Set to \c true if the key is added to the index of wordforms for the first time.
+ *
+ * \returns Wordform lexeme the key is indexed as.
+ */
+Lexeme* Text::index_key(const QString &key, bool *is_new)
+{
+    TextPosition pos = idx_wf->numUniquePositions();
+    Lexeme *lexeme   = idx_wf->addPosition(key, pos, is_new);
+    if (*is_new == true) {
+        lexeme->setFeatures(key_features(key));
+        _stats.new_wordforms++;
+    }
+    return lexeme;
+}
+
+/**
+ * \internal Adds a UTF-8 encoded token key to the text indeces at the next position.
+ *
+ * Keys are interned in a table of their own, so a string is only built
+ * the first time a key is seen.
+ *
+ * \param[in]  key    UTF-8 encoded key of a non-whitespace token.
+ * \param[out] is_new Set to \c true if the key is added to the index of wordforms for the first time.
+ *
+ * \returns Wordform lexeme the key is indexed as.
+ */
+Lexeme* Text::index_utf8_key(const QByteArray &key, bool *is_new)
+{
+    Lexeme *lexeme = _utf8_keys.value(key, NULL);
+    if (lexeme != NULL) {
+        *is_new = false;
+        return idx_wf->addPosition(lexeme, idx_wf->numUniquePositions());
+    }
+
+    lexeme = index_key(QString::fromUtf8(key), is_new);
+    // Deep copy, so the caller's key buffer stays unshared:
+    _utf8_keys.insert(QByteArray(key.constData(), key.size()), lexeme);
+    return lexeme;
+}
+
+/**
+ * \internal Adds token keys to the text indeces in the given order.
+ *
+ * Boundary detection for new lexemes is done on keys: Lowercasing never turns
+ * punctuation into letters or vice versa.
+ *
+ * \param[in] keys        Keys of non-whitespace tokens.
+ * \param[in] capitalized Sorted offsets of keys of capitalized tokens in \c keys.
+ * \param[in] from        Offset of the first key to add.
+ * \param[in] to          Offset past the last key to add, negative value stands for the end of \c keys.
+ */
+void Text::index_keys(const QVector<QString> &keys, const QVector<int> &capitalized, int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<int>::const_iterator next_capitalized = std::lower_bound(capitalized.constBegin(), capitalized.constEnd(), from);
+    for (int i = from; i < to; i++) {
+        bool is_new    = false;
+        Lexeme *lexeme = index_key(keys.at(i), &is_new);
+        if (is_new == true) {
+            lexeme->setIsBoundary(Tokenizer::isBoundary(keys.at(i).midRef(0)));
+        }
+        if (next_capitalized != capitalized.constEnd() && *next_capitalized == i) {
+            lexeme->addFeatures(Lexeme::FEATURE_CAPITALIZED);
+            ++next_capitalized;
+        }
+        complete_position(lexeme);
+    }
+    _stats.index_nsecs += timer.nsecsElapsed();
+}
+
+/**
+ * \internal Adds UTF-8 encoded token keys to the text indeces in the given order.
+ * \sa index_keys
+ */
+void Text::index_utf8_keys(const QVector<QByteArray> &keys, const QVector<int> &capitalized,
+                           int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<int>::const_iterator next_capitalized = std::lower_bound(capitalized.constBegin(), capitalized.constEnd(), from);
+    for (int i = from; i < to; i++) {
+        bool is_new    = false;
+        Lexeme *lexeme = index_utf8_key(keys.at(i), &is_new);
+        if (is_new == true) {
+            lexeme->setIsBoundary(Tokenizer::isBoundary(lexeme->name().midRef(0)));
+        }
+        if (next_capitalized != capitalized.constEnd() && *next_capitalized == i) {
+            lexeme->addFeatures(Lexeme::FEATURE_CAPITALIZED);
+            ++next_capitalized;
+        }
+        complete_position(lexeme);
+    }
+    _stats.index_nsecs += timer.nsecsElapsed();
+}
+
+/**
+ * \internal Starts a new document and adds its keys to the text indeces unless
+ * the document is a near-duplicate of one of the documents appended before.
+ *
+ * \returns \c true if the document is indexed and \c false if it is dropped.
+ *
+ * \sa index_keys
+ * \sa setDuplicateDetector
+ */
+bool Text::index_document(const QVector<QString> &keys, const QVector<int> &capitalized,
+                          int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    if (_duplicates != NULL && _duplicates->isDuplicate(keys, from, to)) {
+        _stats.duplicate_documents++;
+        _stats.duplicate_tokens += to - from;
+        return false;
+    }
+
+    start_document();
+    index_keys(keys, capitalized, from, to);
+    return true;
+}
+
+/**
+ * \internal Starts a new document made of UTF-8 encoded keys unless it is a near-duplicate.
+ * \sa index_document
+ */
+bool Text::index_utf8_document(const QVector<QByteArray> &keys, const QVector<int> &capitalized,
+                               int from /*= 0*/, int to /*= -1*/)
+{
+    if (to < 0)
+        to = keys.size();
+
+    if (_duplicates != NULL && _duplicates->isDuplicate(keys, from, to)) {
+        _stats.duplicate_documents++;
+        _stats.duplicate_tokens += to - from;
+        return false;
+    }
+
+    start_document();
+    index_utf8_keys(keys, capitalized, from, to);
+    return true;
+}
+
+/**
+ * \internal Computes features of a new wordform which depend on its key only.
+ *
+ * The boundary flag is set by callers, which know the type of the token.
+ */
+quint8 Text::key_features(const QString &key) const
+{
+    quint8 features = 0;
+    if (key.size() <= MAX_SHORT_LEXEME_LENGTH)
+        features |= Lexeme::FEATURE_SHORT;
+
+    int  num_digits = 0;
+    bool is_numeric = true;
+    const QChar *chars = key.unicode();
+    for (int i = 0; i < key.size(); i++) {
+        const QChar c = chars[i];
+        if (c.isDigit())
+            num_digits++;
+        else if (c != QLatin1Char('.') && c != QLatin1Char(','))
+            is_numeric = false;
+        if (Tokenizer::isBoundaryChar(c))
+            features |= Lexeme::FEATURE_PUNCTUATION;
+    }
+    if (is_numeric && num_digits > 0)
+        features |= Lexeme::FEATURE_NUMERIC;
+
+    if (_stopwords.contains(key))
+        features |= Lexeme::FEATURE_STOPWORD;
+
+    return features;
+}
+
+//! \internal Returns \c true if a token starts with an uppercase letter.
+/*static*/ bool Text::is_capitalized(const QStringRef &token)
+{
+    return !token.isEmpty() && token.at(0).isUpper();
+}
+
+//! \internal Returns \c true if a token of a UTF-8 buffer starts with an uppercase letter.
+/*static*/ bool Text::is_capitalized(const Tokenizer::Utf8Token &token)
+{
+    if (token.size == 0)
+        return false;
+    const uchar c = (uchar)token.data[0];
+    if (c < 0x80)
+        return c >= 'A' && c <= 'Z';
+    const QString head = QString::fromUtf8(token.data, qMin(token.size, 4));
+    return head.at(0).isUpper();
+}
+
+/**
+ * Sets the stopwords of the text.
+ *
+ * Wordforms equal to a stopword get the \c Lexeme::FEATURE_STOPWORD flag, and so do
+ * lexemes any of their wordforms are a stopword. Setting stopwords before appending
+ * input is the cheapest, as then the flag is computed once per new wordform, but
+ * lexemes indexed so far are updated as well.
+ *
+ * \param[in] stopwords Stopwords, matched case-insensitively.
+ *
+ * \sa stopwords
+ */
+void Text::setStopwords(const QStringList &stopwords)
+{
+    _stopwords.clear();
+    for (int i = 0; i < stopwords.size(); i++) {
+        _stopwords.insert(token_key(stopwords.at(i).midRef(0)));
+    }
+
+    LexemeIndex *indeces[] = { idx_wf, idx_lex };
+    for (int i = 0; i < 2; i++) {
+        QHash<QString, Lexeme*>::const_iterator it;
+        for (it = indeces[i]->lexemes()->constBegin(); it != indeces[i]->lexemes()->constEnd(); ++it) {
+            Lexeme *lexeme = it.value();
+            lexeme->setFeatures(lexeme->features() & ~Lexeme::FEATURE_STOPWORD);
+            if (_stopwords.contains(it.key()))
+                lexeme->addFeatures(Lexeme::FEATURE_STOPWORD);
+        }
+    }
+
+    QHash<const Lexeme*, Lexeme*>::const_iterator it_l;
+    for (it_l = _lemmas.constBegin(); it_l != _lemmas.constEnd(); ++it_l) {
+        it_l.value()->addFeatures(it_l.key()->features() & Lexeme::FEATURE_STOPWORD);
+    }
+}
+
+//! \internal Starts a new document at the next position.
+void Text::start_document()
+{
+    _documents.append(idx_wf->numUniquePositions());
+}
+
+/**
+ * \internal Emits \c appendStatusUpdate if enough input has been read since the last update.
+ * \param[in] is_forced Whether to emit the signal in any case.
+ */
+void Text::report_status(bool is_forced)
+{
+    if (!is_forced && _stats.bytes_read - _reported_bytes < DEFAULT_STATUS_UPDATE_SIZE)
+        return;
+    _reported_bytes = _stats.bytes_read;
+    emit appendStatusUpdate(_stats.bytes_read, _boundaries.size());
+}
+
+/**
+ * \internal Lets the segment writer flush the text if its memory usage exceeds the budget.
+ *
+ * Memory usage is only computed every \c DEFAULT_BUDGET_CHECK_SIZE tokens or every
+ * as many tokens as there are wordforms, whichever is more, since computing it walks
+ * the vocabulary.
+ * The current document is not closed, tokens appended after the flush continue it
+ * in the next segment.
+ */
+void Text::check_memory_budget()
+{
+    if (_segment_writer == NULL || _boundaries.size() < _budget_check_pos)
+        return;
+
+    const qint64 usage = memoryUsage();
+    if (usage >= _segment_writer->memoryBudget()) {
+        LOG_INFO() << "Memory usage of" << usage << "bytes exceeds the budget, flushing" << _boundaries.size() << "tokens";
+        if (!_segment_writer->flush())
+            LOG_WARNING() << "Unable to flush the text, keeping it in memory";
+    }
+    _budget_check_pos = _boundaries.size() + qMax(DEFAULT_BUDGET_CHECK_SIZE, (qint64)idx_wf->lexemes()->size());
+}
+
+//! \internal Initializes class members.
+void Text::_initialize(const QLocale &locale)
+{
+    _locale      = locale;
+    _use_mmap    = false;
+    _use_utf8    = false;
+    _compress_postings = false;
+    _bitmap_threshold  = 0;
+    _fold_latin1 = locale.language() != QLocale::Turkish
+        && locale.language() != QLocale::Azerbaijani
+        && locale.language() != QLocale::Lithuanian;
+    _num_threads = 1;
+    _chunk_size  = DEFAULT_CHUNK_SIZE;
+    _generation  = 0;
+    _lemmatizer  = NULL;
+    _duplicates  = NULL;
+    _reported_bytes = 0;
+    _segment_writer = NULL;
+    _budget_check_pos = DEFAULT_BUDGET_CHECK_SIZE;
+    idx_wf       = new LexemeIndex();
+    idx_lex      = new LexemeIndex();
 }
@@ -0,0 +1,93 @@
+#include <qubiq/text_snapshot.h>
+
+/**
+ * \class TextSnapshot
+ *
+ * \brief The TextSnapshot class is an immutable copy of the indeces of a text.
+ *
+ * Snapshots are published by \c Text and shared by reference counting, so an
+ * \c Extractor can pin a snapshot for as long as it needs it, while the text
+ * keeps appending to its own indeces. A snapshot never changes after it is
+ * constructed and is therefore safe to be read from any number of threads.
+ *
+ * Snapshots made of frozen copies of the indeces share unchanged pages of data
+ * with the snapshot published before them, and so do their tables of documents
+ * and maps of boundaries.
+ *
+ * \sa Text::publish
+ */
+
+/**
+ * \brief Constructs a snapshot by copying the given indeces.
+ * \param[in] wordforms  Index of wordforms to copy.
+ * \param[in] lexemes    Index of lexemes to copy.
+ * \param[in] documents  Table of documents to copy.
+ * \param[in] boundaries Map of boundary tokens to copy.
+ * \param[in] generation Number of the snapshot.
+ * \param[in] compress_postings Whether to compress positions of frequent lexemes of the copies.
+ * \param[in] bitmap_threshold  Number of positions lexemes of the copies are switched to bitmaps at, 0 to disable bitmaps.
+ *
+ * \sa LexemeIndex::compress
+ * \sa LexemeIndex::setBitmapThreshold
+ */
+TextSnapshot::TextSnapshot(const LexemeIndex &wordforms, const LexemeIndex &lexemes, const DocumentTable &documents,
+                           const BoundaryMap &boundaries, quint64 generation, bool compress_postings /*= false*/,
+                           int bitmap_threshold /*= 0*/)
+{
+    _generation = generation;
+    _documents  = documents;
+    _boundaries = boundaries;
+    _wordforms  = new LexemeIndex();
+    _lexemes    = new LexemeIndex();
+    _wordforms->setBitmapThreshold(bitmap_threshold);
+    _lexemes->setBitmapThreshold(bitmap_threshold);
+
+    copy_index(wordforms, _wordforms);
+    copy_index(lexemes,   _lexemes);
+
+    if (compress_postings) {
+        _wordforms->compress();
+        _lexemes->compress();
+    }
+}
+
+/**
+ * \brief Constructs a snapshot of frozen copies of indeces.
+ * \param[in] wordforms  Frozen index of wordforms, owned by the snapshot.
+ * \param[in] lexemes    Frozen index of lexemes, owned by the snapshot.
+ * \param[in] documents  Table of documents to copy.
+ * \param[in] boundaries Map of boundary tokens to copy.
+ * \param[in] generation Number of the snapshot.
+ *
+ * \sa LexemeIndex::freeze
+ */
+TextSnapshot::TextSnapshot(LexemeIndex *wordforms, LexemeIndex *lexemes, const DocumentTable &documents,
+                           const BoundaryMap &boundaries, quint64 generation)
+{
+    _generation = generation;
+    _documents  = documents;
+    _boundaries = boundaries;
+    _wordforms  = wordforms;
+    _lexemes    = lexemes;
+}
+
+//! Destructs the snapshot.
+TextSnapshot::~TextSnapshot()
+{
+    delete _wordforms;
+    delete _lexemes;
+}
+
+/**
+ * \internal Copies all lexemes of an index together with their positions and flags.
+ *
+ * Unlike \c LexemeIndex::merge, lexemes are copied as a whole, so properties
+ * like the boundary flag are preserved.
+ */
+/*static*/ void TextSnapshot::copy_index(const LexemeIndex &source, LexemeIndex *target)
+{
+    // Copying in the order of IDs keeps IDs of lexemes in the copy
+    for (int id = 0; id < source.size(); id++) {
+        target->copyFromIndex(source, source.findById(id)->name());
+    }
+}
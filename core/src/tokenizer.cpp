@@ -0,0 +1,698 @@
+#include <qubiq/tokenizer.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * \class Tokenizer
+ *
+ * \brief The Tokenizer class splits text buffers into word tokens and classifies them.
+ *
+ * Tokenization follows the word boundary rules of Unicode Standard Annex #29 (the
+ * same rules \c QTextBoundaryFinder implements) for Latin, Greek and Cyrillic scripts,
+ * which are driven by a table of character classes built on construction:
+ *
+ * - Runs of whitespace characters form whitespace tokens.
+ * - Runs of letters, digits and connectors form words. Letters separated by a single
+ *   "mid-letter" character (like in "isn't" or "e.g") and digits separated by a single
+ *   "mid-number" character (like in "3.14" or "1,000") are kept together.
+ * - Any other character forms a token on its own.
+ *
+ * Tokens are classified while they are scanned, so no second pass over the token
+ * is needed to tell whitespace and boundary tokens from the others.
+ *
+ * Characters not covered by the table (other scripts, combining marks, format
+ * characters) make the whole whitespace-delimited span they belong to fall back
+ * to \c QTextBoundaryFinder.
+ *
+ * UTF-8 buffers can be tokenized directly with \c tokenizeUtf8, which follows
+ * the same rules and produces slices of the original bytes.
+ *
+ * Runs of ASCII letters and digits, which make up most of the words in typical
+ * corpora, are scanned 16 characters per step with SSE2 instructions when they
+ * are available.
+ *
+ * Tokenizer is immutable after construction, so a single instance can be shared
+ * between threads.
+ *
+ * \sa Text
+ */
+
+//! Constructs a Tokenizer object.
+Tokenizer::Tokenizer()
+{
+    _initialize_classes();
+}
+
+/**
+ * \brief Splits a buffer into tokens.
+ *
+ * Unless \c is_final is \c true, the buffer is assumed to be cut from a longer input,
+ * so the last whitespace-delimited span of the buffer is not tokenized: It may
+ * continue in the next buffer.
+ *
+ * \param[in]  buffer   Buffer to split.
+ * \param[in]  is_final Whether the buffer is the last one in the input.
+ * \param[out] tokens   Vector to append tokens to.
+ *
+ * \returns Offset of the first character not covered by produced tokens.
+ */
+int Tokenizer::tokenize(const QString &buffer, bool is_final, QVector<Token> *tokens) const
+{
+    const QChar *chars = buffer.unicode();
+    const int    len   = buffer.length();
+
+    int pos = 0;
+    while (pos < len) {
+        const int span_start = pos;
+        const int num_tokens = tokens->size();
+
+        if (char_class(chars[pos]) == CC_SPACE) {
+            while (pos < len && char_class(chars[pos]) == CC_SPACE)
+                pos++;
+            if (pos == len && !is_final)
+                return span_start;
+            tokens->append(Token(buffer.midRef(span_start, pos - span_start), TOKEN_WHITESPACE));
+            continue;
+        }
+
+        bool is_fallback = false;
+        while (pos < len) {
+            const quint8 cc = char_class(chars[pos]);
+            if (cc == CC_SPACE)
+                break;
+            if (cc == CC_FALLBACK) {
+                is_fallback = true;
+                break;
+            }
+
+            bool is_boundary = (_classes[chars[pos].unicode()] & FLAG_BOUNDARY) != 0;
+            int  end         = is_word_class(cc)? scan_word(chars, len, pos, &is_boundary) : pos + 1;
+            tokens->append(Token(
+                buffer.midRef(pos, end - pos),
+                is_boundary? TOKEN_BOUNDARY : TOKEN_WORD
+            ));
+            pos = end;
+        }
+
+        if (is_fallback) {
+            while (pos < len && char_class(chars[pos]) != CC_SPACE)
+                pos++;
+        }
+
+        if (pos == len && !is_final) {
+            tokens->resize(num_tokens);
+            return span_start;
+        }
+
+        if (is_fallback) {
+            tokens->resize(num_tokens);
+            split_fallback(buffer, span_start, pos, tokens);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * \brief Splits a UTF-8 buffer into tokens.
+ *
+ * The buffer is split exactly like its decoded counterpart would be split by
+ * \c tokenize, but tokens are produced as slices of the original bytes. Invalid
+ * byte sequences are treated as U+FFFD replacement characters.
+ *
+ * Unless \c is_final is \c true, the buffer is assumed to be cut from a longer input,
+ * so the last whitespace-delimited span of the buffer (including a multibyte
+ * sequence cut at the end of the buffer) is not tokenized.
+ *
+ * \param[in]  bytes    Buffer to split.
+ * \param[in]  len      Length of the buffer in bytes.
+ * \param[in]  is_final Whether the buffer is the last one in the input.
+ * \param[out] tokens   Vector to append tokens to.
+ *
+ * \returns Offset of the first byte not covered by produced tokens.
+ */
+int Tokenizer::tokenizeUtf8(const char *bytes, int len, bool is_final, QVector<Utf8Token> *tokens) const
+{
+    int pos  = 0;
+    int size = 0;
+    while (pos < len) {
+        const int span_start = pos;
+        const int num_tokens = tokens->size();
+
+        if ((utf8_char_class(bytes, len, pos, &size) & CC_MASK) == CC_SPACE) {
+            while (pos < len && (utf8_char_class(bytes, len, pos, &size) & CC_MASK) == CC_SPACE)
+                pos += size;
+            if (pos == len && !is_final)
+                return span_start;
+            tokens->append(Utf8Token(bytes + span_start, pos - span_start, TOKEN_WHITESPACE));
+            continue;
+        }
+
+        bool is_fallback = false;
+        while (pos < len) {
+            const quint8 bits = utf8_char_class(bytes, len, pos, &size);
+            const quint8 cc   = bits & CC_MASK;
+            if (cc == CC_SPACE)
+                break;
+            if (cc == CC_FALLBACK) {
+                is_fallback = true;
+                break;
+            }
+
+            bool is_boundary = (bits & FLAG_BOUNDARY) != 0;
+            int  end         = is_word_class(cc)? scan_word_utf8(bytes, len, pos, &is_boundary) : pos + size;
+            tokens->append(Utf8Token(
+                bytes + pos, end - pos,
+                is_boundary? TOKEN_BOUNDARY : TOKEN_WORD
+            ));
+            pos = end;
+        }
+
+        if (is_fallback) {
+            while (pos < len && (utf8_char_class(bytes, len, pos, &size) & CC_MASK) != CC_SPACE)
+                pos += size;
+        }
+
+        if (pos == len && !is_final) {
+            tokens->resize(num_tokens);
+            return span_start;
+        }
+
+        if (is_fallback) {
+            tokens->resize(num_tokens);
+            split_fallback_utf8(bytes, span_start, pos, tokens);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * \brief Classifies a token.
+ * \param[in] token Token to be classified.
+ * \returns Class of the token.
+ */
+/*static*/ Tokenizer::TokenType Tokenizer::classify(const QStringRef &token)
+{
+    if (isWhitespace(token))
+        return TOKEN_WHITESPACE;
+    if (isBoundary(token))
+        return TOKEN_BOUNDARY;
+    return TOKEN_WORD;
+}
+
+/**
+ * Detects whether a token consists of whitespace characters only.
+ *
+ * \param[in] token Token to be checked.
+ *
+ * \returns \c true if a token consists of whitespace characters only and \c false otherwise.
+ */
+/*static*/ bool Tokenizer::isWhitespace(const QStringRef &token)
+{
+    const QChar *chars = token.unicode();
+    for (int i = 0; i < token.length(); i++) {
+        if (!chars[i].isSpace())
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Detects whether a token is a boundary token.
+ *
+ * \param[in] token Token to be checked.
+ *
+ * \returns \c true if a token is a boundary token and \c false otherwise.
+ *
+ * \sa isBoundaryChar
+ */
+/*static*/ bool Tokenizer::isBoundary(const QStringRef &token)
+{
+    const QChar *chars = token.unicode();
+    for (int i = 0; i < token.length(); i++) {
+        if (!isBoundaryChar(chars[i]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Lowercases a string consisting of Latin-1 characters.
+ *
+ * Only simple case mappings of the Basic Latin and Latin-1 Supplement blocks are applied,
+ * which makes the result equal to what \c QLocale::toLower returns for the string in all
+ * locales but the ones with special casing rules for Latin letters (Turkish, Azerbaijani
+ * and Lithuanian). With SSE2 available, 16 characters are processed per step.
+ *
+ * \param[in]  src Characters to lowercase.
+ * \param[in]  len Number of characters.
+ * \param[out] dst Buffer of at least \c len characters to write lowercased characters to.
+ *
+ * \returns \c true on success and \c false if \c src contains a character outside Latin-1.
+ * In the latter case \c dst is left partially filled.
+ */
+/*static*/ bool Tokenizer::toLowerLatin1(const QChar *src, int len, QChar *dst)
+{
+    const ushort *in  = reinterpret_cast<const ushort*>(src);
+    ushort       *out = reinterpret_cast<ushort*>(dst);
+
+    int i = 0;
+#ifdef __SSE2__
+    // Characters above 0x7FFF are negative in signed 16-bit comparisons
+    const __m128i zero      = _mm_setzero_si128();
+    const __m128i latin1_hi = _mm_set1_epi16(0xFF);
+    const __m128i ascii_lo  = _mm_set1_epi16('A' - 1);
+    const __m128i ascii_hi  = _mm_set1_epi16('Z' + 1);
+    const __m128i latin_lo  = _mm_set1_epi16(0xBF);
+    const __m128i latin_hi  = _mm_set1_epi16(0xDF);
+    const __m128i times     = _mm_set1_epi16(0xD7);
+    const __m128i case_bit  = _mm_set1_epi16(0x20);
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v[2] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8))
+        };
+        __m128i non_latin1 = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi16(v[0], latin1_hi), _mm_cmplt_epi16(v[0], zero)),
+            _mm_or_si128(_mm_cmpgt_epi16(v[1], latin1_hi), _mm_cmplt_epi16(v[1], zero))
+        );
+        if (_mm_movemask_epi8(non_latin1) != 0)
+            return false;
+        for (int half = 0; half < 2; half++) {
+            __m128i is_upper = _mm_or_si128(
+                _mm_and_si128(_mm_cmpgt_epi16(v[half], ascii_lo), _mm_cmplt_epi16(v[half], ascii_hi)),
+                _mm_andnot_si128(
+                    _mm_cmpeq_epi16(v[half], times),
+                    _mm_and_si128(_mm_cmpgt_epi16(v[half], latin_lo), _mm_cmplt_epi16(v[half], latin_hi))
+                )
+            );
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(out + i + 8 * half),
+                _mm_add_epi16(v[half], _mm_and_si128(is_upper, case_bit))
+            );
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        const ushort c = in[i];
+        if (c > 0xFF)
+            return false;
+        bool is_upper = (c >= 'A' && c <= 'Z') || (c >= 0xC0 && c <= 0xDE && c != 0xD7);
+        out[i] = is_upper? c + 0x20 : c;
+    }
+    return true;
+}
+
+/**
+ * \brief Lowercases a string of ASCII characters.
+ *
+ * With SSE2 available, 32 bytes are processed per step.
+ *
+ * \param[in]  src Bytes to lowercase.
+ * \param[in]  len Number of bytes.
+ * \param[out] dst Buffer of at least \c len bytes to write lowercased bytes to.
+ *
+ * \returns \c true on success and \c false if \c src contains a non-ASCII byte.
+ * In the latter case \c dst is left partially filled.
+ */
+/*static*/ bool Tokenizer::toLowerAscii(const char *src, int len, char *dst)
+{
+    int i = 0;
+#ifdef __SSE2__
+    // Non-ASCII bytes are negative in signed 8-bit comparisons
+    const __m128i upper_lo = _mm_set1_epi8('A' - 1);
+    const __m128i upper_hi = _mm_set1_epi8('Z' + 1);
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    for (; i + 32 <= len; i += 32) {
+        const __m128i v[2] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16))
+        };
+        if (_mm_movemask_epi8(_mm_or_si128(v[0], v[1])) != 0)
+            return false;
+        for (int half = 0; half < 2; half++) {
+            __m128i is_upper = _mm_and_si128(_mm_cmpgt_epi8(v[half], upper_lo), _mm_cmplt_epi8(v[half], upper_hi));
+            _mm_storeu_si128(
+                reinterpret_cast<__m128i*>(dst + i + 16 * half),
+                _mm_add_epi8(v[half], _mm_and_si128(is_upper, case_bit))
+            );
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        const uchar c = (uchar)src[i];
+        if (c >= 0x80)
+            return false;
+        dst[i] = (c >= 'A' && c <= 'Z')? c + 0x20 : c;
+    }
+    return true;
+}
+
+/**
+ * \internal Counts ASCII letters and digits at the beginning of a string.
+ *
+ * \param[in] chars Characters to scan.
+ * \param[in] len   Number of characters.
+ *
+ * \returns Number of leading characters in ranges [0-9A-Za-z].
+ */
+/*static*/ int Tokenizer::ascii_alnum_run(const QChar *chars, int len)
+{
+    const ushort *in = reinterpret_cast<const ushort*>(chars);
+
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i case_bit  = _mm_set1_epi16(0x20);
+    const __m128i letter_lo = _mm_set1_epi16('a' - 1);
+    const __m128i letter_hi = _mm_set1_epi16('z' + 1);
+    const __m128i digit_lo  = _mm_set1_epi16('0' - 1);
+    const __m128i digit_hi  = _mm_set1_epi16('9' + 1);
+    for (; i + 16 <= len; i += 16) {
+        quint32 mask = 0;
+        for (int half = 0; half < 2; half++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8 * half));
+            __m128i l = _mm_or_si128(v, case_bit);
+            __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi16(l, letter_lo), _mm_cmplt_epi16(l, letter_hi));
+            __m128i is_digit  = _mm_and_si128(_mm_cmpgt_epi16(v, digit_lo),  _mm_cmplt_epi16(v, digit_hi));
+            mask |= (quint32)_mm_movemask_epi8(_mm_or_si128(is_letter, is_digit)) << (16 * half);
+        }
+        if (mask != 0xFFFFFFFFu) {
+            // Two mask bits per character: find the first character with cleared bits
+            while (mask & 1) {
+                mask >>= 2;
+                i++;
+            }
+            return i;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        const ushort c = in[i] | 0x20;
+        if (!(c >= 'a' && c <= 'z') && !(in[i] >= '0' && in[i] <= '9'))
+            return i;
+    }
+    return len;
+}
+
+/**
+ * \internal This is an overloaded function. Counts ASCII letters and digits at the beginning
+ * of a byte string, 32 bytes per step with SSE2 available.
+ */
+/*static*/ int Tokenizer::ascii_alnum_run(const char *bytes, int len)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i case_bit  = _mm_set1_epi8(0x20);
+    const __m128i letter_lo = _mm_set1_epi8('a' - 1);
+    const __m128i letter_hi = _mm_set1_epi8('z' + 1);
+    const __m128i digit_lo  = _mm_set1_epi8('0' - 1);
+    const __m128i digit_hi  = _mm_set1_epi8('9' + 1);
+    for (; i + 32 <= len; i += 32) {
+        quint32 mask = 0;
+        for (int half = 0; half < 2; half++) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i + 16 * half));
+            __m128i l = _mm_or_si128(v, case_bit);
+            __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(l, letter_lo), _mm_cmplt_epi8(l, letter_hi));
+            __m128i is_digit  = _mm_and_si128(_mm_cmpgt_epi8(v, digit_lo),  _mm_cmplt_epi8(v, digit_hi));
+            mask |= (quint32)_mm_movemask_epi8(_mm_or_si128(is_letter, is_digit)) << (16 * half);
+        }
+        if (mask != 0xFFFFFFFFu) {
+            while (mask & 1) {
+                mask >>= 1;
+                i++;
+            }
+            return i;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        const uchar c = (uchar)bytes[i];
+        if (!((c | 0x20) >= 'a' && (c | 0x20) <= 'z') && !(c >= '0' && c <= '9'))
+            return i;
+    }
+    return len;
+}
+
+/**
+ * \internal Decodes a UTF-8 sequence.
+ *
+ * \param[in]  bytes Bytes of the buffer.
+ * \param[in]  len   Length of the buffer in bytes.
+ * \param[in]  pos   Offset of the first byte of the sequence.
+ * \param[out] size  Number of bytes the sequence occupies, 1 for invalid sequences.
+ *
+ * \returns Decoded code point or U+FFFD if the sequence is invalid or cut by the end of the buffer.
+ */
+/*static*/ uint Tokenizer::decode_utf8(const char *bytes, int len, int pos, int *size)
+{
+    const uchar lead = (uchar)bytes[pos];
+    *size = 1;
+
+    int  num_cont = 0;
+    uint cp       = 0;
+    uint min      = 0;
+    if (lead < 0x80) {
+        return lead;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        num_cont = 1; cp = lead & 0x1F; min = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        num_cont = 2; cp = lead & 0x0F; min = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        num_cont = 3; cp = lead & 0x07; min = 0x10000;
+    } else {
+        return 0xFFFD;
+    }
+
+    if (pos + num_cont >= len)
+        return 0xFFFD;
+
+    for (int i = 1; i <= num_cont; i++) {
+        const uchar cont = (uchar)bytes[pos + i];
+        if ((cont & 0xC0) != 0x80)
+            return 0xFFFD;
+        cp = (cp << 6) | (cont & 0x3F);
+    }
+
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        return 0xFFFD;
+
+    *size = num_cont + 1;
+    return cp;
+}
+
+/**
+ * \internal Finds the end of a word starting at \c pos.
+ *
+ * \param[in]     chars       Characters of the buffer.
+ * \param[in]     len         Length of the buffer.
+ * \param[in]     pos         Offset of the first character of the word.
+ * \param[in,out] is_boundary Initially the boundary flag of the first character,
+ *                            cleared if any other character is not a punctuation one.
+ *
+ * \returns Offset of the first character after the word.
+ */
+int Tokenizer::scan_word(const QChar *chars, int len, int pos, bool *is_boundary) const
+{
+    quint8 prev = CC_FALLBACK;
+    int    end  = pos;
+    bool   skip = true; // Whether to try skipping a run of ASCII letters and digits
+    while (end < len) {
+        if (skip) {
+            skip = false;
+            const int run = ascii_alnum_run(chars + end, len - end);
+            if (run > 0) {
+                *is_boundary = false;
+                end += run;
+                prev = char_class(chars[end - 1]);
+                continue;
+            }
+        }
+        const quint8 cc = char_class(chars[end]);
+        if (is_word_class(cc)) {
+            if (cc != CC_EXTENDNUMLET)
+                *is_boundary = false;
+            prev = cc;
+            end++;
+            continue;
+        }
+        if (end + 1 < len) {
+            const quint8 next = char_class(chars[end + 1]);
+            bool is_mid_letter = prev == CC_LETTER && next == CC_LETTER
+                && (cc == CC_MIDLETTER || cc == CC_MIDNUMLET);
+            bool is_mid_num    = prev == CC_DIGIT  && next == CC_DIGIT
+                && (cc == CC_MIDNUM    || cc == CC_MIDNUMLET);
+            if (is_mid_letter || is_mid_num) {
+                *is_boundary = false;
+                prev = next;
+                end += 2;
+                skip = true;
+                continue;
+            }
+        }
+        break;
+    }
+    return end;
+}
+
+/**
+ * \internal Finds the end of a word starting at \c pos of a UTF-8 buffer.
+ * \sa scan_word
+ */
+int Tokenizer::scan_word_utf8(const char *bytes, int len, int pos, bool *is_boundary) const
+{
+    quint8 prev = CC_FALLBACK;
+    int    end  = pos;
+    bool   skip = true;
+    int    size = 0;
+    while (end < len) {
+        if (skip) {
+            skip = false;
+            const int run = ascii_alnum_run(bytes + end, len - end);
+            if (run > 0) {
+                *is_boundary = false;
+                end += run;
+                prev = _classes[(uchar)bytes[end - 1]] & CC_MASK;
+                continue;
+            }
+        }
+        const quint8 cc = utf8_char_class(bytes, len, end, &size) & CC_MASK;
+        if (is_word_class(cc)) {
+            if (cc != CC_EXTENDNUMLET)
+                *is_boundary = false;
+            prev = cc;
+            end += size;
+            continue;
+        }
+        if (end + size < len) {
+            int next_size = 0;
+            const quint8 next = utf8_char_class(bytes, len, end + size, &next_size) & CC_MASK;
+            bool is_mid_letter = prev == CC_LETTER && next == CC_LETTER
+                && (cc == CC_MIDLETTER || cc == CC_MIDNUMLET);
+            bool is_mid_num    = prev == CC_DIGIT  && next == CC_DIGIT
+                && (cc == CC_MIDNUM    || cc == CC_MIDNUMLET);
+            if (is_mid_letter || is_mid_num) {
+                *is_boundary = false;
+                prev = next;
+                end += size + next_size;
+                skip = true;
+                continue;
+            }
+        }
+        break;
+    }
+    return end;
+}
+
+/**
+ * \internal Splits a span of the buffer using \c QTextBoundaryFinder.
+ *
+ * \param[in]  buffer Buffer being tokenized.
+ * \param[in]  start  Offset of the first character of the span.
+ * \param[in]  end    Offset of the first character after the span.
+ * \param[out] tokens Vector to append tokens to.
+ */
+void Tokenizer::split_fallback(const QString &buffer, int start, int end, QVector<Token> *tokens) const
+{
+    QTextBoundaryFinder boundary_finder(QTextBoundaryFinder::Word, buffer.unicode() + start, end - start);
+    int pos_start = boundary_finder.position();
+    int pos_end   = boundary_finder.toNextBoundary();
+    while (pos_end != -1) {
+        QStringRef token = buffer.midRef(start + pos_start, pos_end - pos_start);
+        tokens->append(Token(token, classify(token)));
+        pos_start = pos_end;
+        pos_end   = boundary_finder.toNextBoundary();
+    }
+}
+
+/**
+ * \internal Splits a span of a UTF-8 buffer using \c QTextBoundaryFinder.
+ *
+ * The span is decoded keeping track of the byte offset of every decoded character,
+ * so boundaries found in the decoded span are mapped back to the original bytes.
+ *
+ * \param[in]  bytes  Buffer being tokenized.
+ * \param[in]  start  Offset of the first byte of the span.
+ * \param[in]  end    Offset of the first byte after the span.
+ * \param[out] tokens Vector to append tokens to.
+ */
+void Tokenizer::split_fallback_utf8(const char *bytes, int start, int end, QVector<Utf8Token> *tokens) const
+{
+    QString      span;
+    QVector<int> offsets; // Byte offset of every UTF-16 unit of the span
+    span.reserve(end - start);
+    offsets.reserve(end - start + 1);
+
+    int pos  = start;
+    int size = 0;
+    while (pos < end) {
+        const uint cp = decode_utf8(bytes, end, pos, &size);
+        if (QChar::requiresSurrogates(cp)) {
+            span.append(QChar(QChar::highSurrogate(cp)));
+            span.append(QChar(QChar::lowSurrogate(cp)));
+            offsets << pos << pos;
+        } else {
+            span.append(QChar((ushort)cp));
+            offsets << pos;
+        }
+        pos += size;
+    }
+    offsets << end;
+
+    QTextBoundaryFinder boundary_finder(QTextBoundaryFinder::Word, span);
+    int pos_start = boundary_finder.position();
+    int pos_end   = boundary_finder.toNextBoundary();
+    while (pos_end != -1) {
+        const int byte_start = offsets.at(pos_start);
+        tokens->append(Utf8Token(
+            bytes + byte_start, offsets.at(pos_end) - byte_start,
+            classify(span.midRef(pos_start, pos_end - pos_start))
+        ));
+        pos_start = pos_end;
+        pos_end   = boundary_finder.toNextBoundary();
+    }
+}
+
+//! \internal Builds the character class table.
+void Tokenizer::_initialize_classes()
+{
+    for (int i = 0; i < TOKENIZER_TABLE_SIZE; i++) {
+        const QChar c(i);
+        quint8 cc = CC_SINGLE;
+
+        if (i >= 0x0500 && i < 0x1E00) {
+            cc = CC_FALLBACK; // Scripts other than Latin, Greek and Cyrillic
+        } else if (c.isSpace()) {
+            cc = CC_SPACE;
+        } else if (c.isMark() || c.category() == QChar::Other_Format) {
+            cc = CC_FALLBACK; // Characters attaching to their neighbours
+        } else if (c.isDigit()) {
+            cc = CC_DIGIT;
+        } else if (c.isLetter()) {
+            cc = CC_LETTER;
+        }
+
+        quint8 flags = isBoundaryChar(c)? FLAG_BOUNDARY : 0;
+        _classes[i]  = cc | flags;
+    }
+
+    // Characters with special word break properties:
+    const ushort midletter[]     = { 0x003A, 0x00B7, 0x0387, 0x2027 };
+    const ushort midnum[]        = { 0x002C, 0x003B, 0x037E };
+    const ushort midnumlet[]     = { 0x0027, 0x002E, 0x2018, 0x2019, 0x2024 };
+    const ushort extendnumlet[]  = { 0x005F };
+    const ushort fallback[]      = { 0x200B, 0x202F, 0x203F, 0x2040, 0x2044, 0x2054 };
+
+    for (size_t i = 0; i < sizeof(midletter) / sizeof(ushort); i++)
+        _classes[midletter[i]]    = (_classes[midletter[i]]    & ~CC_MASK) | CC_MIDLETTER;
+    for (size_t i = 0; i < sizeof(midnum) / sizeof(ushort); i++)
+        _classes[midnum[i]]       = (_classes[midnum[i]]       & ~CC_MASK) | CC_MIDNUM;
+    for (size_t i = 0; i < sizeof(midnumlet) / sizeof(ushort); i++)
+        _classes[midnumlet[i]]    = (_classes[midnumlet[i]]    & ~CC_MASK) | CC_MIDNUMLET;
+    for (size_t i = 0; i < sizeof(extendnumlet) / sizeof(ushort); i++)
+        _classes[extendnumlet[i]] = (_classes[extendnumlet[i]] & ~CC_MASK) | CC_EXTENDNUMLET;
+    for (size_t i = 0; i < sizeof(fallback) / sizeof(ushort); i++)
+        _classes[fallback[i]]     = (_classes[fallback[i]]     & ~CC_MASK) | CC_FALLBACK;
+}
@@ -0,0 +1,36 @@
+#include <qubiq/transducer_lemmatizer.h>
+
+/**
+ * \class TransducerLemmatizer
+ *
+ * \brief The TransducerLemmatizer class looks lemmas up in a transducer mapping wordforms to lemmas.
+ *
+ * The transducer is expected to be built from lines of the form "wordform<TAB>lemma",
+ * e.g. by \c TransducerManager::build. If a wordform has several outputs, the first
+ * one is used.
+ *
+ * \sa Text::setLemmatizer
+ */
+
+/**
+ * \brief Constructs a lemmatizer.
+ * \param[in] transducer Transducer to look lemmas up in, not owned by the lemmatizer.
+ */
+TransducerLemmatizer::TransducerLemmatizer(const Transducer *transducer)
+{
+    _transducer = transducer;
+}
+
+/**
+ * \brief Looks up the lemma of a wordform.
+ * \param[in] wordform Lowercased wordform.
+ * \returns The first output of the transducer for the wordform or an empty string if there is none.
+ */
+QString TransducerLemmatizer::lemmatize(const QString &wordform)
+{
+    if (_transducer == NULL)
+        return QString();
+
+    const QStringList lemmas = _transducer->search(wordform);
+    return lemmas.isEmpty()? QString() : lemmas.first();
+}
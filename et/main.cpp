@@ -2,7 +2,9 @@
 #include <cutelogger/include/Logger.h>
 #include <cutelogger/include/FileAppender.h>
 #include <qubiq/util/lexeme_index.h>
+#include <qubiq/util/transducer_manager.h>
 #include <qubiq/text.h>
+#include <qubiq/transducer_lemmatizer.h>
 #include <qubiq/extractor.h>
 #include <qubiq/abstract_term_filter.h>
 
@@ -15,6 +17,8 @@ public:
 
     virtual bool passes(const LexemeSequence &sequence);
 
+    QStringList stopwords() const;
+
 private:
     QSet<QString> *_articles;
     QSet<QString> *_conjunctions;
@@ -150,8 +154,19 @@ EnglishTermFilter::~EnglishTermFilter()
     delete _demonstratives;
 }
 
+QStringList EnglishTermFilter::stopwords() const
+{
+    return _articles->toList() + _conjunctions->toList() + _prepositions->toList() + _demonstratives->toList();
+}
+
 bool EnglishTermFilter::passes(const LexemeSequence &sequence)
 {
+    // Stopwords are flagged while indexing, so most sequences pass without string lookups
+    const Lexeme *first = sequence.lexemes()->at(0);
+    const Lexeme *last  = sequence.lexemes()->at(sequence.lexemes()->size() - 1);
+    if (!first->hasAnyFeature(Lexeme::FEATURE_STOPWORD) && !last->hasAnyFeature(Lexeme::FEATURE_STOPWORD))
+        return true;
+
     QString first_lexeme = sequence.lexemes()->at(0)->name();
     QString last_lexeme  = sequence.lexemes()->at(sequence.lexemes()->size() - 1)->name();
 
@@ -206,6 +221,23 @@ int main(int argc, char *argv[])
         "[STRING, MULTIPLE] Path to file(s) to extract terms from."
         " If omitted, text will be read from stdin.",
         "file"
+    ), optSnapshot("snapshot",
+        "[STRING] Path to a snapshot of the indexed input. If the snapshot exists,"
+        " it is loaded instead of indexing the input, otherwise it is written"
+        " after indexing.",
+        "snapshot"
+    ), optLemmas("lemmas",
+        "[STRING] Path to a QUTD transducer mapping wordforms to lemmas."
+        " If given, terms are extracted from lemmatized input.",
+        "lemmas"
+    ), optThreads("threads",
+        "[INTEGER] Number of threads used for indexing input files."
+        " If omitted, the number of CPU cores is used.",
+        "threads"
+    ), optCacheSize("cache-size",
+        "[INTEGER] Number of token surface forms cached while indexing input."
+        " If omitted, 65536 is used.",
+        "cache-size"
     ), optMinBigramFrequency("mbf",
         "[INTEGER] Minimum bigram frequency: Only bigrams with frequency higher"
         " or equal to this value will be extracted as term candidates."
@@ -239,6 +271,10 @@ int main(int argc, char *argv[])
     parser.addOption(optLogLevel);
     parser.addOption(optLanguage);
     parser.addOption(optFiles);
+    parser.addOption(optSnapshot);
+    parser.addOption(optLemmas);
+    parser.addOption(optThreads);
+    parser.addOption(optCacheSize);
     parser.addOption(optMinBigramFrequency);
     parser.addOption(optMinBigramScore);
     parser.addOption(optMaxSourceExtractionRate);
@@ -257,26 +293,60 @@ int main(int argc, char *argv[])
 
     Text text(locale);
 
-    const QStringList files = parser.values(optFiles);
-    if (files.size() == 0) {
-        text.appendFile(stdin);
-    } else {
-        for (int i = 0; i < files.size(); i++) {
-            text.appendFile(files.at(i));
-        }
+    bool is_converted = true;
+
+    int threads = parser.value(optThreads).toInt(&is_converted);
+    if (!is_converted || threads < 1)
+        threads = QThread::idealThreadCount();
+    text.setNumThreads(threads);
+    text.setUtf8Pipeline(true); // Only affects UTF-8 input
+
+    int cache_size = parser.value(optCacheSize).toInt(&is_converted);
+    if (is_converted && cache_size > 0)
+        text.setSurfaceFormCacheSize(cache_size);
+
+    TransducerManager    lemmas;
+    TransducerLemmatizer lemmatizer(lemmas.transducer());
+    if (parser.isSet(optLemmas)) {
+        if (lemmas.load(parser.value(optLemmas)))
+            text.setLemmatizer(&lemmatizer);
+        else
+            LOG_WARNING() << "Unable to load lemmas:" << lemmas.error();
     }
 
-    LexemeIndex *wordforms = text.wordforms();
-    LexemeIndex *lexemes   = text.lexemes();
-    Extractor extractor(lexemes->numUniquePositions() == wordforms->numUniquePositions()
-        ? lexemes : wordforms
-    );
     EnglishTermFilter english_filter;
+    const bool is_english = language.left(2).toLower() == "en";
+    if (is_english)
+        text.setStopwords(english_filter.stopwords());
+
+    const QString     snapshot = parser.value(optSnapshot);
+    const QStringList files    = parser.values(optFiles);
+    bool is_loaded = false;
+    if (!snapshot.isEmpty() && QFile::exists(snapshot)) {
+        is_loaded = text.load(snapshot);
+        if (!is_loaded)
+            LOG_WARNING() << "Unable to load snapshot" << snapshot << "- indexing the input and rewriting it";
+        else if (is_english) // The snapshot may be taken without stopwords
+            text.setStopwords(english_filter.stopwords());
+    }
+    if (!is_loaded) {
+        if (files.size() == 0) {
+            text.appendFile(stdin);
+        } else {
+            text.appendFiles(files, threads);
+        }
+        if (!snapshot.isEmpty())
+            text.save(snapshot);
+    }
+    if (text.surfaceForms().hits() + text.surfaceForms().misses() > 0)
+        LOG_INFO() << "Surface form cache hit rate:" << text.surfaceForms().hitRate()
+                   << "(" << text.surfaceForms().hits() << "hits," << text.surfaceForms().misses() << "misses )";
 
-    if (language.left(2).toLower() == "en")
-        extractor.setFilter(&english_filter);
+    // The snapshot brings documents and boundaries of the text along with the index
+    Extractor extractor(text.publish());
 
-    bool is_converted = true;
+    if (is_english)
+        extractor.setFilter(&english_filter);
 
     int mbf = parser.value(optMinBigramFrequency).toInt(&is_converted);
     if (is_converted)
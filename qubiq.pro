@@ -15,6 +15,8 @@ SUBDIRS  = core util et btd \
     tests/test_lexeme_index    \
     tests/test_lexeme_sequence \
     tests/test_text            \
+    tests/test_tokenizer       \
+    tests/test_surface_form_cache \
     tests/test_extractor       \
     tests/test_transducer
 
@@ -35,4 +37,6 @@ test_lexeme.depends          = util
 test_lexeme_index.depends    = util
 test_lexeme_sequence.depends = core
 test_text.depends            = core
+test_tokenizer.depends       = core
+test_surface_form_cache.depends = core
 test_extractor.depends       = core
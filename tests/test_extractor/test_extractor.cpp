@@ -21,6 +21,7 @@ class TestExtractor: public QObject
 private slots:
     void emptyExtractor();
     void simpleExtractor();
+    void snapshotExtractor();
 };
 
 void TestExtractor::emptyExtractor()
@@ -71,5 +72,57 @@ void TestExtractor::simpleExtractor()
     }
 }
 
+void TestExtractor::snapshotExtractor()
+{
+    Text reference_text;
+    reference_text.append(QString(_text));
+    Extractor reference(reference_text.wordforms());
+    QCOMPARE(reference.extract(), true);
+
+    Text text;
+    text.append(QString(_text));
+    Extractor extractor(text.publish());
+    QCOMPARE(extractor.index() == extractor.snapshot()->wordforms(), true);
+
+    // Appending after publishing does not affect the pinned snapshot:
+    text.append(QString(_text));
+    QCOMPARE(extractor.extract(), true);
+    QStringList expected, actual;
+    for (int i = 0; i < reference.extracted()->size(); i++) {
+        expected << reference.extracted()->at(i).image();
+    }
+    for (int i = 0; i < extractor.extracted()->size(); i++) {
+        actual << extractor.extracted()->at(i).image();
+    }
+    expected.sort();
+    actual.sort();
+    QCOMPARE(actual, expected);
+
+    // Frequencies of sequences of lexemes switched to bitmaps are counted by intersection:
+    Text bitmap_text;
+    bitmap_text.setBitmapThreshold(2);
+    bitmap_text.append(QString(_text));
+    Extractor bitmap_extractor(bitmap_text.publish());
+    const LexemeIndex *index = bitmap_extractor.snapshot()->wordforms();
+    QCOMPARE(index->bitmapById(index->findByName("database")->id()) != NULL, true);
+    QCOMPARE(index->bitmapById(index->findByName("connection")->id()) != NULL, true);
+    QCOMPARE(bitmap_text.wordforms()->positions("database")->size(), 4);
+
+    QCOMPARE(bitmap_extractor.extract(), true);
+    expected.clear();
+    actual.clear();
+    for (int i = 0; i < reference.extracted()->size(); i++) {
+        const LexemeSequence &term = reference.extracted()->at(i);
+        expected << term.image() + " " + QString::number(term.frequency());
+    }
+    for (int i = 0; i < bitmap_extractor.extracted()->size(); i++) {
+        const LexemeSequence &term = bitmap_extractor.extracted()->at(i);
+        actual << term.image() + " " + QString::number(term.frequency());
+    }
+    expected.sort();
+    actual.sort();
+    QCOMPARE(actual, expected);
+}
+
 QTEST_MAIN(TestExtractor)
 #include "test_extractor.moc"
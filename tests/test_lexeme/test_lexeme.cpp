@@ -10,6 +10,7 @@ private slots:
     void createLexeme();
     void createBoundary();
     void fillWithForms();
+    void features();
 };
 
 void TestLexeme::createLexeme()
@@ -70,5 +71,24 @@ void TestLexeme::fillWithForms()
     QCOMPARE(lexeme.offsets()->at(1), 42);
 }
 
+void TestLexeme::features()
+{
+    Lexeme lexeme("the", false);
+    QCOMPARE(lexeme.features(), (quint8)0);
+
+    lexeme.addFeatures(Lexeme::FEATURE_STOPWORD | Lexeme::FEATURE_CAPITALIZED);
+    QCOMPARE(lexeme.hasAnyFeature(Lexeme::FEATURE_STOPWORD), true);
+    QCOMPARE(lexeme.hasAnyFeature(Lexeme::FEATURE_NUMERIC | Lexeme::FEATURE_BOUNDARY), false);
+
+    lexeme.setIsBoundary(true);
+    QCOMPARE(lexeme.hasAnyFeature(Lexeme::FEATURE_BOUNDARY), true);
+    lexeme.setIsBoundary(false);
+    QCOMPARE(lexeme.isBoundary(), false);
+    QCOMPARE(lexeme.features(), (quint8)(Lexeme::FEATURE_STOPWORD | Lexeme::FEATURE_CAPITALIZED));
+
+    Lexeme copy(lexeme);
+    QCOMPARE(copy.features(), lexeme.features());
+}
+
 QTEST_MAIN(TestLexeme)
 #include "test_lexeme.moc"
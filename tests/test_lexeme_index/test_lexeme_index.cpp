@@ -9,6 +9,11 @@ private slots:
     void emptyIndex();
     void addPosition();
     void addPositions();
+    void addPositionOfLexeme();
+    void lexemeIds();
+    void compressedPostings();
+    void positionBitmap();
+    void frozenCopies();
     void mergeIndeces();
     void copyFromIndex();
 };
@@ -69,19 +74,228 @@ void TestLexemeIndex::addPosition()
     QCOMPARE(index.findByName("")    == NULL, true);
     QCOMPARE(index.findByName("see") == NULL, true);
 
-    QVector<int>* pos0 = index.positions("a");
+    const QVector<TextPosition> *pos0 = index.positions("a");
     QCOMPARE(pos0->size(), 2);
-    QCOMPARE(pos0->at(0), 0);
-    QCOMPARE(pos0->at(1), 3);
+    QCOMPARE(pos0->at(0), (TextPosition)0);
+    QCOMPARE(pos0->at(1), (TextPosition)3);
 
-    QVector<int>* pos1 = index.positions("man");
+    const QVector<TextPosition> *pos1 = index.positions("man");
     QCOMPARE(pos1->size(), 2);
-    QCOMPARE(pos1->at(0), 1);
-    QCOMPARE(pos1->at(1), 4);
+    QCOMPARE(pos1->at(0), (TextPosition)1);
+    QCOMPARE(pos1->at(1), (TextPosition)4);
 
-    QVector<int>* pos2 = index.positions("saw");
+    const QVector<TextPosition> *pos2 = index.positions("saw");
     QCOMPARE(pos2->size(), 1);
-    QCOMPARE(pos2->at(0), 2);
+    QCOMPARE(pos2->at(0), (TextPosition)2);
+}
+
+void TestLexemeIndex::addPositionOfLexeme()
+{
+    LexemeIndex index;
+    Lexeme *lexeme = index.addPosition("a", 0);
+
+    QCOMPARE(index.addPosition(lexeme, 2) == lexeme, true);
+    QCOMPARE(index.positions("a")->size(), 2);
+    QCOMPARE(index.positions("a")->at(1),  (TextPosition)2);
+    QCOMPARE(index.findByPosition(2) == lexeme, true);
+
+    Lexeme foreign("b");
+    QCOMPARE(index.addPosition(&foreign, 3) == NULL, true);
+    QCOMPARE(index.addPosition(lexeme,  -1) == NULL, true);
+    QCOMPARE(index.findByPosition(3) == NULL, true);
+}
+
+void TestLexemeIndex::lexemeIds()
+{
+    // 0 1   2   3 4
+    // a man saw a man
+    LexemeIndex index;
+    Lexeme *l0 = index.addPosition("a",   0);
+    Lexeme *l1 = index.addPosition("man", 1);
+    Lexeme *l2 = index.addPosition("saw", 2);
+    index.addPosition("a",   3);
+    index.addPosition("man", 5);
+
+    QCOMPARE(l0->id(), (quint32)0);
+    QCOMPARE(l1->id(), (quint32)1);
+    QCOMPARE(l2->id(), (quint32)2);
+    QCOMPARE(index.size(), 3);
+    QCOMPARE(index.numUniquePositions(), (TextPosition)5);
+
+    QCOMPARE(index.findById(1) == l1, true);
+    QCOMPARE(index.findById(3) == NULL, true);
+    QCOMPARE(index.findById(INVALID_LEXEME_ID) == NULL, true);
+    QCOMPARE(index.positionsById(1) == index.positions("man"), true);
+    QCOMPARE(index.positionsById(3) == NULL, true);
+
+    QCOMPARE(index.idByPosition(3), (quint32)0);
+    QCOMPARE(index.idByPosition(4), INVALID_LEXEME_ID);
+    QCOMPARE(index.idByPosition(6), INVALID_LEXEME_ID);
+    QCOMPARE(index.findByPosition(4) == NULL, true);
+    QCOMPARE(index.findByPosition(5) == l1, true);
+
+    // Copies of lexemes are not owned by the index
+    Lexeme copy(*l0);
+    QCOMPARE(copy.id(), INVALID_LEXEME_ID);
+    QCOMPARE(index.addPosition(&copy, 6) == NULL, true);
+
+    LexemeIndex other;
+    other.addPosition("saw", 0);
+    other.merge(index);
+    QCOMPARE(other.findByName("saw")->id(), (quint32)0);
+    QCOMPARE(other.findByName("a")->id(),   (quint32)1);
+    QCOMPARE(other.findByName("man")->id(), (quint32)2);
+}
+
+void TestLexemeIndex::compressedPostings()
+{
+    // Deltas of 1 to 4 bytes, several complete blocks and an incomplete one
+    QVector<TextPosition> expected;
+    TextPosition pos = 0;
+    for (int i = 0; i < 3000; i++) {
+        pos += i % 100 == 99? 70000 : (i % 10 == 9? 300 : 3);
+        expected.append(pos);
+    }
+    expected.append(pos + 20000000);
+
+    CompressedPostings postings(expected);
+    QCOMPARE(postings.size(), expected.size());
+    QCOMPARE(postings.numBlocks(), 24);
+    QCOMPARE(postings.toVector(), expected);
+    QCOMPARE(postings.findBlock(expected.at(0) - 1), 0);
+    QCOMPARE(postings.findBlock(expected.at(300)), 2);
+    QCOMPARE(postings.append(expected.at(0)), false);
+
+    PostingsIterator it(&postings);
+    QCOMPARE(it.size(), expected.size());
+    QCOMPARE(it.next(), expected.at(0));
+    QCOMPARE(it.skipTo(expected.at(700) - 1), true);
+    QCOMPARE(it.next(), expected.at(700));
+    QCOMPARE(it.skipTo(expected.at(701)), true);
+    QCOMPARE(it.next(), expected.at(701));
+    QCOMPARE(it.skipTo(expected.last()), true);
+    QCOMPARE(it.next(), expected.last());
+    QCOMPARE(it.hasNext(), false);
+    QCOMPARE(it.skipTo(0), false);
+
+    LexemeIndex index;
+    for (int i = 0; i < expected.size(); i++) {
+        index.addPosition("the", expected.at(i));
+        index.addPosition("end", expected.at(i) + 1);
+    }
+    index.addPosition("a", 0);
+
+    const qint64 usage = index.postingsMemoryUsage();
+    QCOMPARE(index.compress(100), 2);
+    QVERIFY(index.postingsMemoryUsage() * 2 < usage);
+    QCOMPARE(index.positions("the") == NULL, true);
+    QCOMPARE(index.positions("a")->size(), 1);
+
+    PostingsIterator the = index.postings("the");
+    QVector<TextPosition> decoded;
+    while (the.hasNext()) {
+        decoded.append(the.next());
+    }
+    QCOMPARE(decoded, expected);
+
+    // Appending keeps positions compressed unless they go backwards
+    index.addPosition("the", expected.last() + 5);
+    QCOMPARE(index.positions("the") == NULL, true);
+    QCOMPARE(index.postings("the").size(), expected.size() + 1);
+    index.addPosition("end", 1);
+    QCOMPARE(index.positions("end") != NULL, true);
+    QCOMPARE(index.positions("end")->size(), expected.size() + 1);
+
+    LexemeIndex copy;
+    copy.merge(index);
+    QCOMPARE(copy.positions("the")->size(), expected.size() + 1);
+    QCOMPARE(copy.findByPosition(expected.at(500)) == copy.findByName("the"), true);
+}
+
+void TestLexemeIndex::positionBitmap()
+{
+    // A bitmap container, an array container and one more array container two chunks later
+    QVector<TextPosition> expected;
+    for (int i = 0; i < 5000; i++) {
+        expected.append(2 * i);
+    }
+    for (int i = 0; i < 100; i++) {
+        expected.append(70000 + 7 * i);
+    }
+    expected.append(200000);
+
+    PositionBitmap bitmap;
+    for (int i = 0; i < expected.size(); i++) {
+        QCOMPARE(bitmap.append(expected.at(i)), true);
+    }
+    QCOMPARE(bitmap.append(200000), false);
+    QCOMPARE(bitmap.size(), expected.size());
+    QCOMPARE(bitmap.toVector(), expected);
+    QCOMPARE(bitmap.contains(9998),   true);
+    QCOMPARE(bitmap.contains(9999),   false);
+    QCOMPARE(bitmap.contains(70007),  true);
+    QCOMPARE(bitmap.contains(131072), false);
+    QCOMPARE(bitmap.rank(10),      5);
+    QCOMPARE(bitmap.rank(70001),   5001);
+    QCOMPARE(bitmap.rank(1000000), expected.size());
+    QCOMPARE(bitmap.select(0),    (TextPosition)0);
+    QCOMPARE(bitmap.select(4999), (TextPosition)9998);
+    QCOMPARE(bitmap.select(5001), (TextPosition)70007);
+    QCOMPARE(bitmap.select(expected.size() - 1), (TextPosition)200000);
+
+    PostingsIterator it(&bitmap);
+    QCOMPARE(it.size(), expected.size());
+    QCOMPARE(it.next(), (TextPosition)0);
+    QCOMPARE(it.skipTo(9997), true);
+    QCOMPARE(it.next(), (TextPosition)9998);
+    QCOMPARE(it.skipTo(70008), true);
+    QCOMPARE(it.next(), (TextPosition)70014);
+    QCOMPARE(it.skipTo(150000), true);
+    QCOMPARE(it.next(), (TextPosition)200000);
+    QCOMPARE(it.hasNext(), false);
+    it.seek(5000);
+    QCOMPARE(it.next(), (TextPosition)70000);
+
+    // Positions of a lexeme following the ones of the bitmap
+    PositionBitmap other;
+    for (int i = 0; i < 5000; i++) {
+        other.append(2 * i + 1);
+    }
+    other.append(70001);
+
+    QCOMPARE(bitmap.intersected(other).size(),      0);
+    QCOMPARE(bitmap.intersected(other, 1).size(),   5001);
+    QCOMPARE(bitmap.intersected(other, -1).size(),  4999);
+    QCOMPARE(bitmap.intersected(other, 60003).toVector(), QVector<TextPosition>() << 9998);
+
+    // Bitmaps are opt-in, so positions of frequent lexemes stay accessible by default
+    LexemeIndex plain;
+    QCOMPARE(plain.bitmapThreshold(), 0);
+    for (int i = 0; i < 70000; i++) {
+        plain.addPosition("the", i);
+    }
+    QCOMPARE(plain.bitmapById(plain.findByName("the")->id()) == NULL, true);
+    QCOMPARE(plain.positions("the")->size(), 70000);
+
+    // Frequent lexemes are switched to bitmaps until positions go backwards
+    LexemeIndex index;
+    index.setBitmapThreshold(1000);
+    for (int i = 0; i < 1500; i++) {
+        index.addPosition("the", 2 * i);
+        index.addPosition("cat", 2 * i + 1);
+    }
+    index.addPosition("a", 3000);
+
+    const quint32 the = index.findByName("the")->id();
+    QCOMPARE(index.bitmapById(the) != NULL, true);
+    QCOMPARE(index.positions("the") == NULL, true);
+    QCOMPARE(index.postings("the").size(), 1500);
+    QCOMPARE(index.bitmapById(index.findByName("a")->id()) == NULL, true);
+    QCOMPARE(index.bitmapById(the)->intersected(*index.bitmapById(index.findByName("cat")->id()), 1).size(), 1500);
+
+    index.addPosition("cat", 1);
+    QCOMPARE(index.bitmapById(index.findByName("cat")->id()) == NULL, true);
+    QCOMPARE(index.positions("cat")->size(), 1501);
 }
 
 void TestLexemeIndex::addPositions()
@@ -91,10 +305,10 @@ void TestLexemeIndex::addPositions()
     // a man wants to see the man men have never seen
     LexemeIndex index;
 
-    QVector<int> *pos_MAN1 = new QVector<int>();
+    QVector<TextPosition> *pos_MAN1 = new QVector<TextPosition>();
     *pos_MAN1 << 1 << 6;
 
-    QVector<int> *pos_SEE = new QVector<int>();
+    QVector<TextPosition> *pos_SEE = new QVector<TextPosition>();
     *pos_SEE << 4 << 10;
 
     Lexeme *lex_MAN1 = index.addPositions("man", pos_MAN1);
@@ -102,27 +316,85 @@ void TestLexemeIndex::addPositions()
 
     QCOMPARE(lex_MAN1 != lex_SEE, true);
     QCOMPARE(index.positions("man")->size(),  2);
-    QCOMPARE(index.positions("man")->at(0) ,  1);
-    QCOMPARE(index.positions("man")->at(1) ,  6);
+    QCOMPARE(index.positions("man")->at(0) ,  (TextPosition)1);
+    QCOMPARE(index.positions("man")->at(1) ,  (TextPosition)6);
     QCOMPARE(index.positions("see")->size(),  2);
-    QCOMPARE(index.positions("see")->at(0) ,  4);
-    QCOMPARE(index.positions("see")->at(1) , 10);
+    QCOMPARE(index.positions("see")->at(0) ,  (TextPosition)4);
+    QCOMPARE(index.positions("see")->at(1) , (TextPosition)10);
 
-    QVector<int> *pos_MAN2 = new QVector<int>();
+    QVector<TextPosition> *pos_MAN2 = new QVector<TextPosition>();
     *pos_MAN2 << 7;
 
     Lexeme *lex_MAN2 = index.addPositions("man", pos_MAN2);
     QCOMPARE(lex_MAN1 == lex_MAN2, true);
     QCOMPARE(index.positions("man")->size(),  3);
-    QCOMPARE(index.positions("man")->at(0) ,  1);
-    QCOMPARE(index.positions("man")->at(1) ,  6);
-    QCOMPARE(index.positions("man")->at(2) ,  7);
+    QCOMPARE(index.positions("man")->at(0) ,  (TextPosition)1);
+    QCOMPARE(index.positions("man")->at(1) ,  (TextPosition)6);
+    QCOMPARE(index.positions("man")->at(2) ,  (TextPosition)7);
 
     delete pos_MAN1;
     delete pos_MAN2;
     delete pos_SEE;
 }
 
+void TestLexemeIndex::frozenCopies()
+{
+    LexemeIndex index;
+    for (int i = 0; i < 10000; i++) {
+        index.addPosition(i % 2 == 0? QString("the") : QString::number(i % 7), i);
+    }
+
+    LexemeIndex *first = index.freeze();
+    QCOMPARE(first->isFrozen(), true);
+    QCOMPARE(first->numCopiedPositions(), (qint64)10000);
+    QCOMPARE(first->size(), index.size());
+    QCOMPARE(first->positions("the") == NULL, true);
+    QCOMPARE(first->postings("the").size(), 5000);
+    QCOMPARE(first->addPosition("the", 10000) == NULL, true);
+    QCOMPARE(first->freeze() == NULL, true);
+
+    // Only new positions are copied, compressed ones included
+    QCOMPARE(index.compress(1000), 1);
+    index.addPosition("the", 10000);
+    index.addPosition("end", 10001);
+    index.addPosition("1", 10002);
+    index.findByName("1")->addFeatures(Lexeme::FEATURE_NUMERIC);
+
+    LexemeIndex *stale  = index.freeze();
+    LexemeIndex *second = index.freeze(stale);
+    QCOMPARE(stale->numCopiedPositions(), (qint64)10003);
+    QCOMPARE(second->numCopiedPositions(), (qint64)0);
+    delete stale;
+
+    index.addPosition("the", 10004);
+    LexemeIndex *third = index.freeze(second);
+    QCOMPARE(third->numCopiedPositions(), (qint64)1);
+    QCOMPARE(third->findByName("end")->id(), index.findByName("end")->id());
+    QCOMPARE(third->findByPosition(10001)->name(), QString("end"));
+    QCOMPARE(third->findByName("1")->hasAnyFeature(Lexeme::FEATURE_NUMERIC), true);
+    QCOMPARE(third->idByPosition(10003), INVALID_LEXEME_ID);
+    QCOMPARE(third->numUniquePositions(), (TextPosition)10004);
+
+    PostingsIterator the = third->postings("the");
+    QCOMPARE(the.size(), 5002);
+    QCOMPARE(the.skipTo(8191), true);
+    QCOMPARE(the.next(), (TextPosition)8192);
+    QCOMPARE(the.skipTo(10001), true);
+    QCOMPARE(the.next(), (TextPosition)10004);
+    QCOMPARE(the.hasNext(), false);
+
+    // Earlier copies are not affected
+    QCOMPARE(first->findByName("end") == NULL, true);
+    QCOMPARE(first->findByName("1")->hasAnyFeature(Lexeme::FEATURE_NUMERIC), false);
+    QCOMPARE(first->idByPosition(10000), INVALID_LEXEME_ID);
+    QCOMPARE(second->postings("the").size(), 5001);
+
+    delete first;
+    delete second;
+    QCOMPARE(third->findByName("1")->name(), QString("1"));
+    delete third;
+}
+
 void TestLexemeIndex::mergeIndeces()
 {
     // Consider indeces of wordforms on the text:
@@ -146,8 +418,8 @@ void TestLexemeIndex::mergeIndeces()
 
     QCOMPARE(index1.size(), 6);
     QCOMPARE(index2.size(), 5);
-    QCOMPARE(index1.numUniquePositions(), 6);
-    QCOMPARE(index2.numUniquePositions(), 5);
+    QCOMPARE(index1.numUniquePositions(), (TextPosition)6);
+    QCOMPARE(index2.numUniquePositions(), (TextPosition)5);
 
     QCOMPARE(index1.findByName("wants") != NULL, true);
     QCOMPARE(index1.findByName("will")  == NULL, true);
@@ -160,8 +432,8 @@ void TestLexemeIndex::mergeIndeces()
 
     QCOMPARE(index1.size(), 9);
     QCOMPARE(index2.size(), 5);
-    QCOMPARE(index1.numUniquePositions(), 11);
-    QCOMPARE(index2.numUniquePositions(),  5);
+    QCOMPARE(index1.numUniquePositions(), (TextPosition)11);
+    QCOMPARE(index2.numUniquePositions(),  (TextPosition)5);
 
     QCOMPARE(index1.findByName("wants") != NULL, true);
     QCOMPARE(index1.findByName("will")  != NULL, true);
@@ -171,15 +443,15 @@ void TestLexemeIndex::mergeIndeces()
     QCOMPARE(index2.findByName("never") != NULL, true);
 
     QCOMPARE(index1.positions("man")->size(), 2);
-    QCOMPARE(index1.positions("man")->at(0) , 1);
-    QCOMPARE(index1.positions("man")->at(1) , 6);
+    QCOMPARE(index1.positions("man")->at(0) , (TextPosition)1);
+    QCOMPARE(index1.positions("man")->at(1) , (TextPosition)6);
 
     QCOMPARE(index1.positions("see")->size(),  2);
-    QCOMPARE(index1.positions("see")->at(0) ,  4);
-    QCOMPARE(index1.positions("see")->at(1) , 10);
+    QCOMPARE(index1.positions("see")->at(0) ,  (TextPosition)4);
+    QCOMPARE(index1.positions("see")->at(1) , (TextPosition)10);
 
     QCOMPARE(index1.positions("never")->size(), 1);
-    QCOMPARE(index1.positions("never")->at(0) , 9);
+    QCOMPARE(index1.positions("never")->at(0) , (TextPosition)9);
 
     // After merge, index1 covers the whole text...
     for (int i = 0; i < wordforms.size(); i++) {
@@ -211,8 +483,8 @@ void TestLexemeIndex::copyFromIndex()
             index2.addPosition(wordforms.at(i), i);
         }
     }
-    QCOMPARE(index1.numUniquePositions(), 6);
-    QCOMPARE(index2.numUniquePositions(), 5);
+    QCOMPARE(index1.numUniquePositions(), (TextPosition)6);
+    QCOMPARE(index2.numUniquePositions(), (TextPosition)5);
 
     bool is_new;
     Lexeme *src;
@@ -224,8 +496,8 @@ void TestLexemeIndex::copyFromIndex()
     QCOMPARE(is_new, true);
     QCOMPARE(src != dst, true);
 
-    QCOMPARE(index1.numUniquePositions(), 6);
-    QCOMPARE(index2.numUniquePositions(), 6);
+    QCOMPARE(index1.numUniquePositions(), (TextPosition)6);
+    QCOMPARE(index2.numUniquePositions(), (TextPosition)6);
 
     QCOMPARE(index1.positions("to") != index2.positions("to"), true);
     QCOMPARE(index1.positions("to")->size(), 1);
@@ -241,14 +513,14 @@ void TestLexemeIndex::copyFromIndex()
     QCOMPARE(src != dst       , true);
     QCOMPARE(dst == index2_see, true);
 
-    QCOMPARE(index1.numUniquePositions(), 6);
-    QCOMPARE(index2.numUniquePositions(), 7);
+    QCOMPARE(index1.numUniquePositions(), (TextPosition)6);
+    QCOMPARE(index2.numUniquePositions(), (TextPosition)7);
 
     QCOMPARE(index1.positions("see")->size(), 1);
     QCOMPARE(index2.positions("see")->size(), 2);
-    QCOMPARE(index1.positions("see")->at(0),  4);
-    QCOMPARE(index2.positions("see")->at(0), 10);
-    QCOMPARE(index2.positions("see")->at(1),  4);
+    QCOMPARE(index1.positions("see")->at(0),  (TextPosition)4);
+    QCOMPARE(index2.positions("see")->at(0), (TextPosition)10);
+    QCOMPARE(index2.positions("see")->at(1),  (TextPosition)4);
 }
 
 QTEST_MAIN(TestLexemeIndex)
@@ -127,12 +127,12 @@ void TestLexemeSequence::simpleSequence()
 
     // Lexeme positions vs. sequecne positions:
 
-    QVector<int> *first_lexeme_pos = text.wordforms()->positions(sequence.lexemes()->at(0)->name());
+    const QVector<TextPosition> *first_lexeme_pos = text.wordforms()->positions(sequence.lexemes()->at(0)->name());
     QCOMPARE(first_lexeme_pos->size(),     4);
     QCOMPARE(first_lexeme_pos->at(0),      1);
-    QCOMPARE(sequence.positions()->at(0),  1);
+    QCOMPARE(sequence.positions()->at(0),  (TextPosition)1);
     QCOMPARE(first_lexeme_pos->at(3),     34);
-    QCOMPARE(sequence.positions()->at(1), 34);
+    QCOMPARE(sequence.positions()->at(1), (TextPosition)34);
 }
 
 void TestLexemeSequence::extremeMetricValues()
@@ -8,5 +8,7 @@ SUBDIRS  = \
     test_lexeme_sequence.pro \
     test_lexeme_index.pro \
     test_text.pro \
+    test_tokenizer.pro \
+    test_surface_form_cache.pro \
     test_extractor.pro \
     test_transducer.pro
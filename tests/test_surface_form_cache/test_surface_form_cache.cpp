@@ -0,0 +1,84 @@
+#include <QtTest/QtTest>
+
+#include <qubiq/surface_form_cache.h>
+
+class TestSurfaceFormCache: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyCache();
+    void findAndInsert();
+    void eviction();
+    void clear();
+};
+
+void TestSurfaceFormCache::emptyCache()
+{
+    SurfaceFormCache cache(10);
+    QString s("foo");
+
+    QCOMPARE(cache.capacity(), 16);
+    QCOMPARE(cache.find(s.midRef(0)) == NULL, true);
+    QCOMPARE(cache.hits(), (qint64)0);
+    QCOMPARE(cache.misses(), (qint64)1);
+    QCOMPARE(cache.hitRate(), 0.0);
+}
+
+void TestSurfaceFormCache::findAndInsert()
+{
+    SurfaceFormCache cache;
+    Lexeme foo("foo");
+    Lexeme bar("bar");
+    QString buffer("Foo bar foo");
+
+    cache.insert(buffer.midRef(0, 3), &foo);
+    cache.insert(buffer.midRef(4, 3), &bar);
+
+    // Keys are compared by content, not by the buffer they are sliced from:
+    QString other("bar Foo");
+    QCOMPARE(cache.find(other.midRef(4, 3)) == &foo, true);
+    QCOMPARE(cache.find(other.midRef(0, 3)) == &bar, true);
+    QCOMPARE(cache.find(buffer.midRef(8, 3)) == NULL, true);
+
+    QCOMPARE(cache.hits(), (qint64)2);
+    QCOMPARE(cache.misses(), (qint64)1);
+    QCOMPARE(cache.hitRate() > 0.66 && cache.hitRate() < 0.67, true);
+}
+
+void TestSurfaceFormCache::eviction()
+{
+    SurfaceFormCache cache(SURFACE_FORM_CACHE_MAX_PROBES);
+    Lexeme lexeme("x");
+    QStringList forms;
+    for (int i = 0; i < 100; i++)
+        forms << QString::number(i);
+
+    for (int i = 0; i < forms.size(); i++)
+        cache.insert(forms.at(i).midRef(0), &lexeme);
+
+    int found = 0;
+    for (int i = 0; i < forms.size(); i++) {
+        if (cache.find(forms.at(i).midRef(0)) != NULL)
+            found++;
+    }
+    QCOMPARE(found <= cache.capacity(), true);
+    QCOMPARE(cache.find(forms.last().midRef(0)) == &lexeme, true);
+}
+
+void TestSurfaceFormCache::clear()
+{
+    SurfaceFormCache cache;
+    Lexeme lexeme("foo");
+    QString s("foo");
+
+    cache.insert(s.midRef(0), &lexeme);
+    QCOMPARE(cache.find(s.midRef(0)) == &lexeme, true);
+
+    cache.clear();
+    QCOMPARE(cache.hits(), (qint64)0);
+    QCOMPARE(cache.find(s.midRef(0)) == NULL, true);
+}
+
+QTEST_MAIN(TestSurfaceFormCache)
+#include "test_surface_form_cache.moc"
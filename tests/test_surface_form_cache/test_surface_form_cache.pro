@@ -0,0 +1,7 @@
+#
+# Tests for class SurfaceFormCache
+#
+
+include(../test_qubiq.pri)
+
+SOURCES = test_surface_form_cache.cpp
@@ -1,6 +1,11 @@
+#include <zlib.h>
 #include <QtTest/QtTest>
 
 #include <qubiq/text.h>
+#include <qubiq/index_builder.h>
+#include <qubiq/extractor.h>
+#include <qubiq/transducer_lemmatizer.h>
+#include <qubiq/util/transducer_manager.h>
 
 class TestText: public QObject
 {
@@ -9,17 +14,38 @@ class TestText: public QObject
 private slots:
     void emptyText();
     void simpleSentence();
+    void surfaceFormCache();
     void simpleSentenceFromFile();
     void longSentenceFromFile();
+    void simpleSentenceFromMappedFile();
+    void chunkedFile();
+    void multipleFiles();
+    void utf8Pipeline();
+    void batchAppend();
+    void directory();
+    void gzipFile();
+    void snapshot();
+    void publishedSnapshot();
+    void documents();
+    void boundaries();
+    void lemmatizer();
+    void stats();
+    void features();
+    void externalBuild();
+    void deduplication();
     void appendFromNonExistentFile();
     void nonEnglishLocale();
+
+private:
+    void compare_wordforms(const Text &actual, const Text &expected);
+    QByteArray gzip(const QByteArray &data);
 };
 
 void TestText::emptyText()
 {
     Text text;
 
-    QCOMPARE(text.length()           , 0);
+    QCOMPARE(text.length()           , (TextPosition)0);
     QCOMPARE(text.wordforms()->size(), 0);
     QCOMPARE(text.lexemes()->size()  , 0);
 }
@@ -32,22 +58,42 @@ void TestText::simpleSentence()
         "The quick brown fox jumps over the lazy dog."
     )), true);
 
-    QCOMPARE(text.length(), 10);
+    QCOMPARE(text.length(), (TextPosition)10);
 
     LexemeIndex *index = text.wordforms();
-    QCOMPARE(index->numUniquePositions(), 10);
+    QCOMPARE(index->numUniquePositions(), (TextPosition)10);
     QCOMPARE(index->size(), 9);
 
     Lexeme *lexeme1 = index->findByPosition(0);
     Lexeme *lexeme2 = index->findByPosition(6);
     QCOMPARE(lexeme1 == lexeme2, true);
 
-    QVector<int> *positions1 = index->positions(index->findByPosition(0)->name());
-    QVector<int> *positions2 = index->positions("the");
+    const QVector<TextPosition> *positions1 = index->positions(index->findByPosition(0)->name());
+    const QVector<TextPosition> *positions2 = index->positions("the");
     QCOMPARE(positions1 == positions2, true);
     QCOMPARE(index->positions("the")->size(), 2);
-    QCOMPARE(index->positions("the")->at(0),  0);
-    QCOMPARE(index->positions("the")->at(1),  6);
+    QCOMPARE(index->positions("the")->at(0),  (TextPosition)0);
+    QCOMPARE(index->positions("the")->at(1),  (TextPosition)6);
+}
+
+void TestText::surfaceFormCache()
+{
+    Text text;
+
+    QCOMPARE(text.append(QString("The cat saw the cat. The end.")), true);
+
+    // "The", "cat", "saw", "the", "." and "end" miss, repeated "cat", "The" and "." hit:
+    QCOMPARE(text.surfaceForms().misses(), (qint64)6);
+    QCOMPARE(text.surfaceForms().hits(),   (qint64)3);
+
+    LexemeIndex *index = text.wordforms();
+    QCOMPARE(text.length(), (TextPosition)9);
+    QCOMPARE(index->size(), 5);
+    QCOMPARE(index->positions("the")->size(), 3);
+    QCOMPARE(index->positions("the")->at(2),  (TextPosition)6);
+    QCOMPARE(index->positions("cat")->at(1),  (TextPosition)4);
+    QCOMPARE(index->positions(".")->at(1),    (TextPosition)8);
+    QCOMPARE(index->findByName(".")->isBoundary(), true);
 }
 
 void TestText::simpleSentenceFromFile()
@@ -61,22 +107,22 @@ void TestText::simpleSentenceFromFile()
     Text text;
     QCOMPARE(text.appendFile(text_file.fileName()), true);
 
-    QCOMPARE(text.length(), 10);
+    QCOMPARE(text.length(), (TextPosition)10);
 
     LexemeIndex *index = text.wordforms();
-    QCOMPARE(index->numUniquePositions(), 10);
+    QCOMPARE(index->numUniquePositions(), (TextPosition)10);
     QCOMPARE(index->size(), 9);
 
     Lexeme *lexeme1 = index->findByPosition(0);
     Lexeme *lexeme2 = index->findByPosition(6);
     QCOMPARE(lexeme1 == lexeme2, true);
 
-    QVector<int> *positions1 = index->positions(index->findByPosition(0)->name());
-    QVector<int> *positions2 = index->positions("the");
+    const QVector<TextPosition> *positions1 = index->positions(index->findByPosition(0)->name());
+    const QVector<TextPosition> *positions2 = index->positions("the");
     QCOMPARE(positions1 == positions2, true);
     QCOMPARE(index->positions("the")->size(), 2);
-    QCOMPARE(index->positions("the")->at(0),  0);
-    QCOMPARE(index->positions("the")->at(1),  6);
+    QCOMPARE(index->positions("the")->at(0),  (TextPosition)0);
+    QCOMPARE(index->positions("the")->at(1),  (TextPosition)6);
 }
 
 void TestText::longSentenceFromFile()
@@ -90,7 +136,782 @@ void TestText::longSentenceFromFile()
     Text text;
     QCOMPARE(text.appendFile(text_file.fileName()), true);
 
-    QCOMPARE(text.length(), 10);
+    QCOMPARE(text.length(), (TextPosition)10);
+}
+
+void TestText::simpleSentenceFromMappedFile()
+{
+    QTemporaryFile text_file;
+    text_file.open();
+    text_file.write("The quick brown fox\n");
+    text_file.write("jumps over the lazy dog.");
+    text_file.close();
+
+    Text text;
+    QCOMPARE(text.memoryMapping(), false);
+    text.setMemoryMapping(true);
+    QCOMPARE(text.memoryMapping(), true);
+    QCOMPARE(text.appendFile(text_file.fileName()), true);
+
+    QCOMPARE(text.length(), (TextPosition)10);
+
+    LexemeIndex *index = text.wordforms();
+    QCOMPARE(index->numUniquePositions(), (TextPosition)10);
+    QCOMPARE(index->size(), 9);
+    QCOMPARE(index->positions("the")->size(), 2);
+    QCOMPARE(index->positions("the")->at(0),  (TextPosition)0);
+    QCOMPARE(index->positions("the")->at(1),  (TextPosition)6);
+    QCOMPARE(index->findByPosition(9)->name(), QString("."));
+
+    QCOMPARE(text.appendFile("non-existent.txt"), false);
+}
+
+void TestText::chunkedFile()
+{
+    QTemporaryFile text_file;
+    text_file.open();
+    for (int i = 0; i < 200; i++) {
+        text_file.write("The quick brown fox jumps over the lazy dog, isn't it?\n");
+        text_file.write(QString::fromUtf8("  Быть может быть, а может и не быть.\t").toUtf8());
+        text_file.write(QString::number(i).toLatin1());
+        text_file.write(" 3.14 e.g. laaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaazy ");
+    }
+    text_file.close();
+
+    Text sequential;
+    QCOMPARE(sequential.appendFile(text_file.fileName()), true);
+
+    Text chunked;
+    chunked.setNumThreads(4);
+    chunked.setChunkSize(64);
+    QCOMPARE(chunked.numThreads(), 4);
+    QCOMPARE(chunked.chunkSize() , (qint64)64);
+    QCOMPARE(chunked.appendFile(text_file.fileName()), true);
+
+    QCOMPARE(chunked.length(), sequential.length());
+    QCOMPARE(chunked.wordforms()->size(), sequential.wordforms()->size());
+    for (int i = 0; i < sequential.length(); i++) {
+        Lexeme *expected = sequential.wordforms()->findByPosition(i);
+        Lexeme *actual   = chunked.wordforms()->findByPosition(i);
+        QCOMPARE(actual->name()      , expected->name());
+        QCOMPARE(actual->isBoundary(), expected->isBoundary());
+    }
+}
+
+void TestText::multipleFiles()
+{
+    QTemporaryFile text_file1;
+    text_file1.open();
+    text_file1.write("The quick brown fox");
+    text_file1.close();
+
+    QTemporaryFile text_file2;
+    text_file2.open();
+    text_file2.write("jumps over the lazy dog. The dog sleeps, the fox runs away.");
+    text_file2.close();
+
+    QTemporaryFile text_file3;
+    text_file3.open();
+    text_file3.write("The end.");
+    text_file3.close();
+
+    QStringList fnames;
+    fnames << text_file1.fileName() << text_file2.fileName() << text_file3.fileName();
+
+    Text sequential;
+    for (int i = 0; i < fnames.size(); i++) {
+        QCOMPARE(sequential.appendFile(fnames.at(i)), true);
+    }
+
+    Text concurrent;
+    QCOMPARE(concurrent.appendFiles(fnames, 3), true);
+
+    QCOMPARE(concurrent.length(), sequential.length());
+    QCOMPARE(concurrent.wordforms()->size(), sequential.wordforms()->size());
+    for (int i = 0; i < sequential.length(); i++) {
+        QCOMPARE(
+            concurrent.wordforms()->findByPosition(i)->name(),
+            sequential.wordforms()->findByPosition(i)->name()
+        );
+    }
+    QCOMPARE(concurrent.wordforms()->positions("the")->at(0), (TextPosition)0);
+    QCOMPARE(concurrent.wordforms()->positions("end")->at(0), concurrent.length() - 2);
+
+    Text partial;
+    QCOMPARE(partial.appendFiles(QStringList() << "non-existent.txt" << text_file3.fileName()), false);
+    QCOMPARE(partial.length(), (TextPosition)3);
+}
+
+void TestText::utf8Pipeline()
+{
+    QByteArray contents("\xEF\xBB\xBF");
+    for (int i = 0; i < 50; i++) {
+        contents.append("The quick brown fox jumps over the lazy dog, isn't it?\n");
+        contents.append(QString::fromUtf8("  Быть может быть, а может и не быть. ÉTÉ\t").toUtf8());
+        contents.append("3.14 e.g. ");
+    }
+
+    QTemporaryFile text_file;
+    text_file.open();
+    text_file.write(contents);
+    text_file.close();
+
+    Text reference;
+    QCOMPARE(reference.append(QString::fromUtf8(contents.mid(3))), true);
+
+    Text from_buffer;
+    QCOMPARE(from_buffer.appendUtf8(contents), true);
+    QCOMPARE(from_buffer.appendUtf8(QByteArray()), false);
+    compare_wordforms(from_buffer, reference);
+
+    Text from_file;
+    QCOMPARE(from_file.utf8Pipeline(), false);
+    from_file.setUtf8Pipeline(true);
+    QCOMPARE(from_file.utf8Pipeline(), true);
+    QCOMPARE(from_file.appendFile(text_file.fileName()), true);
+    compare_wordforms(from_file, reference);
+
+    Text chunked;
+    chunked.setUtf8Pipeline(true);
+    chunked.setNumThreads(4);
+    chunked.setChunkSize(64);
+    QCOMPARE(chunked.appendFile(text_file.fileName()), true);
+    compare_wordforms(chunked, reference);
+
+    Text multiple;
+    multiple.setUtf8Pipeline(true);
+    QCOMPARE(multiple.appendFiles(QStringList() << text_file.fileName(), 2), true);
+    compare_wordforms(multiple, reference);
+
+    QCOMPARE(from_file.wordforms()->findByName(QString::fromUtf8("быть"))->isBoundary(), false);
+    QCOMPARE(from_file.wordforms()->findByName(QString::fromUtf8("été")) != NULL, true);
+    QCOMPARE(from_file.wordforms()->findByName(",")->isBoundary(), true);
+}
+
+void TestText::batchAppend()
+{
+    const char *sources[] = {
+        "The quick brown fox jumps over the lazy dog.",
+        "",
+        "\xEF\xBB\xBFThe dog sleeps, the fox runs away.",
+        "Der schnelle braune Fuchs springt \xC3\xBC""ber den faulen Hund.",
+        "The end."
+    };
+
+    QVector<QByteArray> documents;
+    QString             buffer;
+    QVector<int>        offsets;
+    for (int i = 0; i < 5; i++) {
+        documents.append(QByteArray::fromRawData(sources[i], (int)strlen(sources[i])));
+        offsets.append(buffer.size());
+        buffer.append(QString::fromUtf8(sources[i]).remove(QChar(0xFEFF)));
+    }
+    offsets.append(buffer.size());
+
+    QVector<QStringRef> views;
+    for (int i = 0; i < 5; i++) {
+        views.append(buffer.midRef(offsets.at(i), offsets.at(i + 1) - offsets.at(i)));
+    }
+
+    Text sequential;
+    for (int i = 0; i < documents.size(); i++) {
+        if (!documents.at(i).isEmpty())
+            QCOMPARE(sequential.appendUtf8(documents.at(i)), true);
+    }
+
+    Text single;
+    QCOMPARE(single.appendMany(documents), true);
+
+    Text concurrent;
+    concurrent.setChunkSize(16);
+    QCOMPARE(concurrent.appendMany(documents, 3), true);
+
+    Text strings;
+    strings.setChunkSize(16);
+    QCOMPARE(strings.appendMany(views, 3), true);
+
+    compare_wordforms(single, sequential);
+    compare_wordforms(concurrent, sequential);
+    compare_wordforms(strings, sequential);
+    QCOMPARE(concurrent.documents().offsets(), sequential.documents().offsets());
+    QCOMPARE(strings.documents().offsets(), sequential.documents().offsets());
+    QCOMPARE(concurrent.documents().size(), (qint64)4);
+
+    Text empty;
+    QCOMPARE(empty.appendMany(QVector<QByteArray>() << QByteArray()), false);
+    QCOMPARE(empty.length(), (TextPosition)0);
+}
+
+void TestText::directory()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkdir("sub"));
+
+    const char *names[] = { "a.txt", "b.txt", "c.dat", "empty.txt", "sub/d.txt", "sub/e.txt" };
+    const char *sources[] = {
+        "The quick brown fox",
+        "jumps over the lazy dog.",
+        "Not to be indexed.",
+        "",
+        "The dog sleeps, the fox runs away.",
+        "\xFF\xFEZ\0o\0o\0.\0" // UTF-16LE with a byte order mark
+    };
+    const int sizes[] = { 19, 24, 18, 0, 34, 10 };
+
+    QStringList fnames;
+    for (int i = 0; i < 6; i++) {
+        QFile file(dir.path() + "/" + names[i]);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(sources[i], sizes[i]);
+        file.close();
+        if (QString(names[i]).endsWith(".txt") && sizes[i] > 0)
+            fnames << file.fileName();
+    }
+
+    Text expected;
+    QCOMPARE(expected.appendFiles(fnames, 1), true);
+
+    Text actual;
+    actual.setChunkSize(16);
+    QCOMPARE(actual.appendDirectory(dir.path(), QStringList() << "*.txt", 2), true);
+    compare_wordforms(actual, expected);
+    QCOMPARE(actual.documents().offsets(), expected.documents().offsets());
+    QCOMPARE(actual.wordforms()->findByName("zoo") != NULL, true);
+    QCOMPARE(actual.wordforms()->findByName("indexed") == NULL, true);
+
+    Text missing;
+    QCOMPARE(missing.appendDirectory(dir.path() + "/non-existent"), false);
+}
+
+void TestText::gzipFile()
+{
+    QByteArray contents;
+    for (int i = 0; i < 300; i++) {
+        contents.append("The quick brown fox jumps over the lazy dog, isn't it?\n");
+        contents.append(QString::fromUtf8("Быть может быть, а может и не быть. ").toUtf8());
+        contents.append(QByteArray::number(i)).append(' ');
+    }
+
+    QTemporaryFile plain_file;
+    plain_file.open();
+    plain_file.write(contents);
+    plain_file.close();
+
+    // Two concatenated members, the first one ending in the middle of a token:
+    const int half = contents.size() / 2 + 3;
+    QTemporaryFile gzip_file;
+    gzip_file.open();
+    gzip_file.write(gzip(contents.left(half)));
+    gzip_file.write(gzip(contents.mid(half)));
+    gzip_file.close();
+
+    Text reference;
+    QCOMPARE(reference.appendFile(plain_file.fileName()), true);
+
+    Text text;
+    QCOMPARE(text.appendFile(gzip_file.fileName()), true);
+    compare_wordforms(text, reference);
+
+    Text utf8_text;
+    utf8_text.setUtf8Pipeline(true);
+    QCOMPARE(utf8_text.appendFile(gzip_file.fileName()), true);
+    compare_wordforms(utf8_text, reference);
+
+    Text multiple;
+    QCOMPARE(multiple.appendFiles(QStringList() << gzip_file.fileName() << plain_file.fileName(), 2), true);
+    QCOMPARE(multiple.length(), 2 * reference.length());
+
+    // Gzip-compressed files of a directory are streamed by name:
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QFile::copy(gzip_file.fileName(), dir.path() + "/a.gz"));
+    QVERIFY(QFile::copy(plain_file.fileName(), dir.path() + "/b.txt"));
+
+    Text directory;
+    QCOMPARE(directory.appendDirectory(dir.path(), QStringList(), 2), true);
+    compare_wordforms(directory, multiple);
+    QCOMPARE(directory.documents().offsets(), multiple.documents().offsets());
+
+    // Truncated file:
+    QTemporaryFile truncated_file;
+    truncated_file.open();
+    truncated_file.write(gzip(contents).left(1000));
+    truncated_file.close();
+
+    Text truncated;
+    QCOMPARE(truncated.appendFile(truncated_file.fileName()), false);
+}
+
+void TestText::snapshot()
+{
+    Text text(QLocale("ru"));
+    QCOMPARE(text.append(QString::fromUtf8(
+        "Быть может быть, а может и не быть. The quick brown fox jumps over the lazy dog."
+    )), true);
+    // The index of lexemes is saved as well:
+    text.lexemes()->addPosition("быть", 0);
+
+    QTemporaryFile snapshot_file;
+    snapshot_file.open();
+    snapshot_file.close();
+    QCOMPARE(text.save(snapshot_file.fileName()), true);
+
+    Text loaded;
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    compare_wordforms(loaded, text);
+    QCOMPARE(loaded.lexemes()->size(), 1);
+    QCOMPARE(loaded.lexemes()->positions("быть")->size(), 1);
+    QCOMPARE(loaded.lexemes()->findByPosition(0)->name(), QString::fromUtf8("быть"));
+
+    // Appending continues after the loaded text:
+    QCOMPARE(loaded.append("fox"), true);
+    QCOMPARE(loaded.length(), text.length() + 1);
+    QCOMPARE(loaded.wordforms()->positions("fox")->size(), 2);
+
+    Text empty;
+    QCOMPARE(empty.save(snapshot_file.fileName()), true);
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    QCOMPARE(loaded.length(), (TextPosition)0);
+
+    // Malformed snapshots leave the text unchanged:
+    QTemporaryFile bad_file;
+    bad_file.open();
+    bad_file.write("The quick brown fox");
+    bad_file.close();
+    QCOMPARE(text.load(bad_file.fileName()), false);
+    QCOMPARE(text.load("non-existent.snapshot"), false);
+
+    QCOMPARE(text.save(snapshot_file.fileName()), true);
+    QFile truncated_file(snapshot_file.fileName());
+    QCOMPARE(truncated_file.resize(truncated_file.size() - 4), true);
+    QCOMPARE(loaded.load(snapshot_file.fileName()), false);
+    QCOMPARE(loaded.length(), (TextPosition)0);
+    QCOMPARE(text.wordforms()->findByName("fox") != NULL, true);
+}
+
+void TestText::publishedSnapshot()
+{
+    Text text;
+    QCOMPARE(text.snapshot().isNull(), true);
+
+    QCOMPARE(text.append("The quick brown fox jumps."), true);
+    QSharedPointer<const TextSnapshot> first = text.publish();
+    QCOMPARE(first->generation(), (quint64)1);
+    QCOMPARE(text.snapshot() == first, true);
+
+    QCOMPARE(text.append("The lazy dog sleeps."), true);
+    QCOMPARE(first->length(), (TextPosition)6);
+    QCOMPARE(first->wordforms()->findByName("dog") == NULL, true);
+    QCOMPARE(first->wordforms()->postings("the").size(), 1);
+    QCOMPARE(first->wordforms()->findByName(".")->isBoundary(), true);
+
+    QSharedPointer<const TextSnapshot> second = text.publish();
+    QCOMPARE(second->generation(), (quint64)2);
+    QCOMPARE(second->length(), text.length());
+    QCOMPARE(second->wordforms()->postings("the").size(), 2);
+    QCOMPARE(second->wordforms()->numCopiedPositions(), (qint64)(second->length() - first->length()));
+    QCOMPARE(text.snapshot() == second, true);
+
+    // Publishing copies only positions appended since the previous snapshot:
+    QString long_text;
+    for (int i = 0; i < 1000; i++) {
+        long_text += "The quick brown fox jumps over the lazy dog. ";
+    }
+    QCOMPARE(text.append(long_text), true);
+    QSharedPointer<const TextSnapshot> third = text.publish();
+    QCOMPARE(text.append("The end."), true);
+    QSharedPointer<const TextSnapshot> fourth = text.publish();
+    QCOMPARE(fourth->wordforms()->numCopiedPositions(), (qint64)3);
+    QCOMPARE(fourth->wordforms()->postings("the").size(), 2003);
+    QCOMPARE(fourth->wordforms()->findByPosition(fourth->length() - 2)->name(), QString("end"));
+    QCOMPARE(third->wordforms()->postings("the").size(), 2002);
+    QCOMPARE(third->wordforms()->findByName("end") == NULL, true);
+    QCOMPARE(fourth->boundaries().size(), fourth->length());
+    QCOMPARE(fourth->boundaries().isBoundary(fourth->length() - 1), true);
+
+    // Pinned snapshots outlive the text:
+    QCOMPARE(first->wordforms()->findByPosition(3)->name(), QString("fox"));
+    QCOMPARE(first->wordforms()->postings("the").size(), 1);
+}
+
+void TestText::documents()
+{
+    QTemporaryFile text_file;
+    text_file.open();
+    text_file.write("The lazy dog sleeps.");
+    text_file.close();
+
+    Text text;
+    QCOMPARE(text.documents().size(), (qint64)0);
+    QCOMPARE(text.append("The quick brown fox"), true);                      // 0..3
+    QCOMPARE(text.append(QString()), false);
+    QCOMPARE(text.appendUtf8(QByteArray("jumps over the fox.")), true);      // 4..8
+    QCOMPARE(text.appendFile("non-existent.txt"), false);
+    QCOMPARE(text.appendFiles(QStringList() << text_file.fileName()), true); // 9..13
+
+    const DocumentTable &documents = text.documents();
+    QCOMPARE(documents.size(), (qint64)3);
+    QCOMPARE(documents.offset(1), (TextPosition)4);
+    QCOMPARE(documents.offset(2), (TextPosition)9);
+    QCOMPARE(documents.find(0), (qint64)0);
+    QCOMPARE(documents.find(8), (qint64)1);
+    QCOMPARE(documents.find(13), (qint64)2);
+    QCOMPARE(documents.spans(2, 2), false);
+    QCOMPARE(documents.spans(3, 2), true);
+
+    QCOMPARE(text.wordforms()->positions("the")->size(), 3);
+    QCOMPARE(text.documentFrequency("the"), (qint64)3);
+    QCOMPARE(text.documentFrequency("fox"), (qint64)2);
+    QCOMPARE(text.documentFrequency("."), (qint64)2);
+    QCOMPARE(text.documentFrequency("cat"), (qint64)0);
+
+    QVector<DocumentTable::Shard> shards = text.shards(2);
+    QCOMPARE(shards.size(), 2);
+    QCOMPARE(shards.at(0).first_document, (qint64)0);
+    QCOMPARE(shards.at(0).num_documents, (qint64)2);
+    QCOMPARE(shards.at(0).length, (TextPosition)9);
+    QCOMPARE(shards.at(1).first_document, (qint64)2);
+    QCOMPARE(shards.at(1).offset, (TextPosition)9);
+    QCOMPARE(shards.at(1).length, (TextPosition)5);
+    QCOMPARE(text.shards(10).size(), 3);
+    QCOMPARE(text.shards(1).at(0).length, text.length());
+
+    // Documents are published and saved along with the indeces:
+    QCOMPARE(text.publish()->documents().offsets(), documents.offsets());
+
+    QTemporaryFile snapshot_file;
+    snapshot_file.open();
+    snapshot_file.close();
+    QCOMPARE(text.save(snapshot_file.fileName()), true);
+
+    Text loaded;
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    QCOMPARE(loaded.documents().offsets(), documents.offsets());
+}
+
+void TestText::boundaries()
+{
+    Text text;
+    QCOMPARE(text.append("The quick, brown fox."), true);            // 0..5
+    QCOMPARE(text.appendUtf8(QByteArray("Jumps over, the dog")), true); // 6..10
+    QCOMPARE(text.boundaries().size(), text.length());
+
+    const BoundaryMap &boundaries = text.boundaries();
+    QCOMPARE(boundaries.isBoundary(2), true);
+    QCOMPARE(boundaries.isBoundary(3), false);
+    QCOMPARE(boundaries.hasBoundaries(0, 2), false);
+    QCOMPARE(boundaries.hasBoundaries(1, 2), true);
+    QCOMPARE(boundaries.hasBoundaries(3, 2), false);
+    QCOMPARE(boundaries.hasBoundaries(3, 3), true);
+    QCOMPARE(boundaries.hasBoundaries(9, 2), false);
+    QCOMPARE(boundaries.hasBoundaries(10, 2), true);
+    QCOMPARE(boundaries.hasBoundaries(-1, 2), true);
+
+    // Runs longer than the saturation limit are checked bit by bit:
+    Text long_text;
+    QString sentence;
+    for (int i = 0; i < BOUNDARY_MAP_MAX_RUN + 10; i++) {
+        sentence.append("word ");
+    }
+    QCOMPARE(long_text.append(sentence + "."), true);
+    QCOMPARE(long_text.boundaries().hasBoundaries(0, BOUNDARY_MAP_MAX_RUN + 10), false);
+    QCOMPARE(long_text.boundaries().hasBoundaries(1, BOUNDARY_MAP_MAX_RUN + 10), true);
+
+    QTemporaryFile snapshot_file;
+    snapshot_file.open();
+    snapshot_file.close();
+    QCOMPARE(text.save(snapshot_file.fileName()), true);
+
+    Text loaded;
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    QCOMPARE(loaded.boundaries().size(), text.length());
+    for (int i = 0; i < text.length(); i++) {
+        QCOMPARE(loaded.boundaries().isBoundary(i), boundaries.isBoundary(i));
+    }
+    QCOMPARE(text.publish()->boundaries().hasBoundaries(1, 2), true);
+}
+
+void TestText::lemmatizer()
+{
+    QTemporaryFile transducer_source;
+    transducer_source.open();
+    transducer_source.write("dogs\tdog\n");
+    transducer_source.write("sleeps\tsleep\n");
+    transducer_source.write("slept\tsleep\n");
+    transducer_source.write("these\tthis\n");
+    transducer_source.write("os\tbone\n");
+    transducer_source.close();
+
+    TransducerManager lemmas;
+    QCOMPARE(lemmas.build(transducer_source.fileName(), 10), true);
+    TransducerLemmatizer lemmatizer(lemmas.transducer());
+    QCOMPARE(lemmatizer.lemmatize("dogs"), QString("dog"));
+    QCOMPARE(lemmatizer.lemmatize("cats").isEmpty(), true);
+
+    Text text;
+    QCOMPARE(text.lemmatizer() == NULL, true);
+    text.setLemmatizer(&lemmatizer);
+    QCOMPARE(text.append("Dogs sleeps, the dog slept."), true);      // 0..6
+    QCOMPARE(text.appendUtf8(QByteArray("The dogs sleeps.")), true); // 7..10
+    QCOMPARE(text.appendFiles(QStringList() << transducer_source.fileName()), true);
+
+    LexemeIndex *lexemes = text.lexemes();
+    QCOMPARE(lexemes->numUniquePositions(), text.length());
+    QCOMPARE(lexemes->positions("dog")->size(), 5);
+    QCOMPARE(lexemes->positions("sleep")->size(), 7);
+    QCOMPARE(lexemes->positions("the")->size(), 2);
+    QCOMPARE(lexemes->findByName("dogs") == NULL, true);
+    QCOMPARE(lexemes->findByName(",")->isBoundary(), true);
+    QCOMPARE(lexemes->findByPosition(5)->name(), QString("sleep"));
+    QCOMPARE(text.wordforms()->findByPosition(5)->name(), QString("slept"));
+
+    // Lemmas get features of their own besides those of their wordforms
+    Text stopwords;
+    stopwords.setStopwords(QStringList() << "this");
+    stopwords.setLemmatizer(&lemmatizer);
+    QCOMPARE(stopwords.append("These dogs sleep."), true);
+    QCOMPARE(stopwords.wordforms()->findByName("these")->features(), (quint8)Lexeme::FEATURE_CAPITALIZED);
+    QCOMPARE(stopwords.lexemes()->findByName("this")->features(),
+             (quint8)(Lexeme::FEATURE_STOPWORD | Lexeme::FEATURE_CAPITALIZED));
+
+    // Features describing the key are not passed from wordforms to lemmas
+    QCOMPARE(stopwords.append("Os 42."), true);
+    QCOMPARE(stopwords.wordforms()->findByName("os")->features(),
+             (quint8)(Lexeme::FEATURE_SHORT | Lexeme::FEATURE_CAPITALIZED));
+    QCOMPARE(stopwords.lexemes()->findByName("bone")->features(), (quint8)Lexeme::FEATURE_CAPITALIZED);
+    QCOMPARE(stopwords.lexemes()->findByName("42")->features(),
+             (quint8)(Lexeme::FEATURE_NUMERIC | Lexeme::FEATURE_SHORT));
+    QCOMPARE(stopwords.lexemes()->findByName(".")->isBoundary(), true);
+}
+
+void TestText::stats()
+{
+    Text text;
+    QCOMPARE(text.stats().bytes_read, (qint64)0);
+
+    QCOMPARE(text.append("The quick brown fox jumps over the lazy dog."), true);
+    QCOMPARE(text.stats().tokens - text.stats().whitespace_tokens, (qint64)10);
+    QCOMPARE(text.stats().whitespace_tokens, (qint64)8);
+    QCOMPARE(text.stats().new_wordforms, (qint64)9);
+    QCOMPARE(text.stats().new_lexemes, (qint64)0);
+
+    QTemporaryFile text_file;
+    text_file.open();
+    text_file.write("The dog sleeps.");
+    text_file.close();
+
+    QSignalSpy spy(&text, SIGNAL(appendStatusUpdate(qint64, qint64)));
+    text.resetStats();
+    QCOMPARE(text.appendFile(text_file.fileName()), true);
+    QCOMPARE(text.stats().bytes_read, (qint64)15);
+    QCOMPARE(text.stats().tokens - text.stats().whitespace_tokens, (qint64)4);
+    QCOMPARE(text.stats().new_wordforms, (qint64)1);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toLongLong(), (qint64)15);
+    QCOMPARE(spy.at(0).at(1).toLongLong(), (qint64)text.length());
+
+    Text concurrent;
+    QCOMPARE(concurrent.appendFiles(QStringList() << text_file.fileName() << text_file.fileName(), 2), true);
+    QCOMPARE(concurrent.stats().bytes_read, (qint64)30);
+    QCOMPARE(concurrent.stats().tokens - concurrent.stats().whitespace_tokens, (qint64)8);
+    QCOMPARE(concurrent.stats().new_wordforms, (qint64)4);
+    QCOMPARE(concurrent.stats().tokensPerSecond() > 0.0, true);
+}
+
+void TestText::features()
+{
+    const char *source = "The dog ate 3.14 pies, the o'clock bell. Dog food is OK.";
+
+    Text sequential;
+    sequential.setStopwords(QStringList() << "the" << "IS");
+    QCOMPARE(sequential.append(QString(source)), true);
+
+    LexemeIndex *index = sequential.wordforms();
+    QCOMPARE(index->findByName("the")->features(),
+             (quint8)(Lexeme::FEATURE_STOPWORD | Lexeme::FEATURE_CAPITALIZED));
+    QCOMPARE(index->findByName("is")->features(), (quint8)(Lexeme::FEATURE_STOPWORD | Lexeme::FEATURE_SHORT));
+    QCOMPARE(index->findByName("dog")->hasAnyFeature(Lexeme::FEATURE_CAPITALIZED), true);
+    QCOMPARE(index->findByName("ate")->features(), (quint8)0);
+    QCOMPARE(index->findByName("3.14")->hasAnyFeature(Lexeme::FEATURE_NUMERIC), true);
+    QCOMPARE(index->findByName("o'clock")->features(), (quint8)Lexeme::FEATURE_PUNCTUATION);
+    QCOMPARE(index->findByName("ok")->hasAnyFeature(Lexeme::FEATURE_CAPITALIZED | Lexeme::FEATURE_SHORT), true);
+    QCOMPARE(index->findByName(",")->features(),
+             (quint8)(Lexeme::FEATURE_BOUNDARY | Lexeme::FEATURE_PUNCTUATION | Lexeme::FEATURE_SHORT));
+
+    // Features are the same whichever way the input is indexed
+    Text utf8;
+    utf8.setStopwords(QStringList() << "the" << "is");
+    QCOMPARE(utf8.appendUtf8(QByteArray(source)), true);
+
+    QTemporaryFile text_file;
+    text_file.open();
+    text_file.write(source);
+    text_file.close();
+
+    Text concurrent;
+    concurrent.setStopwords(QStringList() << "the" << "is");
+    QCOMPARE(concurrent.appendFiles(QStringList() << text_file.fileName(), 2), true);
+
+    Text late;
+    QCOMPARE(late.append(QString(source)), true);
+    QCOMPARE(late.wordforms()->findByName("the")->hasAnyFeature(Lexeme::FEATURE_STOPWORD), false);
+    late.setStopwords(QStringList() << "the" << "is");
+
+    Text *texts[] = { &utf8, &concurrent, &late };
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(texts[i]->wordforms()->size(), index->size());
+        QHash<QString, Lexeme*>::const_iterator it;
+        for (it = index->lexemes()->constBegin(); it != index->lexemes()->constEnd(); ++it) {
+            QCOMPARE(texts[i]->wordforms()->findByName(it.key())->features(), it.value()->features());
+        }
+    }
+
+    QTemporaryFile snapshot_file;
+    snapshot_file.open();
+    snapshot_file.close();
+    QCOMPARE(sequential.save(snapshot_file.fileName()), true);
+    Text loaded;
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    QCOMPARE(loaded.wordforms()->findByName("the")->features(), index->findByName("the")->features());
+}
+
+void TestText::externalBuild()
+{
+    const char *sources[] = {
+        "The quick brown fox jumps over the lazy dog.",
+        "The dog sleeps, the fox runs away.",
+        "A Fox is not a dog."
+    };
+
+    Text expected;
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(expected.append(QString(sources[i])), true);
+    }
+
+    QTemporaryDir segment_dir;
+    QVERIFY(segment_dir.isValid());
+
+    Text text;
+    IndexBuilder builder(&text, segment_dir.path(), 1 /* flush after every input */);
+    for (int i = 0; i < 3; i++) {
+        QCOMPARE(builder.append(QString(sources[i])), true);
+    }
+    QCOMPARE(builder.numSegments(), 3);
+    QCOMPARE(text.length(), (TextPosition)0);
+
+    QTemporaryFile snapshot_file;
+    snapshot_file.open();
+    snapshot_file.close();
+    QCOMPARE(builder.finish(snapshot_file.fileName()), true);
+    QCOMPARE(builder.numSegments(), 0);
+    QCOMPARE(QDir(segment_dir.path()).entryList(QDir::Files).size(), 0);
+
+    Text loaded;
+    QCOMPARE(loaded.load(snapshot_file.fileName()), true);
+    compare_wordforms(loaded, expected);
+    QCOMPARE(loaded.documents().offsets(), expected.documents().offsets());
+    QCOMPARE(loaded.wordforms()->findByName("fox")->features(), expected.wordforms()->findByName("fox")->features());
+    QCOMPARE(loaded.wordforms()->positions("dog")->size(), 3);
+
+    Extractor actual_extractor(loaded.wordforms());
+    Extractor expected_extractor(expected.wordforms());
+    QCOMPARE(actual_extractor.extract(), true);
+    QCOMPARE(expected_extractor.extract(), true);
+    QCOMPARE(actual_extractor.extracted()->size(), expected_extractor.extracted()->size());
+
+    // A single input larger than the budget is split into segments between buffers:
+    QTemporaryFile large_file;
+    large_file.open();
+    for (int i = 0; i < 20000; i++) {
+        large_file.write("The dog sleeps, the fox runs away. ");
+    }
+    large_file.close();
+
+    Text large_expected;
+    QCOMPARE(large_expected.appendFile(large_file.fileName()), true);
+    QCOMPARE(large_expected.append(QString(sources[0])), true);
+
+    Text large_text;
+    IndexBuilder large_builder(&large_text, segment_dir.path(), 1);
+    QCOMPARE(large_text.segmentWriter(), static_cast<AbstractSegmentWriter*>(&large_builder));
+    QCOMPARE(large_builder.appendFile(large_file.fileName()), true);
+    QVERIFY(large_builder.numSegments() > 1);
+    QCOMPARE(large_builder.append(QString(sources[0])), true);
+    QCOMPARE(large_builder.finish(snapshot_file.fileName()), true);
+
+    Text large_loaded;
+    QCOMPARE(large_loaded.load(snapshot_file.fileName()), true);
+    compare_wordforms(large_loaded, large_expected);
+    QCOMPARE(large_loaded.documents().offsets(), large_expected.documents().offsets());
+}
+
+void TestText::deduplication()
+{
+    const char *sources[] = {
+        "The quick brown fox jumps over the lazy dog near the river bank.",
+        "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG NEAR THE RIVER BANK.",
+        "A completely different sentence about cats and mice.",
+        "The  quick brown fox\njumps over the lazy dog near the river bank."
+    };
+
+    QVector<QByteArray> documents;
+    for (int i = 0; i < 4; i++) {
+        documents.append(QByteArray(sources[i]));
+    }
+
+    Text expected;
+    QCOMPARE(expected.append(QString(sources[0])), true);
+    QCOMPARE(expected.append(QString(sources[2])), true);
+
+    DuplicateDetector detector;
+    Text sequential;
+    sequential.setDuplicateDetector(&detector);
+    for (int i = 0; i < 4; i++) {
+        QCOMPARE(sequential.append(QString(sources[i])), true);
+    }
+    compare_wordforms(sequential, expected);
+    QCOMPARE(sequential.documents().offsets(), expected.documents().offsets());
+    QCOMPARE(sequential.stats().duplicate_documents, (qint64)2);
+    QCOMPARE(sequential.stats().duplicate_tokens, (qint64)28);
+    QCOMPARE(detector.numDocuments(), 4);
+    QCOMPARE(detector.numDuplicates(), 2);
+
+    DuplicateDetector concurrent_detector;
+    Text concurrent;
+    concurrent.setDuplicateDetector(&concurrent_detector);
+    concurrent.setChunkSize(16);
+    QCOMPARE(concurrent.appendMany(documents, 3), true);
+    compare_wordforms(concurrent, expected);
+    QCOMPARE(concurrent.documents().offsets(), expected.documents().offsets());
+    QCOMPARE(concurrent.stats().duplicate_documents, (qint64)2);
+
+    // UTF-8 and decoded keys are hashed the same way
+    QCOMPARE(concurrent.appendUtf8(QByteArray("A completely different sentence about cats and mice.")), true);
+    QCOMPARE(concurrent.stats().duplicate_documents, (qint64)3);
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(sources[1]);
+    file.close();
+    QCOMPARE(concurrent.appendFile(file.fileName()), true);
+    QCOMPARE(concurrent.stats().duplicate_documents, (qint64)4);
+    QCOMPARE(concurrent.documents().size(), (qint64)2);
+
+    // Bytes of a file read through a descriptor are counted before decoding
+    QTemporaryFile utf8_file;
+    QVERIFY(utf8_file.open());
+    utf8_file.write(QString::fromUtf8("Ёж и ёлка.").toUtf8());
+    utf8_file.close();
+
+    DuplicateDetector descriptor_detector;
+    Text descriptor;
+    descriptor.setDuplicateDetector(&descriptor_detector);
+    FILE *fd = fopen(utf8_file.fileName().toLocal8Bit().constData(), "r");
+    QVERIFY(fd != NULL);
+    QCOMPARE(descriptor.appendFile(fd), true);
+    fclose(fd);
+    QCOMPARE(descriptor.stats().bytes_read, utf8_file.size());
 }
 
 void TestText::appendFromNonExistentFile()
@@ -110,10 +931,10 @@ void TestText::nonEnglishLocale()
     )), true);
     // Expected unique values in the index: "быть" "может" "," "а" "и" "не" "." "она"
 
-    QCOMPARE(text.length(), 29);
+    QCOMPARE(text.length(), (TextPosition)29);
 
     LexemeIndex *index = text.wordforms();
-    QCOMPARE(index->numUniquePositions(), 29);
+    QCOMPARE(index->numUniquePositions(), (TextPosition)29);
     QCOMPARE(index->size(), 8);
 
     Lexeme *lexeme1 = index->findByPosition( 0);
@@ -126,16 +947,48 @@ void TestText::nonEnglishLocale()
     QCOMPARE(index->findByName(".")->isBoundary(), true);
     QCOMPARE(index->findByName(",")->isBoundary(), true);
 
-    QVector<int> *positions1 = index->positions(index->findByPosition(0)->name());
-    QVector<int> *positions2 = index->positions("быть");
+    const QVector<TextPosition> *positions1 = index->positions(index->findByPosition(0)->name());
+    const QVector<TextPosition> *positions2 = index->positions("быть");
     QCOMPARE(positions1 == positions2, true);
     QCOMPARE(index->positions(".")->size(), 3);
-    QCOMPARE(index->positions(".")->at(0),  9);
-    QCOMPARE(index->positions(".")->at(1), 19);
-    QCOMPARE(index->positions(".")->at(2), 28);
+    QCOMPARE(index->positions(".")->at(0),  (TextPosition)9);
+    QCOMPARE(index->positions(".")->at(1), (TextPosition)19);
+    QCOMPARE(index->positions(".")->at(2), (TextPosition)28);
     QCOMPARE(index->positions("она")->size(),  2);
-    QCOMPARE(index->positions("она")->at(0), 14);
-    QCOMPARE(index->positions("она")->at(1), 24);
+    QCOMPARE(index->positions("она")->at(0), (TextPosition)14);
+    QCOMPARE(index->positions("она")->at(1), (TextPosition)24);
+}
+
+//! Checks that two texts have the same wordforms at the same positions.
+void TestText::compare_wordforms(const Text &actual, const Text &expected)
+{
+    QCOMPARE(actual.length(), expected.length());
+    QCOMPARE(actual.wordforms()->size(), expected.wordforms()->size());
+    for (int i = 0; i < expected.length(); i++) {
+        Lexeme *expected_lexeme = expected.wordforms()->findByPosition(i);
+        Lexeme *actual_lexeme   = actual.wordforms()->findByPosition(i);
+        QCOMPARE(actual_lexeme->name()      , expected_lexeme->name());
+        QCOMPARE(actual_lexeme->isBoundary(), expected_lexeme->isBoundary());
+    }
+}
+
+//! Compresses data to a single gzip member.
+QByteArray TestText::gzip(const QByteArray &data)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    QByteArray compressed(deflateBound(&stream, data.size()), Qt::Uninitialized);
+    stream.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in  = data.size();
+    stream.next_out  = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = compressed.size();
+    deflate(&stream, Z_FINISH);
+    compressed.resize(compressed.size() - stream.avail_out);
+    deflateEnd(&stream);
+
+    return compressed;
 }
 
 QTEST_MAIN(TestText)
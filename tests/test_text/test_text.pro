@@ -5,3 +5,4 @@
 include(../test_qubiq.pri)
 
 SOURCES = test_text.cpp
+LIBS   += -lz
@@ -0,0 +1,235 @@
+#include <QtTest/QtTest>
+
+#include <qubiq/tokenizer.h>
+
+class TestTokenizer: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyBuffer();
+    void simpleSentence();
+    void tokenClasses();
+    void sameAsBoundaryFinder();
+    void incompleteBuffer();
+    void lowerLatin1();
+    void lowerAscii();
+    void utf8SameAsUtf16();
+    void incompleteUtf8Buffer();
+
+private:
+    QStringList sample_buffers();
+    QStringList reference_tokens(const QString &buffer);
+    QStringList tokens(const QString &buffer);
+    QStringList utf8_tokens(const QByteArray &buffer);
+};
+
+void TestTokenizer::emptyBuffer()
+{
+    Tokenizer tokenizer;
+    QVector<Tokenizer::Token> tokens;
+
+    QCOMPARE(tokenizer.tokenize(QString(), true, &tokens), 0);
+    QCOMPARE(tokens.size(), 0);
+}
+
+void TestTokenizer::simpleSentence()
+{
+    QStringList expected;
+    expected << "The" << "quick" << "brown" << "fox" << "isn't" << "3.14" << "e.g" << "." << "lazy_dog" << "!";
+
+    QCOMPARE(tokens("The quick brown fox isn't 3.14 e.g. lazy_dog!"), expected);
+}
+
+void TestTokenizer::tokenClasses()
+{
+    Tokenizer tokenizer;
+    QString buffer("Dog , ... \t\n 1,000 __ ?!");
+    QVector<Tokenizer::Token> tokens;
+
+    QCOMPARE(tokenizer.tokenize(buffer, true, &tokens), buffer.length());
+    QCOMPARE(tokens.size(), 14);
+
+    QCOMPARE(tokens.at( 0).text.toString(), QString("Dog"));
+    QCOMPARE(tokens.at( 0).type, Tokenizer::TOKEN_WORD);
+    QCOMPARE(tokens.at( 1).type, Tokenizer::TOKEN_WHITESPACE);
+    QCOMPARE(tokens.at( 2).text.toString(), QString(","));
+    QCOMPARE(tokens.at( 2).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at( 4).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at( 5).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at( 6).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at( 7).text.toString(), QString(" \t\n "));
+    QCOMPARE(tokens.at( 7).type, Tokenizer::TOKEN_WHITESPACE);
+    QCOMPARE(tokens.at( 8).text.toString(), QString("1,000"));
+    QCOMPARE(tokens.at( 8).type, Tokenizer::TOKEN_WORD);
+    QCOMPARE(tokens.at(10).text.toString(), QString("__"));
+    QCOMPARE(tokens.at(10).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at(12).type, Tokenizer::TOKEN_BOUNDARY);
+    QCOMPARE(tokens.at(13).type, Tokenizer::TOKEN_BOUNDARY);
+
+    for (int i = 0; i < tokens.size(); i++) {
+        QCOMPARE(tokens.at(i).type, Tokenizer::classify(tokens.at(i).text));
+    }
+}
+
+void TestTokenizer::sameAsBoundaryFinder()
+{
+    QStringList buffers = sample_buffers();
+    for (int i = 0; i < buffers.size(); i++) {
+        QCOMPARE(tokens(buffers.at(i)), reference_tokens(buffers.at(i)));
+    }
+}
+
+void TestTokenizer::utf8SameAsUtf16()
+{
+    QStringList buffers = sample_buffers();
+    for (int i = 0; i < buffers.size(); i++) {
+        QCOMPARE(utf8_tokens(buffers.at(i).toUtf8()), tokens(buffers.at(i)));
+    }
+
+    Tokenizer tokenizer;
+    QByteArray buffer("Dog , 1,000 ?!");
+    QVector<Tokenizer::Utf8Token> utf8_tokens;
+    QVector<Tokenizer::Token>     tokens;
+    tokenizer.tokenizeUtf8(buffer.constData(), buffer.size(), true, &utf8_tokens);
+    tokenizer.tokenize(QString::fromUtf8(buffer), true, &tokens);
+    QCOMPARE(utf8_tokens.size(), tokens.size());
+    for (int i = 0; i < tokens.size(); i++) {
+        QCOMPARE(utf8_tokens.at(i).type, tokens.at(i).type);
+    }
+}
+
+void TestTokenizer::incompleteUtf8Buffer()
+{
+    Tokenizer tokenizer;
+    QVector<Tokenizer::Utf8Token> tokens;
+
+    // "Très café" cut in the middle of "é":
+    QByteArray buffer("Tr\xC3\xA8s caf\xC3");
+    QCOMPARE(tokenizer.tokenizeUtf8(buffer.constData(), buffer.size(), false, &tokens), 6);
+    QCOMPARE(tokens.size(), 2);
+    QCOMPARE(QString::fromUtf8(tokens.at(0).data, tokens.at(0).size), QString::fromUtf8("Tr\xC3\xA8s"));
+}
+
+//! Returns buffers covering various tokenization rules.
+QStringList TestTokenizer::sample_buffers()
+{
+    QStringList buffers;
+    buffers
+        << "A database connection string is a special format string."
+        << "Numbers: 1,000.50 and 3.14; ratios 1:2, versions 2.0.1"
+        << "Apostrophes: don't, rock'n'roll, ’quoted’ and it’s"
+        << "Быть может быть, а может и не быть. ΚΑΛΗΜΕΡΑ κόσμε!"
+        << "Combining: cafe\xCC\x81 and soft\xC2\xADhyphen"
+        << "Mixed scripts: 東京 is in 日本, שלום and \xF0\x9F\x98\x80 emoji"
+        << "Edge cases: a.1 1.a _x x_ a..b 1,,2 :a a: 'a a' (x)"
+        << "Long words: Antidisestablishmentarianism internationalization's 12345678901234567890.5"
+        << "Long joins: abcdefghijklmnopq_rstuvwxyz0123456789 abcdefghijklmnopqrstuvwxyzабв"
+    ;
+    return buffers;
+}
+
+void TestTokenizer::incompleteBuffer()
+{
+    Tokenizer tokenizer;
+    QString buffer("The quick bro");
+    QVector<Tokenizer::Token> tokens;
+
+    QCOMPARE(tokenizer.tokenize(buffer, false, &tokens), 10);
+    QCOMPARE(tokens.size(), 4);
+    QCOMPARE(tokens.at(2).text.toString(), QString("quick"));
+
+    tokens.clear();
+    buffer = QString("e.g. the");
+    QCOMPARE(tokenizer.tokenize(buffer, false, &tokens), 5);
+    QCOMPARE(tokens.size(), 3);
+    QCOMPARE(tokens.at(0).text.toString(), QString("e.g"));
+    QCOMPARE(tokens.at(1).text.toString(), QString("."));
+
+    tokens.clear();
+    buffer = QString("trailing   ");
+    QCOMPARE(tokenizer.tokenize(buffer, false, &tokens), 8);
+    QCOMPARE(tokens.size(), 1);
+}
+
+void TestTokenizer::lowerLatin1()
+{
+    QStringList strings;
+    strings
+        << "" << "ABC" << "Straße" << "ÀÉÎÕÜ×ÞÿµØ"
+        << "The Quick Brown Fox Jumps Over The Lazy Dog, ÇA VA?"
+    ;
+
+    for (int i = 0; i < strings.size(); i++) {
+        const QString &s = strings.at(i);
+        QString lowered(s.length(), Qt::Uninitialized);
+        QCOMPARE(Tokenizer::toLowerLatin1(s.unicode(), s.length(), lowered.data()), true);
+        QCOMPARE(lowered, s.toLower());
+    }
+
+    QString s("Latin-1 followed by Cyrillic: ЖЁЛТЫЙ");
+    QString lowered(s.length(), Qt::Uninitialized);
+    QCOMPARE(Tokenizer::toLowerLatin1(s.unicode(), s.length(), lowered.data()), false);
+}
+
+void TestTokenizer::lowerAscii()
+{
+    QByteArray s("The Quick Brown Fox Jumps Over The Lazy Dog, [AT] 10:45 @Z!");
+    QByteArray lowered(s.size(), '\0');
+    QCOMPARE(Tokenizer::toLowerAscii(s.constData(), s.size(), lowered.data()), true);
+    QCOMPARE(lowered, s.toLower());
+
+    QByteArray non_ascii("ASCII followed by UTF-8 encoded text: \xC3\x89T\xC3\x89");
+    lowered.resize(non_ascii.size());
+    QCOMPARE(Tokenizer::toLowerAscii(non_ascii.constData(), non_ascii.size(), lowered.data()), false);
+}
+
+//! Returns non-whitespace tokens of a buffer as split by QTextBoundaryFinder.
+QStringList TestTokenizer::reference_tokens(const QString &buffer)
+{
+    QStringList result;
+    QTextBoundaryFinder boundary_finder(QTextBoundaryFinder::Word, buffer);
+    int pos_start = boundary_finder.position();
+    int pos_end   = boundary_finder.toNextBoundary();
+    while (pos_end != -1) {
+        QStringRef token = buffer.midRef(pos_start, pos_end - pos_start);
+        if (!Tokenizer::isWhitespace(token))
+            result << token.toString();
+        pos_start = pos_end;
+        pos_end   = boundary_finder.toNextBoundary();
+    }
+    return result;
+}
+
+//! Returns non-whitespace tokens of a buffer as split by Tokenizer.
+QStringList TestTokenizer::tokens(const QString &buffer)
+{
+    Tokenizer tokenizer;
+    QVector<Tokenizer::Token> tokens;
+    tokenizer.tokenize(buffer, true, &tokens);
+
+    QStringList result;
+    for (int i = 0; i < tokens.size(); i++) {
+        if (tokens.at(i).type != Tokenizer::TOKEN_WHITESPACE)
+            result << tokens.at(i).text.toString();
+    }
+    return result;
+}
+
+//! Returns non-whitespace tokens of a UTF-8 buffer as split by Tokenizer, decoded.
+QStringList TestTokenizer::utf8_tokens(const QByteArray &buffer)
+{
+    Tokenizer tokenizer;
+    QVector<Tokenizer::Utf8Token> tokens;
+    tokenizer.tokenizeUtf8(buffer.constData(), buffer.size(), true, &tokens);
+
+    QStringList result;
+    for (int i = 0; i < tokens.size(); i++) {
+        if (tokens.at(i).type != Tokenizer::TOKEN_WHITESPACE)
+            result << QString::fromUtf8(tokens.at(i).data, tokens.at(i).size);
+    }
+    return result;
+}
+
+QTEST_MAIN(TestTokenizer)
+#include "test_tokenizer.moc"
@@ -0,0 +1,7 @@
+#
+# Tests for class Tokenizer
+#
+
+include(../test_qubiq.pri)
+
+SOURCES = test_tokenizer.cpp
@@ -0,0 +1,113 @@
+#ifndef _COMPRESSED_POSTINGS_H_
+#define _COMPRESSED_POSTINGS_H_
+
+#include <QtCore>
+#include <qubiq/util/qubiqutil_global.h>
+#include <qubiq/util/position_bitmap.h>
+#include <qubiq/util/paged_vector.h>
+
+const int POSTINGS_BLOCK_SIZE = 128; //!< Number of positions in a compressed block
+const int POSITION_PAGE_BITS  = 12;  //!< Pages of positions of frozen indices hold 2^12 positions
+
+//! Positions of a lexeme in a frozen index, pages are shared between frozen copies.
+typedef PagedVector<TextPosition, POSITION_PAGE_BITS> PositionPages;
+
+class QUBIQUTILSHARED_EXPORT CompressedPostings {
+
+public:
+    CompressedPostings();
+    CompressedPostings(const QVector<TextPosition> &positions);
+
+    //! Returns the number of positions.
+    inline int size() const { return _size; }
+
+    //! Returns the number of blocks including the incomplete last one.
+    inline int numBlocks() const { return _blocks.size() + (_tail.isEmpty()? 0 : 1); }
+
+    //! Returns the first position of a block, which can be used for skipping blocks without decoding them.
+    inline TextPosition blockFirst(int block) const {
+        return block < _blocks.size()? _blocks.at(block).first : _tail.at(0);
+    }
+
+    //! Returns the last position, undefined for empty postings.
+    inline TextPosition last() const { return _last; }
+
+    bool         append(TextPosition pos);
+    int          decodeBlock(int block, TextPosition *out) const;
+    int          findBlock(TextPosition target) const;
+    qint64       memoryUsage() const;
+    QVector<TextPosition> toVector() const;
+
+private:
+    //! Block: skip entry of a complete block.
+    struct Block {
+        TextPosition first;       //!< First position of the block
+        quint32      data_offset; //!< Offset of the first data byte of the block
+    };
+
+    QVector<Block>        _blocks;  //!< Skip entries of complete blocks
+    QByteArray            _control; //!< Two bits of length per delta, POSTINGS_BLOCK_SIZE / 4 bytes per block
+    QByteArray            _data;    //!< Deltas of 1 to 4 bytes each, little-endian
+    QVector<TextPosition> _tail;    //!< Uncompressed positions of the incomplete last block
+    TextPosition          _last;
+    int                   _size;
+
+    void encode_tail();
+
+    static void decode_deltas(const uchar *control, const uchar *data, const uchar *data_end, quint32 *out);
+};
+
+/**
+ * \brief The PostingsIterator class iterates positions of a lexeme regardless of their representation.
+ *
+ * Compressed postings and bitmaps are decoded a block at a time into a buffer of the iterator,
+ * and positions of frozen indices are copied into it from their pages.
+ *
+ * \sa LexemeIndex::postings
+ */
+class QUBIQUTILSHARED_EXPORT PostingsIterator {
+
+public:
+    PostingsIterator();
+    PostingsIterator(const QVector<TextPosition> *positions);
+    PostingsIterator(const CompressedPostings *postings);
+    PostingsIterator(const PositionBitmap *bitmap);
+    PostingsIterator(const PositionPages *pages);
+
+    //! Returns the total number of positions.
+    inline int size() const { return _end; }
+
+    //! Returns \c true if there are positions left.
+    inline bool hasNext() const { return _offset < _end; }
+
+    //! Returns the next position and advances the iterator. Must not be called if \c hasNext is \c false.
+    inline TextPosition next() {
+        if (_positions != NULL)
+            return _positions->at(_offset++);
+        if (_offset == _buffer_end)
+            load_next();
+        return _buffer[_offset++ - _buffer_start];
+    }
+
+    bool skipTo(TextPosition target);
+    void seek  (int offset);
+
+private:
+    const QVector<TextPosition> *_positions;
+    const CompressedPostings    *_postings;
+    const PositionBitmap        *_bitmap;
+    const PositionPages         *_pages;
+
+    int          _offset;     //!< Offset of the next position
+    int          _end;        //!< Total number of positions
+    int          _block;      //!< Block of compressed postings held in the buffer
+    TextPosition _resume;     //!< Position to decode the bitmap from once the buffer is exhausted
+    int          _buffer_start;
+    int          _buffer_end;
+    TextPosition _buffer[POSTINGS_BLOCK_SIZE];
+
+    void load_block(int block);
+    void load_next();
+};
+
+#endif // _COMPRESSED_POSTINGS_H_
@@ -4,21 +4,36 @@
 #include <QtCore>
 #include <qubiq/util/qubiqutil_global.h>
 
-// 2DO: describe arbitrary lexeme features as a free-form QHash?
+const int     MAX_SHORT_LEXEME_LENGTH = 2;          //!< Lexemes of at most this many characters are short
+const quint32 INVALID_LEXEME_ID       = 0xFFFFFFFF; //!< ID of lexemes not owned by an index
 
 class QUBIQUTILSHARED_EXPORT Lexeme {
 
+    friend class LexemeIndex;
+
+public:
+    //! LexemeFeature: flags of properties of a lexeme computed once while indexing.
+    enum LexemeFeature {
+        FEATURE_BOUNDARY    = 0x01, //!< Consists of punctuation characters only.
+        FEATURE_NUMERIC     = 0x02, //!< Is a number, like "42" or "3.14".
+        FEATURE_PUNCTUATION = 0x04, //!< Contains punctuation characters, like "e-mail".
+        FEATURE_CAPITALIZED = 0x08, //!< Occurs capitalized in the text at least once.
+        FEATURE_STOPWORD    = 0x10, //!< Is a stopword.
+        FEATURE_SHORT       = 0x20  //!< Is at most \c MAX_SHORT_LEXEME_LENGTH characters long.
+    };
+
 private:
 
     QString _lexeme;
-    bool    _is_boundary;
+    quint8  _features;
+    quint32 _id; //!< Dense ID assigned by the index owning the lexeme
 
     /* Each lexeme is represented in a text as a set of its forms
      * occuring in certain text positions, counted as offsets relative to
      * the first word in the text: */
-    QVector<QString> *_forms;
-    QVector<int>     *_offsets;
-    QHash<int, int>  *_idx_offsets; // Ensure that offsets are unique
+    QVector<QString>         *_forms;
+    QVector<TextPosition>    *_offsets;
+    QHash<TextPosition, int> *_idx_offsets; // Ensure that offsets are unique
 
     void _initialize(const QString &name, bool is_boundary);
     void _destroy();
@@ -35,15 +50,33 @@ public:
 
     inline QString lexeme()     const { return _lexeme; }
     inline QString name()       const { return _lexeme; }
-    inline bool    isBoundary() const { return _is_boundary; }
+    inline bool    isBoundary() const { return (_features & FEATURE_BOUNDARY) != 0; }
     inline bool    isVirtual()  const { return _forms->length() == 0; }
 
+    //! Returns the ID of the lexeme in the index owning it, \c INVALID_LEXEME_ID if there is none.
+    //! \sa LexemeIndex::findById
+    inline quint32 id() const { return _id; }
+
     inline const QVector<QString>* forms() const { return _forms; }
-    inline const QVector<int>*   offsets() const { return _offsets; }
+    inline const QVector<TextPosition>* offsets() const { return _offsets; }
+
+    inline void setIsBoundary(bool is_boundary) {
+        _features = is_boundary? (_features | FEATURE_BOUNDARY) : (_features & ~FEATURE_BOUNDARY);
+    }
+
+    //! Returns the bitmask of \c LexemeFeature flags of the lexeme.
+    inline quint8 features() const { return _features; }
+
+    //! Returns \c true if the lexeme has any of the features in the bitmask \c mask.
+    inline bool hasAnyFeature(quint8 mask) const { return (_features & mask) != 0; }
+
+    //! Sets the bitmask of \c LexemeFeature flags of the lexeme.
+    inline void setFeatures(quint8 features) { _features = features; }
 
-    inline void setIsBoundary(bool is_boundary) { _is_boundary = is_boundary; }
+    //! Adds \c LexemeFeature flags in the bitmask \c features to the lexeme.
+    inline void addFeatures(quint8 features) { _features |= features; }
 
-    bool addForm(const QString &form, int offset, bool overwrite = false);
+    bool addForm(const QString &form, TextPosition offset, bool overwrite = false);
 };
 
 #endif // _LEXEME_H_
@@ -4,6 +4,10 @@
 #include <QtCore>
 #include <qubiq/util/qubiqutil_global.h>
 #include <qubiq/util/lexeme.h>
+#include <qubiq/util/compressed_postings.h>
+
+const int DEFAULT_MIN_COMPRESSED_POSTINGS = 1024;  //!< Lexemes with fewer positions are kept uncompressed
+const int DEFAULT_BITMAP_THRESHOLD        = 0;     //!< Bitmaps are disabled unless a threshold is set
 
 class QUBIQUTILSHARED_EXPORT LexemeIndex {
 
@@ -11,29 +15,125 @@ public:
     LexemeIndex();
     ~LexemeIndex();
 
+    //! Returns the vocabulary of the index, lexemes by name.
     inline QHash<QString, Lexeme*>* lexemes() const { return lex; }
 
-    inline Lexeme* findByPosition(int pos) const { return pos2lex->value(pos, NULL); }
+    inline Lexeme* findByPosition(TextPosition pos) const {
+        const quint32 id = idByPosition(pos);
+        return id != INVALID_LEXEME_ID? id2lex->at(id) : NULL;
+    }
     inline Lexeme* findByName(const QString &name) const { return lex->value(name, NULL); }
-    inline QVector<int>* positions(const QString &name) const { return lex2pos->value(name, NULL); }
 
-    inline int size() const { return lex->keys().size(); }
+    /**
+     * Returns positions of a lexeme, \c NULL if there is no such lexeme, its
+     * positions are compressed or stored as a bitmap, or the index is frozen.
+     *
+     * \sa postings
+     * \sa compress
+     */
+    inline QVector<TextPosition>* positions(const QString &name) const {
+        const Lexeme *lexeme = findByName(name);
+        return lexeme != NULL? positionsById(lexeme->id()) : NULL;
+    }
+
+    //! Returns an iterator over positions of a lexeme in any representation.
+    inline PostingsIterator postings(const QString &name) const {
+        const Lexeme *lexeme = findByName(name);
+        return lexeme != NULL? postingsById(lexeme->id()) : PostingsIterator();
+    }
+
+    //! Returns the lexeme with the given ID, \c NULL if there is none.
+    inline Lexeme* findById(quint32 id) const { return id < (quint64)id2lex->size()? id2lex->at(id) : NULL; }
+
+    //! Returns positions of the lexeme with the given ID, \c NULL if there is none or they are not stored as a vector.
+    inline QVector<TextPosition>* positionsById(quint32 id) const {
+        return id < (quint32)lex2pos->size()? lex2pos->at(id) : NULL;
+    }
+
+    //! Returns an iterator over positions of the lexeme with the given ID in any representation.
+    inline PostingsIterator postingsById(quint32 id) const {
+        if (id < (quint64)frozen_pos->size())
+            return PostingsIterator(&frozen_pos->at(id));
+        if (id >= (quint32)lex2pos->size())
+            return PostingsIterator();
+        if (lex2pos->at(id) != NULL)
+            return PostingsIterator(lex2pos->at(id));
+        return compressed->at(id) != NULL? PostingsIterator(compressed->at(id)) : PostingsIterator(bitmaps->at(id));
+    }
+
+    /**
+     * Returns positions of the lexeme with the given ID as a bitmap, \c NULL if there
+     * is no such lexeme or it is below the bitmap threshold.
+     *
+     * \sa setBitmapThreshold
+     */
+    inline const PositionBitmap* bitmapById(quint32 id) const {
+        return id < (quint32)bitmaps->size()? bitmaps->at(id) : NULL;
+    }
+
+    //! Returns the ID of the lexeme at a position, \c INVALID_LEXEME_ID if the position is not covered.
+    inline quint32 idByPosition(TextPosition pos) const {
+        return (pos >= 0 && pos < pos2lex->size())? pos2lex->at(pos) : INVALID_LEXEME_ID;
+    }
 
-    inline int numUniquePositions() const { return pos2lex->keys().size(); }
+    //! Returns the number of lexemes in the index. IDs of lexemes are less than this value.
+    inline int size() const { return (int)id2lex->size(); }
 
-    Lexeme* addPosition(const QString &name, int pos, bool *is_new = NULL);
-    Lexeme* addPositions(const QString &name, const QVector<int> *pos, bool *is_new = NULL);
+    //! Returns the number of positions covered by the index.
+    inline TextPosition numUniquePositions() const { return num_positions; }
+
+    Lexeme* addPosition(const QString &name, TextPosition pos, bool *is_new = NULL);
+    Lexeme* addPosition(Lexeme *lexeme, TextPosition pos);
+    Lexeme* addPositions(const QString &name, const QVector<TextPosition> *pos, bool *is_new = NULL);
 
     Lexeme* copyFromIndex(const LexemeIndex &other, const QString &name, bool *is_new = NULL);
 
     void merge(const LexemeIndex &other);
 
+    int    compress(int min_size = DEFAULT_MIN_COMPRESSED_POSTINGS);
+    qint64 postingsMemoryUsage() const;
+    qint64 memoryUsage() const;
+
+    //! Returns the number of positions a lexeme is switched to a bitmap at, 0 if bitmaps are disabled.
+    inline int  bitmapThreshold() const { return bitmap_threshold; }
+    void        setBitmapThreshold(int threshold);
+
+    LexemeIndex* freeze(const LexemeIndex *previous = NULL);
+
+    //! Returns \c true for read-only copies made by \c freeze.
+    inline bool isFrozen() const { return is_frozen; }
+
+    //! Returns the number of positions \c freeze copied to make this copy, the other ones are shared with the previous copy.
+    inline qint64 numCopiedPositions() const { return num_copied; }
+
 private:
-    QHash<QString, Lexeme*>       *lex;
-    QHash<QString, QVector<int>*> *lex2pos;
-    QHash<int, Lexeme*>           *pos2lex;
+    typedef QSharedPointer< QVector<Lexeme*> > LexemeBatch;
+
+    QHash<QString, Lexeme*>         *lex;             //!< Vocabulary, lexemes by name
+    PagedVector<Lexeme*, 10>        *id2lex;          //!< Lexemes by ID
+    QVector<QVector<TextPosition>*> *lex2pos;         //!< Positions of lexemes by ID, \c NULL for compressed ones
+    QVector<CompressedPostings*>    *compressed;      //!< Compressed positions of lexemes by ID, \c NULL for uncompressed ones
+    QVector<PositionBitmap*>        *bitmaps;         //!< Positions of frequent lexemes by ID, \c NULL for other ones
+    PagedVector<quint32>            *pos2lex;         //!< IDs of lexemes by position, \c INVALID_LEXEME_ID for positions not covered
+    PagedVector<PositionPages, 10>  *frozen_pos;      //!< Positions of lexemes by ID, used by frozen copies instead of the above
+    QVector<quint32>                *touched;         //!< IDs of lexemes which got positions since the last freeze
+    QVector<quint32>                *touched_at;      //!< Value of \c num_freezes each lexeme was last added to \c touched at
+    QVector<LexemeBatch>             frozen_lexemes;  //!< Lexemes of a frozen copy, shared with later copies
+    TextPosition                     num_positions;   //!< Number of positions covered by the index
+    int                              bitmap_threshold;
+    bool                             is_frozen;
+    quint32                          num_freezes;
+    int                              freeze_serial;   //!< Serial number of the last frozen copy, or of this copy if frozen
+    qint64                           num_copied;
 
-    void init_entry(const QString &name, bool *is_new);
+    Lexeme* init_entry      (const QString &name, bool *is_new);
+    void    add_lexeme      (Lexeme *lexeme);
+    void    set_position    (TextPosition pos, quint32 id);
+    void    append_position (quint32 id, TextPosition pos);
+    void    append_positions(Lexeme *lexeme, PostingsIterator pos);
+    void    switch_to_bitmap(quint32 id);
+    Lexeme* freeze_lexeme   (const Lexeme *lexeme, QVector<Lexeme*> *batch);
+    void    freeze_positions(const LexemeIndex &source, quint32 id);
 };
 
 #endif // _LEXEME_INDEX_H_
@@ -0,0 +1,102 @@
+#ifndef _PAGED_VECTOR_H_
+#define _PAGED_VECTOR_H_
+
+#include <QtCore>
+#include <qubiq/util/qubiqutil_global.h>
+
+/**
+ * \brief The PagedVector class is a vector of elements split into implicitly shared pages.
+ *
+ * Elements are kept in pages of 2^PageBits elements each and addressed by 64-bit
+ * offsets, so the vector is not limited by the size of a single \c QVector.
+ *
+ * Copying a paged vector copies the list of its pages only. Both copies share
+ * the pages until one of them is modified: Appending detaches the last page and
+ * assigning an element detaches the page holding it, so a copy taken from a
+ * growing vector costs the vector a page or two instead of all of its elements.
+ *
+ * \sa LexemeIndex::freeze
+ */
+template <typename T, int PageBits = 16>
+class PagedVector {
+
+public:
+    enum {
+        PAGE_SIZE = 1 << PageBits, //!< Number of elements in a page
+        PAGE_MASK = PAGE_SIZE - 1
+    };
+
+    PagedVector() : _size(0) {}
+
+    //! Returns the number of elements.
+    inline qint64 size() const { return _size; }
+
+    //! Returns \c true if there are no elements.
+    inline bool isEmpty() const { return _size == 0; }
+
+    //! Returns the element at a valid offset.
+    inline const T& at(qint64 i) const { return _pages.at((int)(i >> PageBits)).at((int)(i & PAGE_MASK)); }
+
+    //! Returns the last element of a non-empty vector.
+    inline const T& last() const { return at(_size - 1); }
+
+    //! Returns a modifiable reference to the element at a valid offset, detaching its page if it is shared.
+    inline T& operator[](qint64 i) { return _pages[(int)(i >> PageBits)][(int)(i & PAGE_MASK)]; }
+
+    //! Returns the number of pages, the last one may be incomplete.
+    inline int numPages() const { return _pages.size(); }
+
+    //! Returns elements of a page, all pages but the last one hold \c PAGE_SIZE elements.
+    inline const QVector<T>& page(int i) const { return _pages.at(i); }
+
+    //! Appends an element.
+    inline void append(const T &value) {
+        if ((_size & PAGE_MASK) == 0)
+            _pages.append(QVector<T>());
+        _pages.last().append(value);
+        _size++;
+    }
+
+    //! Appends elements until the vector holds \c size elements.
+    void resize(qint64 size, const T &value = T()) {
+        while (_size < size) {
+            if ((_size & PAGE_MASK) == 0)
+                _pages.append(QVector<T>());
+            const int n = (int)qMin(size - _size, (qint64)PAGE_SIZE - (_size & PAGE_MASK));
+            QVector<T> &last = _pages.last();
+            last.insert(last.size(), n, value);
+            _size += n;
+        }
+    }
+
+    //! Removes all elements.
+    inline void clear() {
+        _pages.clear();
+        _size = 0;
+    }
+
+    //! Returns memory occupied by elements in bytes, including pages shared with other vectors.
+    qint64 memoryUsage() const {
+        qint64 usage = _pages.capacity() * (qint64)sizeof(QVector<T>);
+        for (int i = 0; i < _pages.size(); i++) {
+            usage += _pages.at(i).capacity() * (qint64)sizeof(T);
+        }
+        return usage;
+    }
+
+    //! Returns all elements as a single vector, which must fit into a \c QVector.
+    QVector<T> toVector() const {
+        QVector<T> result;
+        result.reserve((int)_size);
+        for (int i = 0; i < _pages.size(); i++) {
+            result += _pages.at(i);
+        }
+        return result;
+    }
+
+private:
+    QVector< QVector<T> > _pages;
+    qint64                _size;
+};
+
+#endif // _PAGED_VECTOR_H_
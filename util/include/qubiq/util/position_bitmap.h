@@ -0,0 +1,52 @@
+#ifndef _POSITION_BITMAP_H_
+#define _POSITION_BITMAP_H_
+
+#include <QtCore>
+#include <qubiq/util/qubiqutil_global.h>
+
+const int BITMAP_CHUNK_BITS  = 16;   //!< Positions of a container differ in this many lowest bits only
+const int BITMAP_CHUNK_SIZE  = 1 << BITMAP_CHUNK_BITS;
+const int BITMAP_CHUNK_WORDS = BITMAP_CHUNK_SIZE / 64;
+const int BITMAP_MAX_ARRAY   = 4096; //!< Containers with more positions are stored as bitmaps
+
+class QUBIQUTILSHARED_EXPORT PositionBitmap {
+
+public:
+    PositionBitmap();
+
+    //! Returns the number of positions.
+    inline int size() const { return _size; }
+
+    //! Returns the last position, undefined for empty bitmaps.
+    inline TextPosition last() const { return _last; }
+
+    bool           append     (TextPosition pos);
+    bool           contains   (TextPosition pos) const;
+    int            rank       (TextPosition pos) const;
+    TextPosition   select     (int rank) const;
+    int            decode     (TextPosition from, TextPosition *out, int max) const;
+    PositionBitmap intersected(const PositionBitmap &other, TextPosition shift = 0) const;
+    qint64         memoryUsage() const;
+    QVector<TextPosition> toVector() const;
+
+private:
+    //! Container: positions sharing a chunk, either as a sorted array of their lowest bits or as a bitmap.
+    struct Container {
+        TextPosition     chunk; //!< Position of the first bit of the container >> BITMAP_CHUNK_BITS
+        int              rank;  //!< Number of positions in preceding containers
+        int              count; //!< Number of positions in the container
+        QVector<quint16> array; //!< Lowest bits of positions, empty for bitmap containers
+        QVector<quint64> words; //!< BITMAP_CHUNK_WORDS words of bits, empty for array containers
+    };
+
+    QVector<Container> _containers;
+    TextPosition       _last;
+    int                _size;
+
+    int  find_container(TextPosition chunk) const;
+    bool extract_window(TextPosition start, quint64 *words) const;
+
+    static TextPosition chunk_of(TextPosition pos);
+};
+
+#endif // _POSITION_BITMAP_H_
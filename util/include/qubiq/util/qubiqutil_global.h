@@ -9,4 +9,18 @@
 #  define QUBIQUTILSHARED_EXPORT Q_DECL_IMPORT
 #endif
 
+/*
+ * Type of token positions in a text. Texts longer than 2^31 - 1 tokens require
+ * defining QUBIQ_LARGE_TEXTS for all libraries and their clients, which doubles
+ * the memory occupied by positions. Maps addressed by position (lexemes and
+ * boundaries by position, offsets of documents) are paged and take 64-bit
+ * offsets either way. Positions of a single lexeme are still counted by int
+ * and are best compressed for such texts, as deltas take 1 to 4 bytes each.
+ */
+#if defined(QUBIQ_LARGE_TEXTS)
+typedef qint64 TextPosition;
+#else
+typedef qint32 TextPosition;
+#endif
+
 #endif // _QUBIQUTIL_GLOBAL_H_
@@ -0,0 +1,392 @@
+#include <algorithm>
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#include <qubiq/util/compressed_postings.h>
+
+static const int CONTROL_BYTES_PER_BLOCK = POSTINGS_BLOCK_SIZE / 4;
+
+#ifdef __SSSE3__
+//! \internal Shuffle masks and data lengths of all control bytes of Stream VByte.
+struct StreamVByteTables {
+    uchar shuffle[256][16];
+    uchar length[256];
+
+    StreamVByteTables() {
+        for (int c = 0; c < 256; c++) {
+            int offset = 0;
+            for (int k = 0; k < 4; k++) {
+                const int len = ((c >> (2 * k)) & 3) + 1;
+                for (int b = 0; b < 4; b++) {
+                    shuffle[c][4 * k + b] = b < len? (uchar)(offset + b) : 0x80; // 0x80 zeroes the byte
+                }
+                offset += len;
+            }
+            length[c] = (uchar)offset;
+        }
+    }
+};
+
+//! \internal Returns tables of Stream VByte, built on first use.
+static const StreamVByteTables& stream_vbyte_tables()
+{
+    static const StreamVByteTables tables;
+    return tables;
+}
+#endif
+
+/**
+ * \class CompressedPostings
+ *
+ * \brief The CompressedPostings class stores ascending positions of a lexeme compressed.
+ *
+ * Positions are split into blocks of \c POSTINGS_BLOCK_SIZE. Each complete block
+ * keeps its first position uncompressed as a skip entry, and differences between
+ * consecutive positions are encoded with Stream VByte: lengths of deltas (1 to 4
+ * bytes) are packed into control bytes, two bits each, separately from the
+ * delta bytes. A whole control byte is decoded with a single byte shuffle if the
+ * library is built with SSSE3 enabled, and value by value otherwise.
+ *
+ * Positions of the incomplete last block are kept uncompressed, so positions
+ * can be appended.
+ *
+ * \sa PostingsIterator
+ * \sa LexemeIndex::compress
+ */
+
+//! Constructs empty postings.
+CompressedPostings::CompressedPostings()
+{
+    _last = 0;
+    _size = 0;
+}
+
+//! Constructs postings from positions in ascending order.
+CompressedPostings::CompressedPostings(const QVector<TextPosition> &positions)
+{
+    _last = 0;
+    _size = 0;
+
+    _blocks.reserve(positions.size() / POSTINGS_BLOCK_SIZE);
+    _control.reserve(positions.size() / 4 + 1);
+    _data.reserve(positions.size());
+    for (int i = 0; i < positions.size(); i++) {
+        append(positions.at(i));
+    }
+    _data.squeeze();
+    _tail.squeeze();
+}
+
+/**
+ * \brief Appends a position.
+ * \param[in] pos Position not less than the last one.
+ * \returns \c true on success and \c false if the position is less than the last
+ * one or too far from it to be encoded.
+ */
+bool CompressedPostings::append(TextPosition pos)
+{
+    if (_size > 0 && (pos < _last || (qint64)pos - (qint64)_last > (qint64)0xFFFFFFFF))
+        return false;
+
+    _tail.append(pos);
+    _last = pos;
+    _size++;
+    if (_tail.size() == POSTINGS_BLOCK_SIZE)
+        encode_tail();
+    return true;
+}
+
+/**
+ * \brief Decodes positions of a block.
+ * \param[in]  block Number of the block.
+ * \param[out] out   Buffer for at least \c POSTINGS_BLOCK_SIZE positions.
+ * \returns Number of decoded positions.
+ */
+int CompressedPostings::decodeBlock(int block, TextPosition *out) const
+{
+    if (block >= _blocks.size()) {
+        std::copy(_tail.constBegin(), _tail.constEnd(), out);
+        return _tail.size();
+    }
+
+    const uchar *data = reinterpret_cast<const uchar*>(_data.constData());
+    quint32 deltas[POSTINGS_BLOCK_SIZE];
+    decode_deltas(
+        reinterpret_cast<const uchar*>(_control.constData()) + block * CONTROL_BYTES_PER_BLOCK,
+        data + _blocks.at(block).data_offset,
+        data + _data.size(),
+        deltas
+    );
+
+    TextPosition pos = _blocks.at(block).first;
+    for (int i = 0; i < POSTINGS_BLOCK_SIZE; i++) {
+        pos   += deltas[i];
+        out[i] = pos;
+    }
+    return POSTINGS_BLOCK_SIZE;
+}
+
+/**
+ * \brief Finds the block a position belongs to using skip entries.
+ * \param[in] target Position to look for.
+ * \returns The last block starting at or before \c target, 0 if there is none,
+ * and -1 for empty postings.
+ */
+int CompressedPostings::findBlock(TextPosition target) const
+{
+    int lo = 0;
+    int hi = numBlocks() - 1;
+    while (lo < hi) {
+        const int mid = (lo + hi + 1) / 2;
+        if (blockFirst(mid) <= target)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return hi < 0? -1 : lo;
+}
+
+//! Returns memory occupied by the postings in bytes.
+qint64 CompressedPostings::memoryUsage() const
+{
+    return sizeof(*this)
+        + _blocks.capacity() * (qint64)sizeof(Block)
+        + _control.capacity()
+        + _data.capacity()
+        + _tail.capacity() * (qint64)sizeof(TextPosition);
+}
+
+//! Returns all positions decoded.
+QVector<TextPosition> CompressedPostings::toVector() const
+{
+    QVector<TextPosition> result(_size);
+    for (int block = 0; block < numBlocks(); block++) {
+        decodeBlock(block, result.data() + block * POSTINGS_BLOCK_SIZE);
+    }
+    return result;
+}
+
+//! \internal Compresses the complete block of uncompressed positions.
+void CompressedPostings::encode_tail()
+{
+    Block block;
+    block.first       = _tail.at(0);
+    block.data_offset = (quint32)_data.size();
+    _blocks.append(block);
+
+    // The first delta is always 0, so blocks do not need special treatment of their first position
+    for (int i = 0; i < POSTINGS_BLOCK_SIZE; i += 4) {
+        uchar control = 0;
+        for (int k = 0; k < 4; k++) {
+            const quint32 delta = i + k > 0? (quint32)(_tail.at(i + k) - _tail.at(i + k - 1)) : 0;
+            const int len = delta < (1u << 8)? 1 : delta < (1u << 16)? 2 : delta < (1u << 24)? 3 : 4;
+            control |= (uchar)((len - 1) << (2 * k));
+            for (int b = 0; b < len; b++) {
+                _data.append((char)((delta >> (8 * b)) & 0xFF));
+            }
+        }
+        _control.append((char)control);
+    }
+
+    _tail.clear();
+}
+
+/**
+ * \internal Decodes \c POSTINGS_BLOCK_SIZE deltas of a block.
+ *
+ * The vectorized loop loads 16 bytes at a time, so it stops when fewer bytes are
+ * left in the buffer and the remaining deltas are decoded one by one.
+ *
+ * \param[in]  control  Control bytes of the block.
+ * \param[in]  data     Delta bytes of the block.
+ * \param[in]  data_end End of the buffer of delta bytes.
+ * \param[out] out      Buffer for \c POSTINGS_BLOCK_SIZE deltas.
+ */
+/*static*/ void CompressedPostings::decode_deltas(const uchar *control, const uchar *data, const uchar *data_end,
+                                                  quint32 *out)
+{
+    int i = 0;
+#ifdef __SSSE3__
+    const StreamVByteTables &tables = stream_vbyte_tables();
+    for (; i < CONTROL_BYTES_PER_BLOCK && data + 16 <= data_end; i++) {
+        const uchar   c     = control[i];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i mask  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffle[c]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * i), _mm_shuffle_epi8(bytes, mask));
+        data += tables.length[c];
+    }
+#else
+    Q_UNUSED(data_end);
+#endif
+    for (; i < CONTROL_BYTES_PER_BLOCK; i++) {
+        const uchar c = control[i];
+        for (int k = 0; k < 4; k++) {
+            const int len   = ((c >> (2 * k)) & 3) + 1;
+            quint32   value = 0;
+            for (int b = 0; b < len; b++) {
+                value |= (quint32)data[b] << (8 * b);
+            }
+            out[4 * i + k] = value;
+            data += len;
+        }
+    }
+}
+
+//! Constructs an iterator over no positions.
+PostingsIterator::PostingsIterator()
+    : _positions(NULL), _postings(NULL), _bitmap(NULL), _pages(NULL), _offset(0), _end(0), _block(-1), _resume(0),
+      _buffer_start(0), _buffer_end(0)
+{
+}
+
+//! Constructs an iterator over uncompressed positions, \c NULL stands for no positions.
+PostingsIterator::PostingsIterator(const QVector<TextPosition> *positions)
+    : _positions(positions), _postings(NULL), _bitmap(NULL), _pages(NULL), _offset(0),
+      _end(positions != NULL? positions->size() : 0), _block(-1), _resume(0), _buffer_start(0), _buffer_end(0)
+{
+}
+
+//! Constructs an iterator over compressed positions, \c NULL stands for no positions.
+PostingsIterator::PostingsIterator(const CompressedPostings *postings)
+    : _positions(NULL), _postings(postings), _bitmap(NULL), _pages(NULL), _offset(0),
+      _end(postings != NULL? postings->size() : 0), _block(-1), _resume(0), _buffer_start(0), _buffer_end(0)
+{
+}
+
+//! Constructs an iterator over positions stored as a bitmap, \c NULL stands for no positions.
+PostingsIterator::PostingsIterator(const PositionBitmap *bitmap)
+    : _positions(NULL), _postings(NULL), _bitmap(bitmap), _pages(NULL), _offset(0),
+      _end(bitmap != NULL? bitmap->size() : 0), _block(-1), _resume(0), _buffer_start(0), _buffer_end(0)
+{
+}
+
+//! Constructs an iterator over positions of a frozen index, \c NULL stands for no positions.
+PostingsIterator::PostingsIterator(const PositionPages *pages)
+    : _positions(NULL), _postings(NULL), _bitmap(NULL), _pages(pages), _offset(0),
+      _end(pages != NULL? (int)pages->size() : 0), _block(-1), _resume(0), _buffer_start(0), _buffer_end(0)
+{
+}
+
+/**
+ * \brief Advances the iterator to the first position not less than \c target.
+ *
+ * Positions are expected in ascending order. Compressed blocks ending before
+ * \c target are skipped by their skip entries without being decoded, bitmaps
+ * are resumed right at \c target, and pages are found by their first positions.
+ *
+ * \returns \c true if such position exists, \c false if the iterator is exhausted.
+ */
+bool PostingsIterator::skipTo(TextPosition target)
+{
+    if (_positions != NULL) {
+        _offset = std::lower_bound(_positions->constBegin() + _offset, _positions->constBegin() + _end, target)
+            - _positions->constBegin();
+        return hasNext();
+    }
+
+    if (!hasNext())
+        return false;
+
+    if (_bitmap != NULL || _pages != NULL) {
+        if (_offset < _buffer_end && _buffer[_buffer_end - 1 - _buffer_start] >= target) {
+            while (_buffer[_offset - _buffer_start] < target) {
+                _offset++;
+            }
+            return true;
+        }
+    }
+
+    if (_pages != NULL) {
+        // The last page starting before target, pages behind the current one are not looked at
+        const int current = _offset >> POSITION_PAGE_BITS;
+        int lo = current;
+        int hi = _pages->numPages() - 1;
+        while (lo < hi) {
+            const int mid = (lo + hi + 1) / 2;
+            if (_pages->page(mid).at(0) < target)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+
+        const QVector<TextPosition> &page  = _pages->page(lo);
+        const int                    first = lo == current? _offset & PositionPages::PAGE_MASK : 0;
+        _offset = (lo << POSITION_PAGE_BITS)
+            + (int)(std::lower_bound(page.constBegin() + first, page.constEnd(), target) - page.constBegin());
+        _buffer_start = _buffer_end = _offset;
+        return hasNext();
+    }
+
+    if (_bitmap != NULL) {
+        // Positions left behind are less than target, unless the iterator is already past it
+        const int offset = _bitmap->rank(target);
+        if (offset > _offset) {
+            _offset = offset;
+            _resume = target;
+        }
+        _buffer_start = _buffer_end = _offset;
+        return hasNext();
+    }
+
+    const int block = _postings->findBlock(target);
+    if (block * POSTINGS_BLOCK_SIZE > _offset) {
+        load_block(block);
+        _offset = _buffer_start;
+    }
+
+    while (_offset < _end) {
+        if (_offset == _buffer_end)
+            load_next();
+        if (_buffer[_offset - _buffer_start] >= target)
+            return true;
+        _offset++;
+    }
+    return false;
+}
+
+/**
+ * \brief Moves the iterator to the position with the given offset.
+ * \param[in] offset Number of positions to leave behind, from 0 to \c size.
+ */
+void PostingsIterator::seek(int offset)
+{
+    _offset       = qBound(0, offset, _end);
+    _buffer_start = _buffer_end = _offset;
+    if (_postings != NULL) {
+        load_block(_offset / POSTINGS_BLOCK_SIZE);
+    } else if (_bitmap != NULL) {
+        _resume = _offset < _end? _bitmap->select(_offset) : 0;
+    }
+}
+
+//! \internal Decodes a block of compressed positions into the buffer.
+void PostingsIterator::load_block(int block)
+{
+    _block        = block;
+    _buffer_start = block * POSTINGS_BLOCK_SIZE;
+    _buffer_end   = _buffer_start + _postings->decodeBlock(block, _buffer);
+}
+
+//! \internal Fills the buffer with positions following the ones held in it.
+void PostingsIterator::load_next()
+{
+    if (_pages != NULL) {
+        const QVector<TextPosition> &page  = _pages->page(_offset >> POSITION_PAGE_BITS);
+        const int                    first = _offset & PositionPages::PAGE_MASK;
+        const int                    n     = qMin(POSTINGS_BLOCK_SIZE, page.size() - first);
+        std::copy(page.constBegin() + first, page.constBegin() + first + n, _buffer);
+        _buffer_start = _offset;
+        _buffer_end   = _offset + n;
+        return;
+    }
+
+    if (_bitmap == NULL) {
+        load_block(_block + 1);
+        return;
+    }
+
+    _buffer_start = _offset;
+    _buffer_end   = _offset + _bitmap->decode(_resume, _buffer, POSTINGS_BLOCK_SIZE);
+    if (_buffer_end > _buffer_start)
+        _resume = _buffer[_buffer_end - 1 - _buffer_start] + 1;
+}
@@ -8,6 +8,7 @@ Lexeme::Lexeme(const QString &name)
 //! Copy constructor. Constructs a Lexeme object from the other Lexeme object.
 Lexeme::Lexeme(const Lexeme &other)
 {
+    _id = INVALID_LEXEME_ID; // Copies are not owned by an index
     _assign(other);
 }
 
@@ -21,7 +22,7 @@ Lexeme::~Lexeme()
     _destroy();
 }
 
-bool Lexeme::addForm(const QString &form, int offset, bool overwrite /* = false */)
+bool Lexeme::addForm(const QString &form, TextPosition offset, bool overwrite /* = false */)
 {
     if (_idx_offsets->contains(offset)) {
         if (!overwrite)
@@ -53,20 +54,21 @@ Lexeme &Lexeme::operator =(const Lexeme &other)
 void Lexeme::_initialize(const QString &name, bool is_boundary)
 {
     _lexeme      = name;
-    _is_boundary = is_boundary;
+    _features    = is_boundary? FEATURE_BOUNDARY : 0;
+    _id          = INVALID_LEXEME_ID;
     _forms       = new QVector<QString>();
-    _offsets     = new QVector<int>();
-    _idx_offsets = new QHash<int, int>();
+    _offsets     = new QVector<TextPosition>();
+    _idx_offsets = new QHash<TextPosition, int>();
 }
 
 //! \internal Assigns \c other members to \c this members.
 void Lexeme::_assign(const Lexeme &other)
 {
     _lexeme      = other._lexeme;
-    _is_boundary = other._is_boundary;
+    _features    = other._features;
     _forms       = new QVector<QString>(*(other._forms));
-    _offsets     = new QVector<int>(*(other._offsets));
-    _idx_offsets = new QHash<int, int>(*(other._idx_offsets));
+    _offsets     = new QVector<TextPosition>(*(other._offsets));
+    _idx_offsets = new QHash<TextPosition, int>(*(other._idx_offsets));
 }
 
 //! \internal Frees memory occupied by class members.
@@ -1,62 +1,126 @@
+#include <algorithm>
 #include <qubiq/util/lexeme_index.h>
 
+static QAtomicInt last_freeze_serial; //!< Serial number of the last frozen copy of any index
+
+//! \internal Deletes lexemes of a frozen copy once no copy shares them.
+static void delete_lexemes(QVector<Lexeme*> *lexemes)
+{
+    qDeleteAll(*lexemes);
+    delete lexemes;
+}
+
+/**
+ * \class LexemeIndex
+ *
+ * Every lexeme gets a dense ID at the moment it is added to the index. The
+ * vocabulary maps names to lexemes, while lexemes, their positions and the
+ * stream of lexemes by position are arrays addressed by ID or by position.
+ * Names are only looked up when a lexeme is referred to by name.
+ *
+ * Positions of frequent lexemes can be compressed by \c compress. If a bitmap
+ * threshold is set, lexemes reaching it are switched to a \c PositionBitmap as
+ * positions are added, so co-occurrence with them can be checked by bitmap
+ * intersection. Such positions are only accessible through \c postings, which
+ * works for all representations, so bitmaps are disabled by default.
+ *
+ * Readers running concurrently with writers of an index use read-only copies made
+ * by \c freeze, which share unchanged data with each other.
+ */
+
 LexemeIndex::LexemeIndex()
 {
-    lex     = new QHash<QString, Lexeme*>;
-    lex2pos = new QHash<QString, QVector<int>*>;
-    pos2lex = new QHash<int, Lexeme*>;
+    lex        = new QHash<QString, Lexeme*>;
+    id2lex     = new PagedVector<Lexeme*, 10>;
+    lex2pos    = new QVector<QVector<TextPosition>*>;
+    compressed = new QVector<CompressedPostings*>;
+    bitmaps    = new QVector<PositionBitmap*>;
+    pos2lex    = new PagedVector<quint32>;
+    frozen_pos = new PagedVector<PositionPages, 10>;
+    touched    = new QVector<quint32>;
+    touched_at = new QVector<quint32>;
+    num_positions    = 0;
+    bitmap_threshold = DEFAULT_BITMAP_THRESHOLD;
+    is_frozen        = false;
+    num_freezes      = 0;
+    freeze_serial    = 0;
+    num_copied       = 0;
 }
 
 LexemeIndex::~LexemeIndex()
 {
     delete pos2lex;
+    delete frozen_pos;
+    delete touched;
+    delete touched_at;
 
-    QHash<QString, QVector<int>*>::iterator l2p = lex2pos->begin();
-    while (l2p != lex2pos->end()) {
-        delete *l2p;
-        l2p = lex2pos->erase(l2p);
+    for (int i = 0; i < lex2pos->size(); i++) {
+        delete lex2pos->at(i);
     }
     delete lex2pos;
 
-    QHash<QString, Lexeme*>::iterator l = lex->begin();
-    while (l != lex->end()) {
-        delete *l;
-        l = lex->erase(l);
+    for (int i = 0; i < compressed->size(); i++) {
+        delete compressed->at(i);
+    }
+    delete compressed;
+
+    for (int i = 0; i < bitmaps->size(); i++) {
+        delete bitmaps->at(i);
     }
+    delete bitmaps;
+
+    // Lexemes of frozen copies are owned by frozen_lexemes
+    for (qint64 i = 0; i < id2lex->size() && !is_frozen; i++) {
+        delete id2lex->at(i);
+    }
+    delete id2lex;
     delete lex;
 }
 
-Lexeme* LexemeIndex::addPosition(const QString &name, int pos, bool *is_new /*= NULL*/)
+Lexeme* LexemeIndex::addPosition(const QString &name, TextPosition pos, bool *is_new /*= NULL*/)
 {
-    if (pos < 0)
+    if (pos < 0 || is_frozen)
         return NULL;
 
-    init_entry(name, is_new);
+    Lexeme *lexeme = init_entry(name, is_new);
 
-    Lexeme       *lexeme    = lex->value(name);
-    QVector<int> *positions = lex2pos->value(name);
-
-    pos2lex->insert(pos, lexeme);
-    positions->append(pos);
+    set_position(pos, lexeme->_id);
+    append_position(lexeme->_id, pos);
 
     return lexeme;
 }
 
-Lexeme* LexemeIndex::addPositions(const QString &name, const QVector<int> *pos, bool *is_new /*= NULL*/)
+/**
+ * Adds a position of a lexeme already present in the index. Unlike adding a position
+ * by name, this neither looks up nor creates the index entry for the lexeme.
+ *
+ * \param[in] lexeme Lexeme owned by the index (i.e. returned by one of its methods).
+ * \param[in] pos    Position to add.
+ *
+ * \returns \c lexeme on success and \c NULL if the position is negative or
+ * the lexeme does not belong to the index.
+ */
+Lexeme* LexemeIndex::addPosition(Lexeme *lexeme, TextPosition pos)
 {
-    if (pos == NULL)
+    if (lexeme == NULL || pos < 0 || is_frozen)
         return NULL;
 
-    init_entry(name, is_new);
+    if (findById(lexeme->_id) != lexeme)
+        return NULL;
 
-    Lexeme       *lexeme    = lex->value(name);
-    QVector<int> *positions = lex2pos->value(name);
+    set_position(pos, lexeme->_id);
+    append_position(lexeme->_id, pos);
 
-    for (int i = 0; i < pos->size(); i++) {
-        int _pos = pos->at(i);
-        pos2lex->insert(_pos, lexeme);
-        positions->append(_pos);
-    }
+    return lexeme;
+}
+
+Lexeme* LexemeIndex::addPositions(const QString &name, const QVector<TextPosition> *pos, bool *is_new /*= NULL*/)
+{
+    if (pos == NULL || is_frozen)
+        return NULL;
+
+    Lexeme *lexeme = init_entry(name, is_new);
+    append_positions(lexeme, PostingsIterator(pos));
 
     return lexeme;
 }
@@ -67,19 +131,20 @@ Lexeme* LexemeIndex::copyFromIndex(const LexemeIndex &other, const QString &name
         *is_new = false;
     }
 
-    if (lex->contains(name)) {
-        return addPositions(name, other.positions(name));
+    if (is_frozen)
+        return NULL;
+
+    Lexeme *lexeme = findByName(name);
+    if (lexeme != NULL) {
+        append_positions(lexeme, other.postings(name));
+        return lexeme;
     }
 
     Lexeme *other_lexeme = other.findByName(name);
 
-    Lexeme *lexeme          = new Lexeme(*other_lexeme);
-    QVector<int> *positions = new QVector<int>();
-
-    lex->insert(name, lexeme);
-    lex2pos->insert(name, positions);
-
-    addPositions(name, other.positions(name));
+    lexeme = new Lexeme(*other_lexeme);
+    add_lexeme(lexeme);
+    append_positions(lexeme, other.postingsById(other_lexeme->id()));
 
     if (is_new != NULL) {
         *is_new = true;
@@ -88,32 +153,333 @@ Lexeme* LexemeIndex::copyFromIndex(const LexemeIndex &other, const QString &name
     return lexeme;
 }
 
+/**
+ * Adds positions of all lexemes of another index to this one.
+ *
+ * Lexemes new to this index get IDs in the order of their IDs in \c other.
+ */
 void LexemeIndex::merge(const LexemeIndex &other)
 {
-    QHash<QString, Lexeme*> *lexemes = other.lexemes();
-    QHash<QString, Lexeme*>::const_iterator it_l;
-    for (it_l = lexemes->constBegin(); it_l != lexemes->constEnd(); ++it_l) {
-        Lexeme *lexeme = *it_l;
-        addPositions(lexeme->name(), other.positions(lexeme->name()));
+    if (is_frozen)
+        return;
+
+    for (int id = 0; id < other.size(); id++) {
+        Lexeme *lexeme = init_entry(other.findById(id)->name(), NULL);
+        append_positions(lexeme, other.postingsById(id));
     }
 }
 
-void LexemeIndex::init_entry(const QString &name, bool *is_new)
+/**
+ * Compresses positions of frequent lexemes.
+ *
+ * Positions of lexemes with at least \c min_size positions in ascending order,
+ * the order \c Text adds them in, are replaced with \c CompressedPostings. Such
+ * positions are no longer returned by \c positions and have to be iterated through
+ * \c postings. Positions can still be added: Appending a position less than the
+ * last one decompresses positions of the lexeme back.
+ *
+ * \param[in] min_size Minimum number of positions of a lexeme to compress.
+ *
+ * \returns Number of lexemes compressed.
+ *
+ * \sa postingsMemoryUsage
+ */
+int LexemeIndex::compress(int min_size /*= DEFAULT_MIN_COMPRESSED_POSTINGS*/)
+{
+    int num_compressed = 0;
+    for (int id = 0; id < lex2pos->size(); id++) {
+        const QVector<TextPosition> *positions = lex2pos->at(id);
+        if (positions == NULL || positions->size() < min_size || positions->isEmpty())
+            continue;
+        if (!std::is_sorted(positions->constBegin(), positions->constEnd()))
+            continue;
+
+        (*compressed)[id] = new CompressedPostings(*positions);
+        delete positions;
+        (*lex2pos)[id] = NULL;
+        num_compressed++;
+    }
+    return num_compressed;
+}
+
+//! Returns memory occupied by positions of lexemes in bytes.
+qint64 LexemeIndex::postingsMemoryUsage() const
+{
+    qint64 usage = 0;
+    for (qint64 id = 0; id < frozen_pos->size(); id++) {
+        usage += sizeof(PositionPages) + frozen_pos->at(id).memoryUsage();
+    }
+    for (int id = 0; id < lex2pos->size(); id++) {
+        if (lex2pos->at(id) != NULL)
+            usage += sizeof(QVector<TextPosition>) + lex2pos->at(id)->capacity() * (qint64)sizeof(TextPosition);
+        else if (compressed->at(id) != NULL)
+            usage += compressed->at(id)->memoryUsage();
+        else
+            usage += bitmaps->at(id)->memoryUsage();
+    }
+    return usage;
+}
+
+/**
+ * Returns memory occupied by the index in bytes.
+ *
+ * Positions and arrays addressed by ID or by position are sized by their capacities.
+ * Nodes of the vocabulary are estimated, as \c QHash does not report their size.
+ * Pages and lexemes shared by frozen copies are counted by each copy.
+ */
+qint64 LexemeIndex::memoryUsage() const
+{
+    const qint64 bytes_per_node = 32; // Node of the vocabulary: next node, hash, key and value
+
+    qint64 usage = postingsMemoryUsage() + pos2lex->memoryUsage() + id2lex->memoryUsage();
+    usage += (lex2pos->capacity() + compressed->capacity() + bitmaps->capacity()) * (qint64)sizeof(void*);
+    usage += (touched->capacity() + touched_at->capacity()) * (qint64)sizeof(quint32);
+    usage += lex->capacity() * (qint64)sizeof(void*) + lex->size() * bytes_per_node;
+    for (qint64 id = 0; id < id2lex->size(); id++) {
+        usage += sizeof(Lexeme) + id2lex->at(id)->name().capacity() * (qint64)sizeof(QChar);
+    }
+    return usage;
+}
+
+/**
+ * Sets the number of positions a lexeme is switched to a \c PositionBitmap at.
+ *
+ * A lexeme is switched as soon as it reaches the threshold, provided its positions
+ * are strictly ascending. Lexemes already above the threshold are not affected.
+ * Switched lexemes have no vector of positions: \c positions returns \c NULL for
+ * them, and their positions are read through \c postings.
+ *
+ * \param[in] threshold Number of positions, 0 or less to disable bitmaps.
+ *
+ * \sa bitmapById
+ */
+void LexemeIndex::setBitmapThreshold(int threshold)
+{
+    bitmap_threshold = qMax(threshold, 0);
+}
+
+/**
+ * Makes a read-only copy of the index for readers running concurrently with
+ * writers of this index.
+ *
+ * Frozen copies keep positions of lexemes in pages of \c PositionPages and share
+ * the pages, the map of positions to lexemes and lexemes without changes with the
+ * copy they were made after. Given the previous copy, only lexemes which got
+ * positions since then are looked at, and only their new positions are copied,
+ * so the cost of a copy depends on the number of positions added since the
+ * previous one rather than on the size of the index. The vocabulary is still
+ * copied as a whole when new names appear.
+ *
+ * Positions of frozen copies are only accessible through \c postings. Features
+ * changed on lexemes without new positions are not picked up by incremental copies.
+ *
+ * \param[in] previous The copy returned by the previous call, \c NULL or any other
+ * index to copy everything.
+ *
+ * \returns The copy owned by the caller, \c NULL if this index is frozen itself.
+ *
+ * \sa numCopiedPositions
+ */
+LexemeIndex* LexemeIndex::freeze(const LexemeIndex *previous /*= NULL*/)
+{
+    if (is_frozen)
+        return NULL;
+
+    if (previous != NULL && (!previous->is_frozen || previous->freeze_serial != freeze_serial || freeze_serial == 0))
+        previous = NULL;
+
+    LexemeIndex *frozen = new LexemeIndex();
+    frozen->is_frozen     = true;
+    *frozen->pos2lex      = *pos2lex;
+    frozen->num_positions = num_positions;
+
+    QVector<Lexeme*> *batch = new QVector<Lexeme*>();
+    if (previous != NULL) {
+        *frozen->lex           = *previous->lex;
+        *frozen->id2lex        = *previous->id2lex;
+        *frozen->frozen_pos    = *previous->frozen_pos;
+        frozen->frozen_lexemes = previous->frozen_lexemes;
+
+        // Lexemes known to the previous copy are copied again only if their features changed
+        for (int i = 0; i < touched->size(); i++) {
+            const quint32 id = touched->at(i);
+            if (id >= (quint64)frozen->id2lex->size())
+                continue;
+            if (id2lex->at(id)->features() != frozen->id2lex->at(id)->features()) {
+                Lexeme *lexeme = frozen->freeze_lexeme(id2lex->at(id), batch);
+                (*frozen->id2lex)[id] = lexeme;
+            }
+            frozen->freeze_positions(*this, id);
+        }
+    }
+
+    for (qint64 id = frozen->id2lex->size(); id < id2lex->size(); id++) {
+        frozen->id2lex->append(frozen->freeze_lexeme(id2lex->at(id), batch));
+        frozen->frozen_pos->append(PositionPages());
+        frozen->freeze_positions(*this, (quint32)id);
+    }
+    frozen->frozen_lexemes.append(LexemeBatch(batch, delete_lexemes));
+
+    touched->clear();
+    num_freezes++;
+    freeze_serial = frozen->freeze_serial = last_freeze_serial.fetchAndAddOrdered(1) + 1;
+    return frozen;
+}
+
+//! \internal Returns the lexeme of the given name, creating it if needed.
+Lexeme* LexemeIndex::init_entry(const QString &name, bool *is_new)
 {
     if (is_new != NULL) {
         *is_new = false;
     }
 
-    if (lex->contains(name)) {
-        return;
+    Lexeme *lexeme = lex->value(name, NULL);
+    if (lexeme != NULL) {
+        return lexeme;
     }
 
-    Lexeme *lexeme          = new Lexeme(name);
-    QVector<int> *positions = new QVector<int>();
-    lex->insert(name, lexeme);
-    lex2pos->insert(name, positions);
+    lexeme = new Lexeme(name);
+    add_lexeme(lexeme);
 
     if (is_new != NULL) {
         *is_new = true;
     }
+
+    return lexeme;
+}
+
+//! \internal Takes ownership of a new lexeme assigning it the next ID.
+void LexemeIndex::add_lexeme(Lexeme *lexeme)
+{
+    lexeme->_id = (quint32)id2lex->size();
+    id2lex->append(lexeme);
+    lex2pos->append(new QVector<TextPosition>());
+    compressed->append(NULL);
+    bitmaps->append(NULL);
+    touched_at->append(num_freezes); // The next frozen copy picks it up as a new lexeme
+    lex->insert(lexeme->name(), lexeme);
+}
+
+//! \internal Adds positions to a lexeme owned by the index.
+void LexemeIndex::append_positions(Lexeme *lexeme, PostingsIterator pos)
+{
+    while (pos.hasNext()) {
+        TextPosition _pos = pos.next();
+        set_position(_pos, lexeme->_id);
+        append_position(lexeme->_id, _pos);
+    }
+}
+
+/**
+ * \internal Adds a position to the positions of a lexeme.
+ *
+ * Positions reaching the bitmap threshold are switched to a bitmap. Compressed
+ * positions and bitmaps which can not take the position are converted back to
+ * a vector.
+ */
+void LexemeIndex::append_position(quint32 id, TextPosition pos)
+{
+    if (touched_at->at(id) != num_freezes) {
+        (*touched_at)[id] = num_freezes;
+        touched->append(id);
+    }
+
+    QVector<TextPosition> *positions = lex2pos->at(id);
+    if (positions != NULL) {
+        positions->append(pos);
+        if (positions->size() == bitmap_threshold)
+            switch_to_bitmap(id);
+        return;
+    }
+
+    CompressedPostings *postings = compressed->at(id);
+    if (postings != NULL) {
+        if (postings->append(pos)) {
+            if (postings->size() == bitmap_threshold)
+                switch_to_bitmap(id);
+            return;
+        }
+
+        (*lex2pos)[id] = new QVector<TextPosition>(postings->toVector());
+        (*lex2pos)[id]->append(pos);
+        delete postings;
+        (*compressed)[id] = NULL;
+        return;
+    }
+
+    PositionBitmap *bitmap = bitmaps->at(id);
+    if (bitmap->append(pos))
+        return;
+
+    (*lex2pos)[id] = new QVector<TextPosition>(bitmap->toVector());
+    (*lex2pos)[id]->append(pos);
+    delete bitmap;
+    (*bitmaps)[id] = NULL;
+}
+
+//! \internal Replaces positions of a lexeme with a bitmap unless they are not strictly ascending.
+void LexemeIndex::switch_to_bitmap(quint32 id)
+{
+    PositionBitmap  *bitmap = new PositionBitmap();
+    PostingsIterator pos    = postingsById(id);
+    while (pos.hasNext()) {
+        if (!bitmap->append(pos.next())) {
+            delete bitmap;
+            return;
+        }
+    }
+
+    delete lex2pos->at(id);
+    (*lex2pos)[id] = NULL;
+    delete compressed->at(id);
+    (*compressed)[id] = NULL;
+    (*bitmaps)[id] = bitmap;
+}
+
+//! \internal Adds a copy of a lexeme of the writer to the vocabulary of a frozen copy.
+Lexeme* LexemeIndex::freeze_lexeme(const Lexeme *lexeme, QVector<Lexeme*> *batch)
+{
+    Lexeme *copy = new Lexeme(*lexeme);
+    copy->_id = lexeme->_id;
+    lex->insert(copy->name(), copy);
+    batch->append(copy);
+    return copy;
+}
+
+//! \internal Appends positions a lexeme of \c source got since the previous frozen copy.
+void LexemeIndex::freeze_positions(const LexemeIndex &source, quint32 id)
+{
+    PositionPages   &pages = (*frozen_pos)[id];
+    PostingsIterator pos   = source.postingsById(id);
+    pos.seek((int)pages.size());
+    num_copied += pos.size() - pages.size();
+    while (pos.hasNext()) {
+        pages.append(pos.next());
+    }
+}
+
+/**
+ * \internal Maps a position to a lexeme ID.
+ *
+ * Positions are dense, so the map is an array indexed by position. Positions
+ * past the end of the array leave a gap of \c INVALID_LEXEME_ID entries behind.
+ */
+void LexemeIndex::set_position(TextPosition pos, quint32 id)
+{
+    if (pos < 0)
+        return;
+
+    if (pos == pos2lex->size()) {
+        pos2lex->append(id);
+        num_positions++;
+        return;
+    }
+
+    if (pos > pos2lex->size())
+        pos2lex->resize(pos + 1, INVALID_LEXEME_ID);
+
+    quint32 &entry = (*pos2lex)[pos];
+    if (entry == INVALID_LEXEME_ID)
+        num_positions++;
+    entry = id;
 }
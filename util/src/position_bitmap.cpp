@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <qubiq/util/position_bitmap.h>
+
+//! \internal Returns the number of set bits of a word.
+static inline int popcount64(quint64 word)
+{
+#if defined(Q_CC_GNU)
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word != 0; word &= word - 1)
+        count++;
+    return count;
+#endif
+}
+
+//! \internal Returns the number of trailing zero bits of a non-zero word.
+static inline int ctz64(quint64 word)
+{
+#if defined(Q_CC_GNU)
+    return __builtin_ctzll(word);
+#else
+    int count = 0;
+    for (; (word & 1) == 0; word >>= 1)
+        count++;
+    return count;
+#endif
+}
+
+/**
+ * \class PositionBitmap
+ *
+ * \brief The PositionBitmap class is a compressed bitmap of positions of a frequent lexeme.
+ *
+ * The bitmap follows the layout of Roaring bitmaps: Positions are grouped into
+ * containers of \c BITMAP_CHUNK_SIZE consecutive positions. Sparse containers keep
+ * a sorted array of the lowest bits of their positions, and containers with more
+ * than \c BITMAP_MAX_ARRAY positions switch to a plain bitmap, so dense runs of a
+ * lexeme take one bit per position.
+ *
+ * Intersections, including ones with positions of another lexeme shifted by some
+ * distance, are computed a 64-bit word at a time for bitmap containers.
+ *
+ * \sa LexemeIndex::bitmapById
+ */
+
+//! Constructs an empty bitmap.
+PositionBitmap::PositionBitmap()
+{
+    _last = 0;
+    _size = 0;
+}
+
+/**
+ * \brief Appends a position.
+ * \param[in] pos Non-negative position greater than the last one.
+ * \returns \c true on success and \c false if the position can not be appended.
+ */
+bool PositionBitmap::append(TextPosition pos)
+{
+    if (pos < 0 || (_size > 0 && pos <= _last))
+        return false;
+
+    const TextPosition chunk = pos >> BITMAP_CHUNK_BITS;
+    if (_containers.isEmpty() || _containers.last().chunk != chunk) {
+        Container container;
+        container.chunk = chunk;
+        container.rank  = _size;
+        container.count = 0;
+        _containers.append(container);
+    }
+
+    Container &container = _containers.last();
+    const quint16 low = (quint16)(pos & (BITMAP_CHUNK_SIZE - 1));
+    if (container.words.isEmpty()) {
+        container.array.append(low);
+        if (container.array.size() > BITMAP_MAX_ARRAY) {
+            container.words.fill(0, BITMAP_CHUNK_WORDS);
+            for (int i = 0; i < container.array.size(); i++) {
+                const quint16 value = container.array.at(i);
+                container.words[value >> 6] |= Q_UINT64_C(1) << (value & 63);
+            }
+            container.array = QVector<quint16>();
+        }
+    } else {
+        container.words[low >> 6] |= Q_UINT64_C(1) << (low & 63);
+    }
+
+    container.count++;
+    _size++;
+    _last = pos;
+    return true;
+}
+
+//! Returns \c true if the bitmap contains a position.
+bool PositionBitmap::contains(TextPosition pos) const
+{
+    if (pos < 0)
+        return false;
+
+    const TextPosition chunk = pos >> BITMAP_CHUNK_BITS;
+    const int i = find_container(chunk);
+    if (i == _containers.size() || _containers.at(i).chunk != chunk)
+        return false;
+
+    const Container &container = _containers.at(i);
+    const quint16 low = (quint16)(pos & (BITMAP_CHUNK_SIZE - 1));
+    if (container.words.isEmpty())
+        return std::binary_search(container.array.constBegin(), container.array.constEnd(), low);
+    return (container.words.at(low >> 6) >> (low & 63)) & 1;
+}
+
+//! Returns the number of positions less than \c pos.
+int PositionBitmap::rank(TextPosition pos) const
+{
+    if (pos <= 0)
+        return 0;
+
+    const TextPosition chunk = pos >> BITMAP_CHUNK_BITS;
+    const int i = find_container(chunk);
+    if (i == _containers.size())
+        return _size;
+
+    const Container &container = _containers.at(i);
+    if (container.chunk > chunk)
+        return container.rank;
+
+    const int low = (int)(pos & (BITMAP_CHUNK_SIZE - 1));
+    if (container.words.isEmpty()) {
+        return container.rank + (int)(
+            std::lower_bound(container.array.constBegin(), container.array.constEnd(), (quint16)low)
+            - container.array.constBegin()
+        );
+    }
+
+    int count = 0;
+    for (int w = 0; w < (low >> 6); w++) {
+        count += popcount64(container.words.at(w));
+    }
+    count += popcount64(container.words.at(low >> 6) & ((Q_UINT64_C(1) << (low & 63)) - 1));
+    return container.rank + count;
+}
+
+/**
+ * \brief Finds a position by its rank.
+ * \param[in] rank Number of positions preceding the position, less than \c size.
+ * \returns The position.
+ */
+TextPosition PositionBitmap::select(int rank) const
+{
+    int lo = 0;
+    int hi = _containers.size() - 1;
+    while (lo < hi) {
+        const int mid = (lo + hi + 1) / 2;
+        if (_containers.at(mid).rank <= rank)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    const Container   &container = _containers.at(lo);
+    const TextPosition base      = container.chunk << BITMAP_CHUNK_BITS;
+    int                k         = rank - container.rank;
+    if (container.words.isEmpty())
+        return base + container.array.at(k);
+
+    for (int w = 0; w < BITMAP_CHUNK_WORDS; w++) {
+        quint64   word  = container.words.at(w);
+        const int count = popcount64(word);
+        if (k >= count) {
+            k -= count;
+            continue;
+        }
+        for (; k > 0; k--) {
+            word &= word - 1;
+        }
+        return base + w * 64 + ctz64(word);
+    }
+    return base;
+}
+
+/**
+ * \brief Decodes positions in ascending order.
+ * \param[in]  from First position to look for.
+ * \param[out] out  Buffer for at least \c max positions.
+ * \param[in]  max  Maximum number of positions to decode.
+ * \returns Number of decoded positions not less than \c from.
+ */
+int PositionBitmap::decode(TextPosition from, TextPosition *out, int max) const
+{
+    if (from < 0)
+        from = 0;
+
+    int n = 0;
+    const TextPosition from_chunk = from >> BITMAP_CHUNK_BITS;
+    for (int i = find_container(from_chunk); i < _containers.size() && n < max; i++) {
+        const Container   &container = _containers.at(i);
+        const TextPosition base      = container.chunk << BITMAP_CHUNK_BITS;
+        const int          low_from  = container.chunk == from_chunk? (int)(from & (BITMAP_CHUNK_SIZE - 1)) : 0;
+
+        if (container.words.isEmpty()) {
+            const quint16 *it = std::lower_bound(container.array.constBegin(), container.array.constEnd(), (quint16)low_from);
+            for (; it != container.array.constEnd() && n < max; ++it) {
+                out[n++] = base + *it;
+            }
+            continue;
+        }
+
+        int     w    = low_from >> 6;
+        quint64 word = container.words.at(w) & (~Q_UINT64_C(0) << (low_from & 63));
+        while (n < max) {
+            if (word == 0) {
+                if (++w == BITMAP_CHUNK_WORDS)
+                    break;
+                word = container.words.at(w);
+                continue;
+            }
+            out[n++] = base + w * 64 + ctz64(word);
+            word    &= word - 1;
+        }
+    }
+    return n;
+}
+
+/**
+ * \brief Intersects the bitmap with another one shifted by a distance.
+ *
+ * With \c shift equal to \c k, the result holds positions \c p of this bitmap such
+ * that \c p + \c k is in \c other, e.g. positions of a lexeme followed by another
+ * lexeme \c k tokens later.
+ *
+ * \param[in] other Bitmap to intersect with.
+ * \param[in] shift Distance from positions of this bitmap to positions of \c other.
+ *
+ * \returns The intersection.
+ */
+PositionBitmap PositionBitmap::intersected(const PositionBitmap &other, TextPosition shift /*= 0*/) const
+{
+    PositionBitmap result;
+    quint64        window[BITMAP_CHUNK_WORDS];
+    for (int i = 0; i < _containers.size(); i++) {
+        const Container   &container = _containers.at(i);
+        const TextPosition base      = container.chunk << BITMAP_CHUNK_BITS;
+        if (!other.extract_window(base + shift, window))
+            continue;
+
+        if (container.words.isEmpty()) {
+            for (int j = 0; j < container.array.size(); j++) {
+                const quint16 value = container.array.at(j);
+                if ((window[value >> 6] >> (value & 63)) & 1)
+                    result.append(base + value);
+            }
+            continue;
+        }
+
+        for (int w = 0; w < BITMAP_CHUNK_WORDS; w++) {
+            for (quint64 word = container.words.at(w) & window[w]; word != 0; word &= word - 1) {
+                result.append(base + w * 64 + ctz64(word));
+            }
+        }
+    }
+    return result;
+}
+
+//! Returns memory occupied by the bitmap in bytes.
+qint64 PositionBitmap::memoryUsage() const
+{
+    qint64 usage = sizeof(*this) + _containers.capacity() * (qint64)sizeof(Container);
+    for (int i = 0; i < _containers.size(); i++) {
+        usage += _containers.at(i).array.capacity() * (qint64)sizeof(quint16)
+            +    _containers.at(i).words.capacity() * (qint64)sizeof(quint64);
+    }
+    return usage;
+}
+
+//! Returns all positions in ascending order.
+QVector<TextPosition> PositionBitmap::toVector() const
+{
+    QVector<TextPosition> result(_size);
+    decode(0, result.data(), _size);
+    return result;
+}
+
+//! \internal Returns the offset of the first container of a chunk not less than \c chunk.
+int PositionBitmap::find_container(TextPosition chunk) const
+{
+    int lo = 0;
+    int hi = _containers.size();
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        if (_containers.at(mid).chunk < chunk)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * \internal Copies bits of positions from \c start to \c start + \c BITMAP_CHUNK_SIZE
+ * into \c BITMAP_CHUNK_WORDS words.
+ *
+ * A window overlaps at most two containers. Bitmap containers are copied
+ * a word at a time shifted by the offset of the window.
+ *
+ * \returns \c false if no container overlaps the window.
+ */
+bool PositionBitmap::extract_window(TextPosition start, quint64 *words) const
+{
+    std::fill(words, words + BITMAP_CHUNK_WORDS, Q_UINT64_C(0));
+
+    bool is_overlapped = false;
+    const TextPosition end = start + BITMAP_CHUNK_SIZE;
+    for (int i = find_container(chunk_of(start)); i < _containers.size(); i++) {
+        const Container   &container = _containers.at(i);
+        const TextPosition base      = container.chunk << BITMAP_CHUNK_BITS;
+        if (base >= end)
+            break;
+
+        const int offset = (int)(base - start); // Within (-BITMAP_CHUNK_SIZE, BITMAP_CHUNK_SIZE)
+        if (container.words.isEmpty()) {
+            for (int j = 0; j < container.array.size(); j++) {
+                const int bit = offset + container.array.at(j);
+                if (bit >= 0 && bit < BITMAP_CHUNK_SIZE) {
+                    words[bit >> 6] |= Q_UINT64_C(1) << (bit & 63);
+                    is_overlapped = true;
+                }
+            }
+            continue;
+        }
+
+        // Made non-negative to shift it safely
+        const int shifted    = offset + BITMAP_CHUNK_SIZE;
+        const int word_shift = (shifted >> 6) - BITMAP_CHUNK_WORDS;
+        const int bit_shift  = shifted & 63;
+        for (int w = 0; w < BITMAP_CHUNK_WORDS; w++) {
+            const quint64 word = container.words.at(w);
+            if (word == 0)
+                continue;
+            const int d = w + word_shift;
+            if (d >= 0 && d < BITMAP_CHUNK_WORDS)
+                words[d] |= word << bit_shift;
+            if (bit_shift != 0 && d + 1 >= 0 && d + 1 < BITMAP_CHUNK_WORDS)
+                words[d + 1] |= word >> (64 - bit_shift);
+        }
+        is_overlapped = true;
+    }
+    return is_overlapped;
+}
+
+//! \internal Returns the chunk of a position rounding towards negative infinity.
+/*static*/ TextPosition PositionBitmap::chunk_of(TextPosition pos)
+{
+    return pos >= 0? pos >> BITMAP_CHUNK_BITS : -((-pos + BITMAP_CHUNK_SIZE - 1) >> BITMAP_CHUNK_BITS);
+}
@@ -17,6 +17,9 @@ HEADERS     += \
     include/qubiq/util/qubiqutil_global.h   \
     include/qubiq/util/lexeme.h             \
     include/qubiq/util/lexeme_index.h       \
+    include/qubiq/util/compressed_postings.h \
+    include/qubiq/util/position_bitmap.h    \
+    include/qubiq/util/paged_vector.h       \
     include/qubiq/util/transducer.h         \
     include/qubiq/util/transducer_manager.h \
     include/qubiq/util/transducer_state.h   \
@@ -25,6 +28,8 @@ HEADERS     += \
 SOURCES += \
     src/lexeme.cpp             \
     src/lexeme_index.cpp       \
+    src/compressed_postings.cpp \
+    src/position_bitmap.cpp    \
     src/transducer.cpp         \
     src/transducer_manager.cpp \
     src/transducer_state.cpp   \